@@ -0,0 +1,60 @@
+#ifndef BINLOG_H
+# define BINLOG_H
+
+/*-----------------------------------------------------------------------------
+                                LIBRARIES
+-----------------------------------------------------------------------------*/
+
+# include <stdint.h>
+
+/*-----------------------------------------------------------------------------
+                                MACROS
+-----------------------------------------------------------------------------*/
+
+# define BINLOG_MAGIC "FTPLOG\0\0"
+# define BINLOG_VERSION 1
+# define BINLOG_SEGMENT_RECORDS (1 << 22)
+# define BINLOG_SYNC_SEC 1
+
+/*-----------------------------------------------------------------------------
+                                STRUCTURES
+-----------------------------------------------------------------------------*/
+
+/*
+ * On-disk layout of a result log: one header, then fixed-size records in
+ * the order results were known. nb_records is only bumped once a record is
+ * complete, so a reader never sees a torn record.
+ *
+ * A reply that comes after its probe timed out is logged as BINLOG_LATE,
+ * after the BINLOG_TIMEOUT record of the same probe: each probe has one
+ * BINLOG_REPLY or BINLOG_TIMEOUT record.
+ */
+enum    e_binlog_outcome {
+    BINLOG_REPLY,
+    BINLOG_TIMEOUT,
+    BINLOG_DUP,
+    BINLOG_LATE
+};
+
+typedef struct    s_binlog_hdr {
+    char          magic[8];
+    uint32_t      version;
+    uint32_t      rec_size;
+    uint64_t      nb_records;
+    uint64_t      created_ns;
+    uint8_t       reserved[32];
+}                 t_binlog_hdr;
+
+typedef struct    s_binlog_rec {
+    uint32_t      target;
+    uint16_t      seq;
+    uint8_t       ttl;
+    uint8_t       outcome;
+    uint64_t      send_ns;
+    uint64_t      rtt_ns;
+}                 t_binlog_rec;
+
+_Static_assert(sizeof(t_binlog_hdr) == 64, "binlog header must stay 64 bytes");
+_Static_assert(sizeof(t_binlog_rec) == 24, "binlog record must stay 24 bytes");
+
+#endif
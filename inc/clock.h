@@ -0,0 +1,77 @@
+#ifndef CLOCK_H
+# define CLOCK_H
+
+/*-----------------------------------------------------------------------------
+                                LIBRARIES
+-----------------------------------------------------------------------------*/
+
+# include <stdint.h>
+# include <sys/time.h>
+
+/*-----------------------------------------------------------------------------
+                                MACROS
+-----------------------------------------------------------------------------*/
+
+/* Period of the wall clock offset refresh and of the TSC recalibration. */
+# define CLOCK_SYNC_NS 1000000000ULL
+/* Span of the first TSC calibration, read from CLOCK_MONOTONIC meanwhile. */
+# define CLOCK_CALIB_NS 50000000ULL
+
+/*-----------------------------------------------------------------------------
+                                STRUCTURES
+-----------------------------------------------------------------------------*/
+
+/*
+ * The loop clock: CLOCK_MONOTONIC, read once per loop iteration or receive
+ * batch by clock_update() and handed down from there, so that every
+ * timestamp of an iteration agrees and RTTs are immune to wall clock steps.
+ * The wall clock is only derived from it, for display and for files read
+ * by other programs, through an offset refreshed every CLOCK_SYNC_NS.
+ *
+ * With the TSC fast path, the clock is extrapolated from the TSC, and
+ * recalibrated against CLOCK_MONOTONIC every CLOCK_SYNC_NS; it never
+ * goes backwards.
+ *
+ * A virtual clock (`virt`) reads nothing: whoever drives it sets `ns`
+ * and the offset, and clock_update() only derives `now` from them.
+ */
+typedef struct        s_clock {
+    struct timeval    now;
+    uint64_t          ns;
+    int64_t           wall_offset_ns;
+    uint64_t          next_sync_ns;
+    _Bool             realtime;
+    _Bool             virt;
+    _Bool             tsc;
+    uint64_t          tsc_base;
+    uint64_t          ns_base;
+    double            ns_per_cycle;
+}                     t_clock;
+
+/*-----------------------------------------------------------------------------
+                                FUNCTIONS
+-----------------------------------------------------------------------------*/
+
+void    clock_init(t_clock *c, _Bool tsc);
+void    clock_update(t_clock *c);
+
+/**
+ * Convert a loop clock time to wall clock time.
+ *
+ * Clocks with `realtime` set already hold wall clock times: those of a
+ * replayed capture.
+ *
+ * @param c: Loop clock.
+ * @param t: Time read from the loop clock.
+ * @param wall: Wall clock time.
+ */
+static inline void clock_wall(const t_clock *c, const struct timeval *t, struct timeval *wall) {
+    int64_t us = (int64_t)t->tv_sec * 1000000 + t->tv_usec;
+
+    if (!c->realtime)
+        us += c->wall_offset_ns / 1000;
+    wall->tv_sec = us / 1000000;
+    wall->tv_usec = us % 1000000;
+}
+
+#endif
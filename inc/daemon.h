@@ -0,0 +1,98 @@
+#ifndef DAEMON_H
+# define DAEMON_H
+
+/*-----------------------------------------------------------------------------
+                                LIBRARIES
+-----------------------------------------------------------------------------*/
+
+# include "clock.h"
+
+# include <stdint.h>
+# include <netinet/ip.h>
+
+/*-----------------------------------------------------------------------------
+                                MACROS
+-----------------------------------------------------------------------------*/
+
+# define DAEMON_SOCKET_ENV "FT_PING_SOCKET"
+# define DAEMON_DEFAULT_PATH "/run/ft_ping.sock"
+# define DAEMON_MAX_CLIENTS 1024
+# define DAEMON_SNDBUF (1 << 20)
+# define DAEMON_MSG_MAX (sizeof(t_dmsg) + IP_MAXPACKET)
+/* Largest echo request a client may send, as -s allows. */
+# define DAEMON_PROBE_MAX (ICMP_HDR_SIZE + ICMP_MAX_BODY_SIZE)
+/* Probes per second each client may send, and the burst it may save up. */
+# define DAEMON_RATE 1000
+# define DAEMON_BURST 1000
+
+/*-----------------------------------------------------------------------------
+                                STRUCTURES
+-----------------------------------------------------------------------------*/
+
+/*
+ * Messages exchanged with the daemon (-X) over its SOCK_SEQPACKET unix
+ * socket, one per packet, a header followed by `len` bytes:
+ *
+ * - DMSG_HELLO, client first. Answered with DMSG_HELLO and the echo
+ *   identifier `ident` assigned to the client: the low 16 bits of its pid,
+ *   or the next free one when another client holds it.
+ * - DMSG_SEND, client: an ICMP echo request with the client's identifier,
+ *   of DAEMON_PROBE_MAX bytes at most, to send to `addr` with time to live
+ *   `ttl`. Beyond DAEMON_RATE per second, after a burst of DAEMON_BURST,
+ *   requests are dropped.
+ * - DMSG_PACKET, daemon: a packet received at `sec`.`usec` on
+ *   CLOCK_MONOTONIC, the clients' loop clock, whose echo identifier, or
+ *   that of the request it quotes, is the client's, followed by the
+ *   whole packet. `len` is its length.
+ * - DMSG_ERROR, daemon: a send failed, or the hello was refused, with
+ *   errno `err`.
+ */
+enum    e_dmsg_type {
+    DMSG_HELLO = 1,
+    DMSG_SEND,
+    DMSG_PACKET,
+    DMSG_ERROR
+};
+
+typedef struct    s_dmsg {
+    uint8_t       type;
+    uint8_t       ttl;
+    uint16_t      ident;
+    uint32_t      addr;
+    uint32_t      len;
+    int32_t       err;
+    int64_t       sec;
+    int64_t       usec;
+}                 t_dmsg;
+
+_Static_assert(sizeof(t_dmsg) == 32, "daemon message header must stay 32 bytes");
+
+typedef struct    s_dclient {
+    int           fd;
+    uint16_t      ident;
+    _Bool         ready;
+    uint64_t      send_ns;
+}                 t_dclient;
+
+typedef struct    s_daemon {
+    int           raw_fd;
+    int           listen_fd;
+    int           nb_clients;
+    t_dclient     clients[DAEMON_MAX_CLIENTS];
+    uint16_t      owner[UINT16_MAX + 1];
+    uint64_t      nb_served;
+    uint64_t      nb_sent;
+    uint64_t      nb_forwarded;
+    uint64_t      nb_unmatched;
+    uint64_t      nb_dropped;
+    uint64_t      nb_limited;
+    t_clock       clock;
+}                 t_daemon;
+
+/*-----------------------------------------------------------------------------
+                                FUNCTIONS
+-----------------------------------------------------------------------------*/
+
+int     daemon_run(const char *path);
+
+#endif
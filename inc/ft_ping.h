@@ -4,8 +4,13 @@
 /*-----------------------------------------------------------------------------
 								LIBRARIES
 -----------------------------------------------------------------------------*/
+# include "binlog.h"
+# include "clock.h"
+# include "daemon.h"
 # include "init.h"
 # include "loop.h"
+# include "probes.h"
+# include "shmstats.h"
 # include "utils.h"
 
 # include "../lib/libft/inc/ft_gc_alloc.h"
@@ -23,6 +28,7 @@
 # include <arpa/inet.h>
 # include <bits/socket.h>
 # include <netinet/in.h>
+# include <netinet/ip.h>
 # include <netinet/ip_icmp.h>
 # include <sys/socket.h>
 # include <sys/time.h>
@@ -33,8 +39,42 @@
 -----------------------------------------------------------------------------*/
 # define IP_TTL_VALUE 64
 # define IP_HDR_SIZE (sizeof(struct iphdr))
+# define IP_MAX_HDR_SIZE 60
 # define ICMP_HDR_SIZE (sizeof(struct icmphdr))
 # define ICMP_BODY_SIZE 56
+# define ICMP_MAX_BODY_SIZE (IP_MAXPACKET - IP_HDR_SIZE - ICMP_HDR_SIZE)
+# define PATTERN_MAX_SIZE 16
+# define PCAP_MAX_IFACES 16
+# define METRICS_RING_SIZE 300
+# define METRICS_MAX_CLIENTS 4
+# define METRICS_BUF_SIZE 8192
+# define WHEEL_TICK_US 100
+# define WHEEL_ROOT_BITS 8
+# define WHEEL_LEVEL_BITS 6
+# define WHEEL_LEVELS 4
+/* Longest probe timeout (-W, -a), in seconds: t_rto.armed holds 32-bit ticks. */
+# define TIMEOUT_MAX_SEC (UINT32_MAX / (1000000 / WHEEL_TICK_US))
+# define PMTU_PROBES 8
+# define PMTU_MIN 68
+# define AIMD_WINDOW 8
+# define AIMD_INCREASE 2.0
+# define AIMD_DECREASE 2.0
+# define AIMD_MIN_RATE 0.1
+# define AIMD_MAX_RATE 1000.0
+/* RFC 6298 gains of the smoothed RTT and of its variation. */
+# define RTO_ALPHA 0.125
+# define RTO_BETA 0.25
+# define RTO_K 4
+# define JITTER_GAIN 16
+# define LOSS_BURST_BINS 64
+# define RTTS_INIT_CAP 1024
+# define PRECISION_RT_PRIO 50
+# define PRECISION_BUSY_POLL_US 50
+# define PRECISION_STACK_PREFAULT (256 * 1024)
+/* The receive buffer holds this long of replies at the probe rate, each
+ * charged its bytes plus the kernel's bookkeeping (sk_buff). */
+# define RCVBUF_HOLD_MS 500
+# define RCVBUF_SKB_OVERHEAD 768
 
 extern _Bool pingloop;
 extern _Bool send_packet;
@@ -47,6 +87,21 @@ enum    e_exitcode {
     E_EXIT_ERR_ARGS = 64
 };
 
+enum    e_pmtu_state {
+    PMTU_IDLE,
+    PMTU_PENDING,
+    PMTU_OK,
+    PMTU_TOO_BIG,
+    PMTU_LOST
+};
+
+enum    e_pkt_class {
+    PKT_FOREIGN,
+    PKT_REPLY,
+    PKT_ERROR,
+    PKT_MALFORMED
+};
+
 /*-----------------------------------------------------------------------------
 								STRUCTURES
 -----------------------------------------------------------------------------*/
@@ -57,28 +112,317 @@ typedef struct    s_options {
     _Bool         timestamp;
     int           count;
     float         interval;
+    float         timeout;
+    int           deadline;
     uint8_t       ttl;
     _Bool         no_dns;
+    _Bool         verify_csum;
+    uint8_t       max_hops;
+    _Bool         pmtu;
+    _Bool         adaptive;
+    int           size;
+    char          *metrics_path;
+    char          *replay_path;
+    char          *log_path;
+    char          *shm_name;
+    _Bool         daemon;
+    _Bool         tsc;
+    uint8_t       pattern[PATTERN_MAX_SIZE];
+    int           pattern_len;
+    _Bool         random_payload;
+    _Bool         precision;
+    int           cpu;
+    _Bool         adaptive_rto;
+    float         rto_min;
+    float         rto_max;
 }                 t_options;
 
-typedef struct      s_rtt_node {
-    struct timeval  val;
-    struct s_rtt_node *next;
-}                   t_rtt_node;
+/*
+ * Per-hop state of a TTL sweep, laid out as one array per field, all in
+ * a single allocation: scans over the hops (pending probes every round,
+ * counters for the table) read only the columns they need, contiguous.
+ * The hot columns come first; addr, only read to print the table, last.
+ * Times are in microseconds. A hop costs 37 bytes.
+ *
+ * Every probe of a round goes out at round_time.
+ */
+typedef struct        s_hops {
+    struct timeval    round_time;
+    uint64_t          *total_us;
+    uint32_t          *history;
+    uint32_t          *nb_send;
+    uint32_t          *nb_recv;
+    uint32_t          *last_us;
+    uint32_t          *best_us;
+    uint32_t          *worst_us;
+    struct in_addr    *addr;
+    uint8_t           *pending;
+}                     t_hops;
+
+typedef struct        s_pmtu_probe {
+    uint16_t          size;
+    uint8_t           state;
+}                     t_pmtu_probe;
+
+typedef struct        s_pmtu {
+    uint16_t          lo;
+    uint16_t          hi;
+    uint16_t          hint;
+    struct in_addr    hint_from;
+    int               nb_rounds;
+    int               nb_pending;
+    t_pmtu_probe      probes[PMTU_PROBES];
+}                     t_pmtu;
+
+typedef struct        s_aimd {
+    double            rate;
+    double            loss_rate;
+    uint64_t          cut_sent;
+    int               window;
+    uint64_t          last_change;
+    uint64_t          first_cut;
+    int               first_cut_sent;
+    int               nb_increase;
+    int               nb_cut_loss;
+    int               nb_cut_quench;
+}                     t_aimd;
+
+/*
+ * Adaptive probe timeout (-a), as TCP's retransmission timeout (RFC 6298):
+ * a smoothed RTT and RTT variation, in microseconds, give the time each
+ * new probe waits, doubled on every timeout until the next answer. The
+ * timeout every probe was armed with is kept for the result log.
+ */
+typedef struct        s_rto {
+    double            srtt;
+    double            rttvar;
+    double            rto;
+    double            min;
+    double            max;
+    uint64_t          nb_samples;
+    uint64_t          nb_backoff;
+    uint32_t          armed[UINT16_MAX + 1];
+}                     t_rto;
+
+/*
+ * Streaming delay variation, updated once per reply in constant time and
+ * space. Delays are RTTs in microseconds; the RTT delta of a reply is its
+ * RTT minus the previous reply's, in arrival order.
+ *
+ * mean and m2 are Welford's running mean and sum of squared deviations.
+ * jitter is the RFC 3550 interarrival jitter, the RTT deltas smoothed with
+ * gain 1/JITTER_GAIN. ipdv is the RFC 5481 IPDV, the RTT delta of replies
+ * to consecutive sequence numbers, the only pairs it is defined on;
+ * has_ipdv tells whether the last reply had one.
+ * delta_hist counts absolute RTT deltas in the log-linear bins of the
+ * live statistics (shm_hist_bin()).
+ */
+typedef struct        s_jitter {
+    uint64_t          nb;
+    double            mean;
+    double            m2;
+    int64_t           last_rtt;
+    uint16_t          last_seq;
+    double            jitter;
+    uint64_t          nb_ipdv;
+    _Bool             has_ipdv;
+    int64_t           ipdv;
+    int64_t           ipdv_min;
+    int64_t           ipdv_max;
+    uint64_t          nb_delta;
+    uint32_t          delta_hist[SHM_HIST_BINS];
+}                     t_jitter;
+
+/*
+ * Probe outcomes, in send order. The outcome of the last 65536 probes is
+ * the seq_seen bitmap (a reply was seen or not); a probe leaves it when
+ * its sequence number is reused, or at the end of the run, and is folded
+ * into the run of equal outcomes it extends. Closed runs only feed the
+ * counters below, so memory does not grow with the length of the run.
+ *
+ * sent_ms holds the send time of each sequence number, in milliseconds
+ * since pi->start_time. burst_hist counts loss bursts by power of two of
+ * their length. nb_to_lost and nb_to_recv count the transitions between
+ * outcomes, from which the Gilbert-Elliott parameters are estimated.
+ */
+typedef struct        s_lossmap {
+    uint32_t          *sent_ms;
+    uint16_t          first_seq;
+    uint64_t          nb_folded;
+    _Bool             run_lost;
+    uint64_t          run_len;
+    uint32_t          run_start_ms;
+    uint64_t          nb_recv;
+    uint64_t          nb_lost;
+    uint64_t          nb_to_lost;
+    uint64_t          nb_to_recv;
+    uint64_t          nb_bursts;
+    uint64_t          burst_hist[LOSS_BURST_BINS];
+    uint64_t          longest;
+    uint32_t          longest_start_ms;
+    uint32_t          longest_end_ms;
+    _Bool             longest_open;
+}                     t_lossmap;
+
+typedef struct        s_bucket {
+    time_t            sec;
+    uint32_t          nb_send;
+    uint32_t          nb_recv;
+    uint32_t          nb_timeout;
+    uint32_t          rtt_min;
+    uint32_t          rtt_max;
+    uint64_t          rtt_sum;
+    uint64_t          rtt_sq_sum;
+}                     t_bucket;
+
+typedef struct        s_metrics_client {
+    int               fd;
+    _Bool             replying;
+    size_t            len;
+    size_t            off;
+    char              buf[METRICS_BUF_SIZE];
+}                     t_metrics_client;
+
+typedef struct        s_metrics {
+    int               listen_fd;
+    char              *path;
+    t_bucket          ring[METRICS_RING_SIZE];
+    t_metrics_client  clients[METRICS_MAX_CLIENTS];
+    const t_clock     *clock;
+}                     t_metrics;
+
+typedef struct        s_pcap_iface {
+    uint32_t          linktype;
+    uint64_t          ts_per_sec;
+}                     t_pcap_iface;
+
+typedef struct        s_source {
+    ssize_t           (*next)(struct s_source *src, uint8_t *buf, size_t size, struct timeval *ts);
+    ssize_t           (*send)(struct s_source *src, const uint8_t *buf, size_t len,
+                          const struct sockaddr_in *dst, uint8_t ttl);
+    void              (*close)(struct s_source *src);
+    int               fd;
+    uint8_t           ttl;
+    _Bool             eof;
+    uint8_t           *map;
+    size_t            map_len;
+    size_t            off;
+    _Bool             swapped;
+    _Bool             pcapng;
+    t_pcap_iface      ifaces[PCAP_MAX_IFACES];
+    int               nb_ifaces;
+    size_t            nb_packets;
+    uint32_t          drops;
+}                     t_source;
+
+typedef struct        s_pkt {
+    uint8_t           *buf;
+    ssize_t           len;
+    size_t            size;
+    struct timeval    ts;
+    uint8_t           cls;
+    uint8_t           ttl;
+    uint16_t          seq;
+    uint16_t          icmp_off;
+    uint16_t          quote_off;
+    uint16_t          echo_off;
+}                     t_pkt;
+
+typedef struct        s_timer {
+    struct s_timer    *next;
+    struct s_timer    *prev;
+    uint64_t          expires;
+    void              (*fn)(struct s_timer *timer, void *ctx);
+    uint32_t          id;
+}                     t_timer;
+
+typedef struct        s_wheel {
+    uint64_t          now;
+    t_timer           root[1 << WHEEL_ROOT_BITS];
+    t_timer           levels[WHEEL_LEVELS][1 << WHEEL_LEVEL_BITS];
+}                     t_wheel;
+
+typedef struct        s_binlog {
+    const char        *path;
+    uint32_t          target;
+    int               fd;
+    uint8_t           *map;
+    t_binlog_hdr      *hdr;
+    t_binlog_rec      *recs;
+    size_t            synced;
+    unsigned          segment;
+    t_timer           sync_timer;
+    const t_clock     *clock;
+}                     t_binlog;
+
+typedef struct        s_shmstats {
+    char              name[SHM_NAME_MAX];
+    t_shm_stats       *map;
+    const t_clock     *clock;
+}                     t_shmstats;
+
+typedef struct        s_counters {
+    uint64_t          nb_send_calls;
+    uint64_t          bytes_sent;
+    uint64_t          nb_recv_calls;
+    uint64_t          nb_eagain;
+    uint64_t          nb_foreign;
+    uint64_t          nb_malformed;
+    uint64_t          nb_timeout;
+    uint64_t          bytes_recv;
+    uint64_t          cycles_send;
+    uint64_t          cycles_recv;
+    uint64_t          cycles_process;
+    uint64_t          cycles_print;
+    uint64_t          loop_last_ns;
+    uint64_t          loop_max_ns;
+    uint64_t          nb_loops;
+    uint64_t          loop_hist[SHM_HIST_BINS];
+}                     t_counters;
 
 typedef struct        s_packinfo {
     int               nb_send;
     int               nb_ok;
     int               nb_recv;
-    struct timeval    *min;
-    struct timeval    *max;
+    int               nb_dup;
+    int               nb_corrupt;
+    int               nb_local_drop;
+    uint16_t          ident;
+    struct timeval    min;
+    struct timeval    max;
     struct timeval    avg;
     struct timeval    stddev;
     struct timeval    start_time;
     struct timeval    end_time;
     struct timeval    last_send_time;
-    t_rtt_node        *rtt_list;
-    t_rtt_node        *rtt_last;
+    uint32_t          *rtts;
+    size_t            nb_rtts;
+    size_t            rtts_cap;
+    struct timeval    rtt_last;
+    t_hops            *hops;
+    int               nb_hops;
+    int               path_len;
+    uint16_t          round_seq;
+    uint16_t          body_size;
+    t_pmtu            *pmtu;
+    t_aimd            *aimd;
+    t_rto             *rto;
+    t_metrics         *metrics;
+    t_counters        ctr;
+    t_wheel           *wheel;
+    t_timer           *probe_timers;
+    uint64_t          probe_timeout;
+    int               nb_pending;
+    t_binlog          *binlog;
+    t_shmstats        *shm;
+    t_clock           clock;
+    t_jitter          jitter;
+    t_lossmap         *lossmap;
+    const uint8_t     *payload;
+    uint8_t           *recv_bufs;
+    size_t            recv_size;
+    struct timeval    *replay_sent;
+    uint8_t           seq_seen[(UINT16_MAX + 1) / 8];
 }                     t_packinfo;
 
 typedef struct            s_sockinfo {
@@ -101,6 +445,32 @@ static inline void * skip_icmphdr(void *buf){
     return (void *)((uint8_t *)buf + ICMP_HDR_SIZE);
 }
 
+/**
+ * Convert a duration in seconds to timer wheel ticks.
+ */
+static inline uint64_t sec_to_ticks(double sec) {
+    return (uint64_t)(sec * (1000000 / WHEEL_TICK_US) + 0.5);
+}
+
+/**
+ * Account for one probe loop iteration: the time since the previous one
+ * is the longest a packet that arrived meanwhile waited to be stamped.
+ *
+ * @param c: Probe loop counters.
+ * @param ns: Loop clock of this iteration, in nanoseconds.
+ */
+static inline void counters_on_loop(t_counters *c, uint64_t ns) {
+    uint64_t gap = ns - c->loop_last_ns;
+
+    if (c->loop_last_ns) {
+        c->loop_hist[shm_hist_bin(gap)]++;
+        c->nb_loops++;
+        if (gap > c->loop_max_ns)
+            c->loop_max_ns = gap;
+    }
+    c->loop_last_ns = ns;
+}
+
 
 int check_rights(void);
 int parse_args(int argc, char **argv, char **host, t_options *opts);
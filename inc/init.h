@@ -7,6 +7,9 @@
 
 # include "ft_ping.h"
 
+# include <limits.h>
+# include <sys/stat.h>
+
 /*-----------------------------------------------------------------------------
                                 MACROS
 -----------------------------------------------------------------------------*/
@@ -20,6 +23,10 @@ typedef struct s_sockinfo   t_sockinfo;
 /*-----------------------------------------------------------------------------
                                 FUNCTIONS
 -----------------------------------------------------------------------------*/
-int init_sock(int *sock_fd, t_sockinfo *si, char *host, int ttl);
+int init_addr(t_sockinfo *si, char *host);
+int init_sock(int *sock_fd, t_sockinfo *si, char *host, int ttl, _Bool dont_frag, _Bool busy_poll, int rcvbuf);
+int rcvbuf_size(double rate, int reply_size);
+int init_raw_socket(void);
+int unlink_stale_socket(const char *path);
 
 #endif
\ No newline at end of file
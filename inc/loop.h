@@ -12,7 +12,14 @@
                                 MACROS
 -----------------------------------------------------------------------------*/
 
-# define RECV_PACK_SIZE ((IP_HDR_SIZE + ICMP_HDR_SIZE) * 2 + ICMP_BODY_SIZE + 1)
+# define RECV_PACK_SIZE ((IP_MAX_HDR_SIZE + ICMP_HDR_SIZE) * 2 + ICMP_BODY_SIZE + 1)
+# define RECV_BATCH 16
+# define PAYLOAD_MAX_SIZE (ICMP_MAX_BODY_SIZE - sizeof(struct timeval))
+# define PAYLOAD_REPORT_MAX 4
+
+/* ICMP types that quote the offending datagram (RFC 792). */
+# define ICMP_ERR_TYPES ((1U << ICMP_DEST_UNREACH) | (1U << ICMP_SOURCE_QUENCH) \
+    | (1U << ICMP_REDIRECT) | (1U << ICMP_TIME_EXCEEDED) | (1U << ICMP_PARAMETERPROB))
 
 /*-----------------------------------------------------------------------------
                                 STRUCTURES
@@ -21,16 +28,104 @@
 typedef struct s_packinfo   t_packinfo;
 typedef struct s_sockinfo   t_sockinfo;
 typedef struct s_options    t_options;
-typedef struct s_rtt_node   t_rtt_node;
+typedef struct s_hops       t_hops;
+typedef struct s_metrics    t_metrics;
+typedef struct s_source     t_source;
+typedef struct s_timer      t_timer;
+typedef struct s_wheel      t_wheel;
+typedef struct s_binlog     t_binlog;
+typedef struct s_pkt        t_pkt;
+typedef struct s_pmtu       t_pmtu;
+typedef struct s_aimd       t_aimd;
+typedef struct s_rto        t_rto;
+typedef struct s_shmstats   t_shmstats;
+typedef struct s_jitter     t_jitter;
+typedef struct s_lossmap    t_lossmap;
 
 /*-----------------------------------------------------------------------------
                                 FUNCTIONS
 -----------------------------------------------------------------------------*/
-int         icmp_recv_ping(int sock_fd, t_packinfo *pi, const t_options *opts, const t_sockinfo *si);
-int         icmp_send_ping(int sock_fd, const t_sockinfo *si, t_packinfo *pi);
+unsigned short checksum(unsigned short *ptr, int nbytes);
+int         icmp_probes_init(t_packinfo *pi, t_wheel *wheel, uint64_t timeout);
+void        icmp_arm_probe(t_packinfo *pi, uint16_t seq);
+_Bool       icmp_disarm_probe(t_packinfo *pi, uint16_t seq);
+void        icmp_probes_clean(t_packinfo *pi);
+uint8_t     *icmp_payload(void);
+void        icmp_echo_sent(const t_packinfo *pi, const struct icmphdr *icmph, struct timeval *sent);
+int         fill_icmp_echo_packet(uint8_t *buf, int packet_len, uint16_t ident, uint16_t seq, const struct timeval *sent);
+void        classify_batch(t_pkt *pkts, size_t n, uint16_t ident, _Bool verify_csum, _Bool check_stamp);
+int         icmp_handle_packet(const t_pkt *pkt, t_packinfo *pi, const t_options *opts, const t_sockinfo *si);
+int         icmp_process_packet(uint8_t *buf, ssize_t nb_bytes, const struct timeval *t_recv, t_packinfo *pi, const t_options *opts, const t_sockinfo *si);
+int         icmp_recv_ping(t_source *src, t_packinfo *pi, const t_options *opts, const t_sockinfo *si);
+int         icmp_send_ping(t_source *src, const t_sockinfo *si, t_packinfo *pi);
+int         icmp_send_ttl_probe(t_source *src, const t_sockinfo *si, uint8_t ttl, uint16_t ident, uint16_t seq,
+                const struct timeval *sent);
+int         icmp_send_sized_probe(t_source *src, const t_sockinfo *si, uint16_t ident, uint16_t seq, uint16_t body_size,
+                const struct timeval *sent);
 void        rtts_calc_stats(t_packinfo *pi);
-void        calc_stddev(t_packinfo *pi, long nb_elem);
 void        rtts_clean(t_packinfo *pi);
-t_rtt_node  *rtts_save_new(t_packinfo *pi, struct icmphdr *icmph);
+int         rtts_save_new(t_packinfo *pi, struct icmphdr *icmph, const struct timeval *t_recv);
+void        jitter_on_reply(t_jitter *j, uint16_t seq, const struct timeval *rtt);
+double      jitter_stddev(const t_jitter *j);
+uint64_t    jitter_delta_quantile(const t_jitter *j, double q);
+int         lossmap_init(t_packinfo *pi);
+void        lossmap_on_send(t_packinfo *pi, uint16_t seq, const struct timeval *sent);
+void        lossmap_finish(t_packinfo *pi);
+void        lossmap_wall(const t_packinfo *pi, uint32_t ms, struct timeval *wall);
+void        lossmap_clean(t_packinfo *pi);
+int         precision_enter(int cpu);
+int         sweep_init(t_packinfo *pi, uint8_t max_hops);
+int         sweep_send_round(t_source *src, const t_sockinfo *si, t_packinfo *pi);
+int         sweep_recv(t_packinfo *pi, const t_pkt *pkt, const t_sockinfo *si);
+void        sweep_check_timeouts(t_packinfo *pi);
+void        sweep_expired(t_packinfo *pi, uint16_t seq);
+void        sweep_clean(t_packinfo *pi);
+int         pmtu_init(t_packinfo *pi, const t_sockinfo *si, int max_size);
+int         pmtu_send_round(t_source *src, const t_sockinfo *si, t_packinfo *pi);
+int         pmtu_recv(t_packinfo *pi, const t_pkt *pkt, const t_sockinfo *si);
+void        pmtu_expired(t_packinfo *pi, uint16_t seq);
+void        pmtu_clean(t_packinfo *pi);
+int         aimd_init(t_packinfo *pi, float interval);
+double      aimd_interval(const t_packinfo *pi);
+void        aimd_on_reply(t_packinfo *pi, uint16_t seq);
+void        aimd_on_loss(t_packinfo *pi, uint16_t seq);
+void        aimd_on_quench(t_packinfo *pi, uint16_t seq);
+double      aimd_settled_rate(const t_packinfo *pi);
+void        aimd_clean(t_packinfo *pi);
+int         rto_init(t_packinfo *pi, const t_options *opts);
+uint64_t    rto_arm(t_rto *r, uint16_t seq);
+void        rto_on_reply(t_rto *r, const struct timeval *rtt);
+void        rto_on_timeout(t_rto *r);
+void        rto_clean(t_packinfo *pi);
+int         payload_init(t_packinfo *pi, const t_options *opts);
+size_t      payload_check(t_packinfo *pi, const t_pkt *pkt, const t_options *opts);
+int         metrics_init(t_packinfo *pi, char *path);
+void        metrics_on_send(t_metrics *m);
+void        metrics_on_reply(t_metrics *m, const struct timeval *sent, const struct timeval *rtt, _Bool late);
+void        metrics_on_timeout(t_metrics *m, const struct timeval *sent);
+void        metrics_serve(const t_sockinfo *si, const t_packinfo *pi);
+void        metrics_clean(t_packinfo *pi);
+void        source_open_socket(t_source *src, int sock_fd);
+int         source_open_daemon(t_source *src, const char *path, uint16_t *ident, uint8_t ttl);
+int         source_open_pcap(t_source *src, const char *path);
+int         source_replay(t_source *src, t_packinfo *pi, const t_options *opts, const t_sockinfo *si);
+uint64_t    wheel_clock(const t_clock *c);
+void        wheel_init(t_wheel *w, uint64_t now);
+void        wheel_add(t_wheel *w, t_timer *t, uint64_t expires);
+_Bool       wheel_cancel(t_timer *t);
+void        wheel_fire(t_timer *t, void *ctx);
+void        wheel_flush(t_wheel *w, void *ctx);
+void        wheel_advance(t_wheel *w, uint64_t now, void *ctx);
+uint64_t    wheel_next_expiry(const t_wheel *w);
+int         binlog_init(t_packinfo *pi, const char *path, uint32_t target);
+void        binlog_append(t_binlog *log, uint32_t target, uint16_t seq, uint8_t ttl, uint8_t outcome,
+                const struct timeval *sent, const struct timeval *rtt);
+void        binlog_clean(t_packinfo *pi);
+int         shmstats_init(t_packinfo *pi, const char *name, uint32_t target);
+void        shmstats_on_send(t_shmstats *s);
+void        shmstats_on_reply(t_shmstats *s, const struct timeval *rtt, _Bool late);
+void        shmstats_on_dup(t_shmstats *s);
+void        shmstats_on_timeout(t_shmstats *s);
+void        shmstats_clean(t_packinfo *pi);
 
 #endif
\ No newline at end of file
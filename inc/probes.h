@@ -0,0 +1,94 @@
+#ifndef PROBES_H
+# define PROBES_H
+
+/*-----------------------------------------------------------------------------
+                                LIBRARIES
+-----------------------------------------------------------------------------*/
+
+# include <stdint.h>
+# include <time.h>
+
+# if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+# endif
+
+/*-----------------------------------------------------------------------------
+                                MACROS
+-----------------------------------------------------------------------------*/
+
+/*
+ * USDT probes, visible to bpftrace/perf/systemtap as usdt:ft_ping:<name>.
+ * When systemtap's <sys/sdt.h> is available it is used as is; otherwise the
+ * same .note.stapsdt entries are emitted here. Every argument is passed as a
+ * 64-bit integer. A probe site costs a single nop when nobody traces it.
+ */
+# if defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#   include <sys/sdt.h>
+#   define FT_PING_HAVE_SDT 1
+#  endif
+# endif
+
+# if defined(FT_PING_HAVE_SDT)
+#  define PROBE1(name, a1) DTRACE_PROBE1(ft_ping, name, (int64_t)(a1))
+#  define PROBE2(name, a1, a2) DTRACE_PROBE2(ft_ping, name, (int64_t)(a1), (int64_t)(a2))
+# elif defined(__x86_64__) || defined(__aarch64__)
+#  define PROBE_NOTE(name, args) \
+	"990: nop\n" \
+	".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+	".balign 4\n" \
+	".4byte 992f-991f, 994f-993f, 3\n" \
+	"991: .asciz \"stapsdt\"\n" \
+	"992: .balign 4\n" \
+	"993: .8byte 990b\n" \
+	".8byte _.stapsdt.base\n" \
+	".8byte 0\n" \
+	".asciz \"ft_ping\"\n" \
+	".asciz \"" #name "\"\n" \
+	".asciz \"" args "\"\n" \
+	"994: .balign 4\n" \
+	".popsection\n" \
+	".ifndef _.stapsdt.base\n" \
+	".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+	".weak _.stapsdt.base\n" \
+	".hidden _.stapsdt.base\n" \
+	"_.stapsdt.base: .space 1\n" \
+	".size _.stapsdt.base, 1\n" \
+	".popsection\n" \
+	".endif\n"
+#  define PROBE1(name, a1) \
+	__asm__ __volatile__(PROBE_NOTE(name, "-8@%0") :: "r"((int64_t)(a1)))
+#  define PROBE2(name, a1, a2) \
+	__asm__ __volatile__(PROBE_NOTE(name, "-8@%0 -8@%1") :: "r"((int64_t)(a1)), "r"((int64_t)(a2)))
+# else
+#  define PROBE1(name, a1) ((void)(a1))
+#  define PROBE2(name, a1, a2) ((void)(a1), (void)(a2))
+# endif
+
+# if defined(__x86_64__) || defined(__i386__)
+#  define CYCLES_UNIT "cycles"
+# else
+#  define CYCLES_UNIT "ns"
+# endif
+
+/*-----------------------------------------------------------------------------
+                                FUNCTIONS
+-----------------------------------------------------------------------------*/
+
+/**
+ * Read a cheap, monotonic tick counter for the per-stage timers.
+ *
+ * The TSC on x86, CLOCK_MONOTONIC in nanoseconds elsewhere (see CYCLES_UNIT).
+ */
+static inline uint64_t cycles_now(void) {
+# if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+# else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+# endif
+}
+
+#endif
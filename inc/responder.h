@@ -0,0 +1,87 @@
+#ifndef RESPONDER_H
+# define RESPONDER_H
+
+/*-----------------------------------------------------------------------------
+                                LIBRARIES
+-----------------------------------------------------------------------------*/
+
+# include "ft_ping.h"
+
+# include <poll.h>
+# include <stdint.h>
+
+/*-----------------------------------------------------------------------------
+                                MACROS
+-----------------------------------------------------------------------------*/
+
+# define RESP_DEFAULT_ADDR "10.200.0.1"
+# define RESP_DEFAULT_IFNAME "ftping0"
+# define RESP_DEFAULT_REORDER_MS 10
+# define RESP_MTU 1500
+# define RESP_QUEUE_SIZE 4096
+
+/*-----------------------------------------------------------------------------
+                                STRUCTURES
+-----------------------------------------------------------------------------*/
+
+enum    e_delay_dist {
+    DIST_CONST,
+    DIST_UNIFORM,
+    DIST_NORMAL,
+    DIST_EXP
+};
+
+typedef struct          s_resp_conf {
+    char                *addr;
+    char                *ifname;
+    double              delay_ms;
+    double              jitter_ms;
+    enum e_delay_dist   dist;
+    double              loss;
+    double              dup;
+    double              reorder;
+    double              reorder_ms;
+    double              rate;
+    double              corrupt;
+    uint64_t            seed;
+}                       t_resp_conf;
+
+typedef struct          s_resp_stats {
+    unsigned long       nb_requests;
+    unsigned long       nb_replies;
+    unsigned long       nb_lost;
+    unsigned long       nb_dup;
+    unsigned long       nb_reordered;
+    unsigned long       nb_limited;
+    unsigned long       nb_overflow;
+    unsigned long       nb_corrupt;
+}                       t_resp_stats;
+
+typedef struct          s_pending {
+    uint64_t            due_ns;
+    uint16_t            len;
+    uint8_t             *pkt;
+}                       t_pending;
+
+typedef struct          s_resp {
+    int                 tun_fd;
+    const t_resp_conf   *conf;
+    uint64_t            rng;
+    double              tokens;
+    uint64_t            last_refill_ns;
+    t_pending           queue[RESP_QUEUE_SIZE];
+    int                 queue_len;
+    uint8_t             *slab;
+    uint16_t            free_slots[RESP_QUEUE_SIZE];
+    int                 nb_free;
+    t_resp_stats        stats;
+}                       t_resp;
+
+/*-----------------------------------------------------------------------------
+                                FUNCTIONS
+-----------------------------------------------------------------------------*/
+int     resp_init(t_resp *resp, const t_resp_conf *conf);
+int     resp_poll(t_resp *resp);
+void    resp_clean(t_resp *resp);
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef SHMSTATS_H
+# define SHMSTATS_H
+
+/*-----------------------------------------------------------------------------
+                                LIBRARIES
+-----------------------------------------------------------------------------*/
+
+# include <stdint.h>
+# include <string.h>
+
+/*-----------------------------------------------------------------------------
+                                MACROS
+-----------------------------------------------------------------------------*/
+
+# define SHM_MAGIC "FTPSHM\0\0"
+# define SHM_VERSION 1
+# define SHM_NAME_MAX 64
+# define SHM_RING_SIZE 64
+# define SHM_HIST_SUB_BITS 2
+# define SHM_HIST_SUB (1 << SHM_HIST_SUB_BITS)
+# define SHM_HIST_BINS (SHM_HIST_SUB * 24)
+
+/*-----------------------------------------------------------------------------
+                                STRUCTURES
+-----------------------------------------------------------------------------*/
+
+/*
+ * Layout of the live statistics segment (-S). ft_ping is the only writer;
+ * readers map it read-only and copy it under the seqlock: seq is odd while
+ * an update is in progress and bumped twice per update, so a copy taken
+ * between two equal even values of seq is consistent.
+ *
+ * RTTs are in microseconds. The histograms are log-linear, SHM_HIST_SUB
+ * bins per power of two (see shm_hist_bin()), up to about 30 s; the last
+ * bin holds everything above. Slot `sec % SHM_RING_SIZE` holds the counts
+ * of second `sec`.
+ */
+enum    e_shm_state {
+    SHM_RUNNING = 1,
+    SHM_STOPPED
+};
+
+typedef struct    s_shm_slot {
+    int64_t       sec;
+    uint32_t      nb_send;
+    uint32_t      nb_recv;
+    uint32_t      nb_timeout;
+    uint32_t      rtt_min;
+    uint32_t      rtt_max;
+    uint32_t      nb_late;
+    uint64_t      rtt_sum;
+    uint32_t      hist[SHM_HIST_BINS];
+}                 t_shm_slot;
+
+typedef struct    s_shm_stats {
+    char          magic[8];
+    uint32_t      version;
+    uint32_t      size;
+    uint64_t      seq;
+    uint32_t      pid;
+    uint32_t      target;
+    uint32_t      state;
+    uint32_t      reserved;
+    int64_t       start_sec;
+    int64_t       update_usec;
+    uint64_t      nb_send;
+    uint64_t      nb_recv;
+    uint64_t      nb_dup;
+    uint64_t      nb_timeout;
+    uint64_t      rtt_last;
+    uint64_t      rtt_min;
+    uint64_t      rtt_max;
+    uint64_t      rtt_sum;
+    double        rtt_sq_sum;
+    uint64_t      hist[SHM_HIST_BINS];
+    t_shm_slot    ring[SHM_RING_SIZE];
+}                 t_shm_stats;
+
+/*-----------------------------------------------------------------------------
+                                FUNCTIONS
+-----------------------------------------------------------------------------*/
+
+/**
+ * Histogram bin of an RTT, in microseconds.
+ */
+static inline int shm_hist_bin(uint64_t usec) {
+	int e;
+	int bin;
+
+	if (usec < SHM_HIST_SUB)
+		return usec;
+	e = 63 - __builtin_clzll(usec);
+	bin = SHM_HIST_SUB * (e - SHM_HIST_SUB_BITS + 1) + ((usec >> (e - SHM_HIST_SUB_BITS)) - SHM_HIST_SUB);
+	return bin < SHM_HIST_BINS ? bin : SHM_HIST_BINS - 1;
+}
+
+/**
+ * Upper bound of a histogram bin, in microseconds.
+ */
+static inline uint64_t shm_hist_upper(int bin) {
+	int e;
+
+	if (bin < SHM_HIST_SUB)
+		return bin + 1;
+	e = bin / SHM_HIST_SUB + SHM_HIST_SUB_BITS - 1;
+	return (uint64_t)(bin % SHM_HIST_SUB + SHM_HIST_SUB + 1) << (e - SHM_HIST_SUB_BITS);
+}
+
+/**
+ * Take a consistent copy of a live statistics segment.
+ *
+ * Never blocks the writer: the copy is retried until no update overlapped
+ * it, which only takes a few tries since updates are a handful of stores.
+ *
+ * @param shm: Mapped segment.
+ * @param out: Copy of the segment.
+ */
+static inline void shm_stats_read(const t_shm_stats *shm, t_shm_stats *out) {
+	uint64_t seq;
+
+	do {
+		while ((seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE)) & 1)
+			;
+		memcpy(out, (const void *)shm, sizeof(*out));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) != seq);
+}
+
+#endif
@@ -8,6 +8,7 @@
 # include "ft_ping.h"
 
 # include <sys/types.h>
+# include <time.h>
 /*-----------------------------------------------------------------------------
                                 MACROS
 -----------------------------------------------------------------------------*/
@@ -19,14 +20,24 @@
 typedef struct s_packinfo   t_packinfo;
 typedef struct s_sockinfo   t_sockinfo;
 typedef struct s_options    t_options;
+typedef struct s_source     t_source;
+typedef struct s_wheel      t_wheel;
 
 /*-----------------------------------------------------------------------------
                                 FUNCTIONS
 -----------------------------------------------------------------------------*/
 void    handler(int signum);
+int     ping_loop(t_source *src, const t_sockinfo *si, t_packinfo *pi, t_options *opts, t_wheel *wheel);
 void    print_help();
-void    print_start_info(const t_sockinfo *si, const t_options *opts);
+void    print_start_info(const t_sockinfo *si, const t_options *opts, uint16_t ident);
 void    print_end_info(const t_sockinfo *si, t_packinfo *pi);
-int     print_recv_info(void *buf, ssize_t nb_bytes, const t_options *opts, const t_packinfo *pi, const t_sockinfo *si);
+void    print_counters(const t_packinfo *pi);
+void    print_loop_info(const t_packinfo *pi);
+void    print_sweep_info(const t_packinfo *pi);
+void    print_pmtu_info(const t_packinfo *pi);
+void    print_aimd_info(const t_packinfo *pi);
+void    print_err_info(void *buf, const struct timeval *t_recv, const t_options *opts);
+void    print_dup_info(void *buf, ssize_t nb_bytes, const t_options *opts, const t_sockinfo *si);
+int     print_recv_info(void *buf, ssize_t nb_bytes, const struct timeval *t_recv, const t_options *opts, const t_packinfo *pi, const t_sockinfo *si);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,248 @@
+#include "../../inc/ft_ping.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+/*
+ * RTTs are binned in a log-linear histogram: exact below 64 ns, then 64
+ * bins per power of two, so percentiles are within 1/128 of the true value
+ * whatever the number of records, in a fixed 30 KiB.
+ */
+#define HIST_SUB_BITS 6
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_SIZE (HIST_SUB * (64 - HIST_SUB_BITS + 1))
+
+typedef struct    s_filter {
+    uint64_t      from_ns;
+    uint64_t      to_ns;
+    uint32_t      target;
+}                 t_filter;
+
+typedef struct    s_summary {
+    uint64_t      nb_records;
+    uint64_t      nb_reply;
+    uint64_t      nb_timeout;
+    uint64_t      nb_late;
+    uint64_t      nb_dup;
+    uint64_t      first_ns;
+    uint64_t      last_ns;
+    uint64_t      rtt_min;
+    uint64_t      rtt_max;
+    double        rtt_sum;
+    double        rtt_sq_sum;
+    size_t        bytes;
+    uint64_t      hist[HIST_SIZE];
+}                 t_summary;
+
+/**
+ * Print the usage of the analyzer.
+ */
+static void print_usage(void) {
+	ft_printf("Usage: ft_ping_analyze [OPTION...] FILE...\n"
+		"Compute statistics over ft_ping result logs (-L).\n\n"
+		"Options:\n"
+		"\t-f <time>\t\tOnly probes sent at or after <time> (UNIX seconds)\n"
+		"\t-t <time>\t\tOnly probes sent before <time> (UNIX seconds)\n"
+		"\t-a <addr>\t\tOnly results from <addr>\n"
+		"\t-h\t\t\tShow help\n\n");
+}
+
+/**
+ * Histogram bin of an RTT, in nanoseconds.
+ */
+static size_t hist_bin(uint64_t v) {
+	int e;
+
+	if (v < HIST_SUB)
+		return v;
+	e = 63 - __builtin_clzll(v);
+	return HIST_SUB * (e - HIST_SUB_BITS + 1) + ((v >> (e - HIST_SUB_BITS)) - HIST_SUB);
+}
+
+/**
+ * Midpoint value of a histogram bin, in nanoseconds.
+ */
+static uint64_t hist_value(size_t bin) {
+	int e;
+	uint64_t low;
+
+	if (bin < HIST_SUB)
+		return bin;
+	e = bin / HIST_SUB + HIST_SUB_BITS - 1;
+	low = (uint64_t)(bin % HIST_SUB + HIST_SUB) << (e - HIST_SUB_BITS);
+	return low + ((1ULL << (e - HIST_SUB_BITS)) >> 1);
+}
+
+/**
+ * Fold the records of one log file into the summary.
+ *
+ * The file is mapped read-only and scanned once, front to back; live logs
+ * being written by ft_ping can be read too, up to their last full record.
+ *
+ * @param path: Log file.
+ * @param f: Time range and target filter.
+ * @param s: Summary to update.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+static int scan_file(const char *path, const t_filter *f, t_summary *s) {
+	const t_binlog_hdr *hdr;
+	const t_binlog_rec *rec;
+	struct stat st;
+	uint64_t nb;
+	uint8_t *map;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+		ft_printf("ft_ping_analyze: %s: %s\n", path, strerror(errno));
+		if (fd != -1)
+			close(fd);
+		return -1;
+	}
+	if ((size_t)st.st_size < sizeof(*hdr)) {
+		ft_printf("ft_ping_analyze: %s: not a result log\n", path);
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	hdr = (const t_binlog_hdr *)map;
+	if (memcmp(hdr->magic, BINLOG_MAGIC, sizeof(hdr->magic)) || hdr->version != BINLOG_VERSION
+		|| hdr->rec_size != sizeof(*rec)) {
+		ft_printf("ft_ping_analyze: %s: not a result log\n", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+	nb = __atomic_load_n(&hdr->nb_records, __ATOMIC_ACQUIRE);
+	if (nb > (st.st_size - sizeof(*hdr)) / sizeof(*rec))
+		nb = (st.st_size - sizeof(*hdr)) / sizeof(*rec);
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	rec = (const t_binlog_rec *)(map + sizeof(*hdr));
+	for (uint64_t i = 0; i < nb; i++, rec++) {
+		if (rec->send_ns < f->from_ns || rec->send_ns >= f->to_ns
+			|| (f->target && rec->target != f->target))
+			continue;
+		s->nb_records++;
+		s->first_ns = rec->send_ns < s->first_ns ? rec->send_ns : s->first_ns;
+		s->last_ns = rec->send_ns > s->last_ns ? rec->send_ns : s->last_ns;
+		if (rec->outcome == BINLOG_TIMEOUT) {
+			s->nb_timeout++;
+		} else if (rec->outcome == BINLOG_DUP) {
+			s->nb_dup++;
+		} else {
+			if (rec->outcome == BINLOG_LATE)
+				s->nb_late++;
+			s->rtt_min = rec->rtt_ns < s->rtt_min ? rec->rtt_ns : s->rtt_min;
+			s->rtt_max = rec->rtt_ns > s->rtt_max ? rec->rtt_ns : s->rtt_max;
+			s->rtt_sum += rec->rtt_ns;
+			s->rtt_sq_sum += (double)rec->rtt_ns * rec->rtt_ns;
+			s->hist[hist_bin(rec->rtt_ns)]++;
+			s->nb_reply++;
+		}
+	}
+	s->bytes += sizeof(*hdr) + nb * sizeof(*rec);
+	munmap(map, st.st_size);
+	return 0;
+}
+
+/**
+ * Value below which a given fraction of the RTTs fall, in milliseconds.
+ */
+static double percentile(const t_summary *s, double q) {
+	uint64_t rank = (uint64_t)(q * (s->nb_reply - 1)) + 1;
+	uint64_t seen = 0;
+
+	for (size_t i = 0; i < HIST_SIZE; i++) {
+		seen += s->hist[i];
+		if (seen >= rank)
+			return hist_value(i) / 1e6;
+	}
+	return s->rtt_max / 1e6;
+}
+
+/**
+ * Print the statistics in the layout of ft_ping's own summary.
+ *
+ * Every probe has one reply or timeout record; a late reply also has a
+ * timeout record, so it counts as received but not as another probe.
+ */
+static void print_summary(const t_summary *s, double scan_ms) {
+	uint64_t nb_probes = s->nb_reply - s->nb_late + s->nb_timeout;
+	uint64_t nb_lost = s->nb_timeout > s->nb_late ? s->nb_timeout - s->nb_late : 0;
+	double avg;
+
+	printf("--- result log statistics ---\n");
+	printf("%lu packets transmitted, %lu packets received, ", nb_probes, s->nb_reply);
+	if (s->nb_dup)
+		printf("+%lu duplicates, ", s->nb_dup);
+	printf("%d%% packet loss, time %lu ms\n",
+		nb_probes ? (int)(nb_lost * 100 / nb_probes) : 0,
+		s->nb_records ? (s->last_ns - s->first_ns) / 1000000 : 0);
+	if (s->nb_reply) {
+		avg = s->rtt_sum / s->nb_reply;
+		printf("round-trip min/avg/max/stddev = %.3f/%.3f/%.3f/%.3f ms\n",
+			s->rtt_min / 1e6, avg / 1e6, s->rtt_max / 1e6,
+			sqrt(fmax(s->rtt_sq_sum / s->nb_reply - avg * avg, 0.0)) / 1e6);
+		printf("percentiles p50/p90/p99/p99.9 = %.3f/%.3f/%.3f/%.3f ms\n",
+			percentile(s, 0.5), percentile(s, 0.9), percentile(s, 0.99), percentile(s, 0.999));
+	}
+	printf("scanned %lu records, %.1f MB in %.3f ms (%.2f GB/s)\n", s->nb_records,
+		s->bytes / 1e6, scan_ms, scan_ms > 0.0 ? s->bytes / scan_ms / 1e6 : 0.0);
+}
+
+int main(int argc, char **argv) {
+	t_filter f = { .from_ns = 0, .to_ns = UINT64_MAX };
+	struct timespec start;
+	struct timespec end;
+	t_summary *s;
+	int nb_files = 0;
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+		if (argv[i][1] == 'h' || argv[i][2] || i + 1 >= argc) {
+			print_usage();
+			return argv[i][1] == 'h' ? 0 : E_EXIT_ERR_ARGS;
+		}
+		char *arg = argv[++i];
+		switch (argv[i - 1][1]) {
+		case 'f': f.from_ns = atof(arg) * 1e9;
+			break;
+		case 't': f.to_ns = atof(arg) * 1e9;
+			break;
+		case 'a':
+			if (inet_pton(AF_INET, arg, &f.target) != 1) {
+				ft_printf("ft_ping_analyze: invalid address '%s'\n", arg);
+				return E_EXIT_ERR_ARGS;
+			}
+			break;
+		default:
+			ft_printf("ft_ping_analyze: invalid option -- '%c'\n", argv[i - 1][1]);
+			return E_EXIT_ERR_ARGS;
+		}
+	}
+	if (i == argc) {
+		print_usage();
+		return E_EXIT_ERR_ARGS;
+	}
+	if ((s = calloc(1, sizeof(*s))) == NULL)
+		return E_EXIT_ERR_HOST;
+	s->first_ns = UINT64_MAX;
+	s->rtt_min = UINT64_MAX;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (; i < argc; i++)
+		if (scan_file(argv[i], &f, s) == 0)
+			nb_files++;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (nb_files)
+		print_summary(s, (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+	free(s);
+	return nb_files ? E_EXIT_OK : E_EXIT_ERR_HOST;
+}
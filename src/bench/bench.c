@@ -0,0 +1,381 @@
+#include "../../inc/loop.h"
+
+#include <fcntl.h>
+#include <time.h>
+
+#define BENCH_PACKET_SIZE (IP_HDR_SIZE + ICMP_HDR_SIZE + ICMP_BODY_SIZE)
+/* Body of the large echo checked by the payload_check (1400 B) bench. */
+#define BENCH_BIG_BODY 1400
+
+static const size_t sample_counts[] = { 1000, 100000, 1000000 };
+
+static size_t nb_allocs = 0;
+static int out_fd = STDOUT_FILENO;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+/**
+ * Allocation hooks, linked in with -Wl,--wrap so every allocation made by
+ * the code under test is counted.
+ */
+void *__wrap_malloc(size_t size) {
+	nb_allocs++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+	nb_allocs++;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+	nb_allocs++;
+	return __real_realloc(ptr, size);
+}
+
+typedef struct s_bench {
+	const char  *name;
+	void        (*setup)(size_t n);
+	void        (*run)(size_t n);
+	void        (*teardown)(void);
+	size_t      bytes_per_op;
+}               t_bench;
+
+static t_options opts = { .count = -1, .interval = 1.0f, .ttl = 64 };
+static t_sockinfo si = { .host = "bench.local", .str_sin_addr = "10.0.0.1" };
+static t_packinfo pi = {};
+static uint8_t reply[RECV_PACK_SIZE];
+static uint8_t foreign[RECV_PACK_SIZE];
+static uint8_t request[RECV_PACK_SIZE];
+static t_pkt batch[RECV_BATCH];
+static struct timeval t_recv;
+static t_wheel wheel;
+static t_timer *timers;
+static size_t nb_fired;
+static volatile unsigned short sink;
+static t_shmstats shm;
+static t_clock clk;
+static uint8_t big[IP_HDR_SIZE + ICMP_HDR_SIZE + BENCH_BIG_BODY];
+static t_pkt echoed;
+
+/**
+ * Build a synthetic IPv4 + ICMP packet as it would come off the raw socket.
+ *
+ * @param buf: Destination buffer of RECV_PACK_SIZE bytes.
+ * @param type: ICMP type to stamp.
+ * @param id: Echo identifier to stamp.
+ */
+static void build_packet(uint8_t *buf, uint8_t type, uint16_t id) {
+	struct iphdr *ip = (struct iphdr *)buf;
+	struct icmphdr *icmph = skip_iphdr(buf);
+
+	ft_memset(buf, 0, RECV_PACK_SIZE);
+	ip->version = 4;
+	ip->ihl = IP_HDR_SIZE / 4;
+	ip->ttl = 64;
+	ip->protocol = IPPROTO_ICMP;
+	ip->tot_len = htons(BENCH_PACKET_SIZE);
+	inet_pton(AF_INET, si.str_sin_addr, &ip->saddr);
+	fill_icmp_echo_packet((uint8_t *)icmph, ICMP_HDR_SIZE + ICMP_BODY_SIZE, id, 42, &pi.clock.now);
+	icmph->type = type;
+	icmph->checksum = 0;
+	icmph->checksum = checksum((unsigned short *)icmph, ICMP_HDR_SIZE + ICMP_BODY_SIZE);
+	ip->check = checksum((unsigned short *)ip, IP_HDR_SIZE);
+}
+
+/**
+ * Reset the RTT list between runs.
+ */
+static void reset_rtts(void) {
+	rtts_clean(&pi);
+	pi.nb_ok = 0;
+}
+
+static void run_checksum(size_t n) {
+	for (size_t i = 0; i < n; i++)
+		sink = checksum((unsigned short *)skip_iphdr(reply), ICMP_HDR_SIZE + ICMP_BODY_SIZE);
+}
+
+static void run_fill(size_t n) {
+	uint8_t buf[ICMP_HDR_SIZE + ICMP_BODY_SIZE] = {};
+
+	for (size_t i = 0; i < n; i++)
+		fill_icmp_echo_packet(buf, sizeof(buf), pi.ident, i, &pi.clock.now);
+}
+
+static void run_save_new(size_t n) {
+	for (size_t i = 0; i < n; i++)
+		rtts_save_new(&pi, skip_iphdr(reply), &t_recv);
+}
+
+static void run_jitter(size_t n) {
+	struct timeval rtt = { 0, 0 };
+
+	for (size_t i = 0; i < n; i++) {
+		rtt.tv_usec = 1000 + (i * 7919) % 500;
+		jitter_on_reply(&pi.jitter, i, &rtt);
+	}
+}
+
+static void reset_jitter(void) {
+	ft_memset(&pi.jitter, 0, sizeof(pi.jitter));
+}
+
+static void setup_calc_stats(size_t n) {
+	run_save_new(n);
+}
+
+static void run_calc_stats(size_t n) {
+	(void)n;
+	rtts_calc_stats(&pi);
+}
+
+static void setup_print(size_t n) {
+	(void)n;
+	rtts_save_new(&pi, skip_iphdr(reply), &t_recv);
+}
+
+static void run_print(size_t n) {
+	for (size_t i = 0; i < n; i++)
+		print_recv_info(reply, BENCH_PACKET_SIZE, &t_recv, &opts, &pi, &si);
+}
+
+static void run_process_reply(size_t n) {
+	for (size_t i = 0; i < n; i++)
+		icmp_process_packet(reply, BENCH_PACKET_SIZE, &t_recv, &pi, &opts, &si);
+}
+
+static void run_process_foreign(size_t n) {
+	for (size_t i = 0; i < n; i++)
+		icmp_process_packet(foreign, BENCH_PACKET_SIZE, &t_recv, &pi, &opts, &si);
+}
+
+static void run_process_request(size_t n) {
+	for (size_t i = 0; i < n; i++)
+		icmp_process_packet(request, BENCH_PACKET_SIZE, &t_recv, &pi, &opts, &si);
+}
+
+/* A receive batch of replies with a foreign packet and our own request mixed in. */
+static void setup_classify(size_t n) {
+	(void)n;
+	for (size_t i = 0; i < RECV_BATCH; i++) {
+		batch[i].buf = i % 8 == 3 ? foreign : i % 8 == 6 ? request : reply;
+		batch[i].len = BENCH_PACKET_SIZE;
+		batch[i].size = RECV_PACK_SIZE;
+	}
+}
+
+static void run_classify(size_t n) {
+	for (size_t i = 0; i < n; i += RECV_BATCH)
+		classify_batch(batch, n - i < RECV_BATCH ? n - i : RECV_BATCH, pi.ident, 0, 1);
+}
+
+static void run_classify_csum(size_t n) {
+	for (size_t i = 0; i < n; i += RECV_BATCH)
+		classify_batch(batch, n - i < RECV_BATCH ? n - i : RECV_BATCH, pi.ident, 1, 1);
+}
+
+static void timer_fired(t_timer *t, void *ctx) {
+	(void)t;
+	(void)ctx;
+	nb_fired++;
+}
+
+static void setup_wheel(size_t n) {
+	timers = __real_calloc(n, sizeof(*timers));
+	wheel_init(&wheel, 0);
+	nb_fired = 0;
+}
+
+/* Arm n timers spread over ~100 s of ticks, cancel a quarter, expire the rest. */
+static void run_wheel(size_t n) {
+	uint32_t x = 2463534242u;
+
+	for (size_t i = 0; i < n; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		timers[i].fn = timer_fired;
+		wheel_add(&wheel, &timers[i], x % 1000000);
+	}
+	for (size_t i = 0; i < n; i += 4)
+		wheel_cancel(&timers[i]);
+	wheel_advance(&wheel, 1000000, NULL);
+	if (nb_fired != n - (n + 3) / 4)
+		dprintf(out_fd, "wheel: %zu timers fired, expected %zu\n", nb_fired, n - (n + 3) / 4);
+}
+
+static void teardown_wheel(void) {
+	free(timers);
+	timers = NULL;
+}
+
+static void setup_shmstats(size_t n) {
+	(void)n;
+	shm.map = __real_calloc(1, sizeof(*shm.map));
+	shm.clock = &pi.clock;
+}
+
+/* Publish n replies, as the probe loop does with -S; no reader attached. */
+static void run_shmstats(size_t n) {
+	struct timeval rtt = { 0, 0 };
+
+	for (size_t i = 0; i < n; i++) {
+		rtt.tv_usec = 500 + i % 4096;
+		shmstats_on_reply(&shm, &rtt, 0);
+	}
+}
+
+static void teardown_shmstats(void) {
+	free(shm.map);
+	shm.map = NULL;
+}
+
+static void run_gettimeofday(size_t n) {
+	struct timeval tv;
+
+	for (size_t i = 0; i < n; i++)
+		gettimeofday(&tv, NULL);
+	sink = tv.tv_usec;
+}
+
+static void setup_clock(size_t n) {
+	(void)n;
+	clock_init(&clk, 0);
+}
+
+/* Once calibrated, the TSC path runs without a clock_gettime() call. */
+static void setup_clock_tsc(size_t n) {
+	(void)n;
+	clock_init(&clk, 1);
+	usleep(CLOCK_CALIB_NS / 1000 + 1000);
+	clock_update(&clk);
+}
+
+static void run_clock(size_t n) {
+	for (size_t i = 0; i < n; i++)
+		clock_update(&clk);
+	sink = clk.now.tv_usec;
+}
+
+static void setup_payload(size_t n) {
+	(void)n;
+	echoed = (t_pkt){ .buf = reply, .len = BENCH_PACKET_SIZE, .size = RECV_PACK_SIZE, .icmp_off = IP_HDR_SIZE };
+}
+
+static void setup_payload_big(size_t n) {
+	(void)n;
+	pi.body_size = BENCH_BIG_BODY;
+	pi.recv_size = sizeof(big);
+	echoed = (t_pkt){ .buf = big, .len = sizeof(big), .size = sizeof(big), .icmp_off = IP_HDR_SIZE };
+}
+
+static void run_payload(size_t n) {
+	for (size_t i = 0; i < n; i++)
+		sink += payload_check(&pi, &echoed, &opts);
+}
+
+static void teardown_payload(void) {
+	pi.body_size = ICMP_BODY_SIZE;
+	pi.recv_size = RECV_PACK_SIZE;
+}
+
+static const t_bench benches[] = {
+	{ "checksum", NULL, run_checksum, NULL, ICMP_HDR_SIZE + ICMP_BODY_SIZE },
+	{ "fill_icmp_echo_packet", NULL, run_fill, NULL, ICMP_HDR_SIZE + ICMP_BODY_SIZE },
+	{ "rtts_save_new", NULL, run_save_new, reset_rtts, 0 },
+	{ "rtts_calc_stats/sample", setup_calc_stats, run_calc_stats, reset_rtts, 0 },
+	{ "jitter_on_reply", NULL, run_jitter, reset_jitter, 0 },
+	{ "print_recv_info", setup_print, run_print, reset_rtts, 0 },
+	{ "classify_batch", setup_classify, run_classify, NULL, BENCH_PACKET_SIZE },
+	{ "classify_batch (-k)", setup_classify, run_classify_csum, NULL, BENCH_PACKET_SIZE },
+	{ "process (echo reply)", NULL, run_process_reply, reset_rtts, BENCH_PACKET_SIZE },
+	{ "process (foreign reply)", NULL, run_process_foreign, reset_rtts, BENCH_PACKET_SIZE },
+	{ "process (own request)", NULL, run_process_request, reset_rtts, BENCH_PACKET_SIZE },
+	{ "wheel add/cancel/expire", setup_wheel, run_wheel, teardown_wheel, 0 },
+	{ "shmstats_on_reply", setup_shmstats, run_shmstats, teardown_shmstats, 0 },
+	{ "payload_check", setup_payload, run_payload, teardown_payload, ICMP_BODY_SIZE },
+	{ "payload_check (1400 B)", setup_payload_big, run_payload, teardown_payload, BENCH_BIG_BODY },
+	{ "gettimeofday", NULL, run_gettimeofday, NULL, 0 },
+	{ "clock_update", setup_clock, run_clock, NULL, 0 },
+	{ "clock_update (-T)", setup_clock_tsc, run_clock, NULL, 0 },
+};
+
+/**
+ * Return a monotonic timestamp in nanoseconds.
+ */
+static uint64_t now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Run one benchmark for `n` operations and print its line.
+ *
+ * @param b: The benchmark to run.
+ * @param n: Number of operations (or samples for per-sample benchmarks).
+ */
+static void bench_run(const t_bench *b, size_t n) {
+	uint64_t start;
+	uint64_t elapsed;
+	size_t allocs;
+	double ns_op;
+
+	if (b->setup)
+		b->setup(n);
+	allocs = nb_allocs;
+	start = now_ns();
+	b->run(n);
+	elapsed = now_ns() - start;
+	allocs = nb_allocs - allocs;
+	fflush(stdout);
+	if (b->teardown)
+		b->teardown();
+
+	ns_op = (double)elapsed / n;
+	dprintf(out_fd, "%-26s %9zu %10.1f %10.2f %13.0f", b->name, n, ns_op,
+		(double)allocs / n, 1e9 / ns_op);
+	if (b->bytes_per_op)
+		dprintf(out_fd, " %10.1f", b->bytes_per_op * 1e3 / ns_op);
+	dprintf(out_fd, "\n");
+}
+
+/**
+ * Microbenchmarks for the per-packet hot paths.
+ *
+ * Everything runs on synthetic packets: no socket, no root. Output of the
+ * printing paths is sent to /dev/null so only formatting cost is measured.
+ */
+int main(void) {
+	int null_fd;
+
+	pi.ident = getpid();
+	clock_init(&pi.clock, 0);
+	pi.body_size = ICMP_BODY_SIZE;
+	pi.recv_size = RECV_PACK_SIZE;
+	payload_init(&pi, &opts);
+	build_packet(reply, ICMP_ECHOREPLY, pi.ident);
+	build_packet(foreign, ICMP_ECHOREPLY, pi.ident + 1);
+	build_packet(request, ICMP_ECHO, pi.ident);
+	t_recv = pi.clock.now;
+
+	out_fd = dup(STDOUT_FILENO);
+	if (out_fd == -1 || (null_fd = open("/dev/null", O_WRONLY)) == -1) {
+		perror("ft_ping_bench");
+		return 1;
+	}
+	dup2(null_fd, STDOUT_FILENO);
+	close(null_fd);
+
+	dprintf(out_fd, "%-26s %9s %10s %10s %13s %10s\n", "benchmark", "samples",
+		"ns/op", "allocs/op", "ops/s", "MB/s");
+	for (size_t i = 0; i < sizeof(benches) / sizeof(*benches); i++)
+		for (size_t j = 0; j < sizeof(sample_counts) / sizeof(*sample_counts); j++)
+			bench_run(&benches[i], sample_counts[j]);
+	close(out_fd);
+	return 0;
+}
@@ -0,0 +1,159 @@
+#include "../../inc/loop.h"
+
+/**
+ * Set up adaptive pacing, starting from the rate given by -i.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param interval: Initial interval between probes, in seconds.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int aimd_init(t_packinfo *pi, float interval) {
+	t_aimd *a = calloc(1, sizeof(*a));
+
+	if (a == NULL) {
+		ft_printf("ft_ping: cannot allocate rate control state\n");
+		return -1;
+	}
+	a->rate = 1.0 / interval;
+	if (a->rate > AIMD_MAX_RATE)
+		a->rate = AIMD_MAX_RATE;
+	if (a->rate < AIMD_MIN_RATE)
+		a->rate = AIMD_MIN_RATE;
+	a->last_change = pi->wheel->now;
+	pi->aimd = a;
+	return 0;
+}
+
+/**
+ * Interval until the next probe at the current rate.
+ *
+ * @param pi: Pointer to packet tracking info.
+ *
+ * Return the interval in seconds.
+ */
+double aimd_interval(const t_packinfo *pi) {
+	return 1.0 / pi->aimd->rate;
+}
+
+/**
+ * Whether a settled probe was sent at the current rate.
+ *
+ * Probes already in flight when the rate was cut were paced at the old
+ * rate: their answers and losses say nothing about the new one, and
+ * counting their losses would cut again for the same congestion event.
+ *
+ * A settled probe is the last one sent with its sequence number, so its
+ * send index is the last one with those low 16 bits; send indices, unlike
+ * sequence numbers, never wrap.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param seq: Sequence number of the probe.
+ */
+static _Bool aimd_current(const t_packinfo *pi, uint16_t seq) {
+	uint64_t last = (uint64_t)pi->nb_send - 1;
+
+	return last - (uint16_t)(last - seq) >= pi->aimd->cut_sent;
+}
+
+/**
+ * Divide the rate by AIMD_DECREASE and restart the window.
+ *
+ * @param pi: Pointer to packet tracking info.
+ */
+static void aimd_cut(t_packinfo *pi) {
+	t_aimd *a = pi->aimd;
+
+	if (a->nb_cut_loss + a->nb_cut_quench == 1) {
+		a->first_cut = pi->wheel->now;
+		a->first_cut_sent = pi->nb_send;
+	}
+	a->loss_rate = a->rate;
+	a->rate /= AIMD_DECREASE;
+	if (a->rate < AIMD_MIN_RATE)
+		a->rate = AIMD_MIN_RATE;
+	a->cut_sent = pi->nb_send;
+	a->window = 0;
+	a->last_change = pi->wheel->now;
+}
+
+/**
+ * Count an answered probe, and raise the rate by AIMD_INCREASE once
+ * AIMD_WINDOW probes in a row were answered and a probe timeout went by
+ * since the last change: a loss caused by the previous step would only
+ * show up after that long.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param seq: Sequence number of the answered probe.
+ */
+void aimd_on_reply(t_packinfo *pi, uint16_t seq) {
+	t_aimd *a = pi->aimd;
+
+	if (!aimd_current(pi, seq) || ++a->window < AIMD_WINDOW
+		|| pi->wheel->now - a->last_change < pi->probe_timeout)
+		return;
+	a->window = 0;
+	a->last_change = pi->wheel->now;
+	if (a->rate + AIMD_INCREASE <= AIMD_MAX_RATE) {
+		a->rate += AIMD_INCREASE;
+		a->nb_increase++;
+	}
+}
+
+/**
+ * Count a probe that timed out.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param seq: Sequence number of the lost probe.
+ */
+void aimd_on_loss(t_packinfo *pi, uint16_t seq) {
+	if (!aimd_current(pi, seq))
+		return;
+	pi->aimd->nb_cut_loss++;
+	aimd_cut(pi);
+}
+
+/**
+ * Count a source quench quoting one of our probes: a router on the path
+ * asks us to slow down.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param seq: Sequence number of the quoted probe.
+ */
+void aimd_on_quench(t_packinfo *pi, uint16_t seq) {
+	if (!aimd_current(pi, seq))
+		return;
+	pi->aimd->nb_cut_quench++;
+	aimd_cut(pi);
+}
+
+/**
+ * Rate the control loop settled on.
+ *
+ * Once the rate was cut, it saws between the highest rate the path takes
+ * and half of it; the mean rate probes were sent at since the first cut
+ * is what the path sustains. Before that, or if the first cut is too
+ * recent to tell, the current rate.
+ *
+ * @param pi: Pointer to packet tracking info.
+ *
+ * Return the rate in probes per second.
+ */
+double aimd_settled_rate(const t_packinfo *pi) {
+	const t_aimd *a = pi->aimd;
+	uint64_t elapsed = pi->wheel->now - a->first_cut;
+
+	if (a->nb_cut_loss + a->nb_cut_quench == 0 || elapsed < 2 * pi->probe_timeout)
+		return a->rate;
+	return (pi->nb_send - a->first_cut_sent) * (1000000.0 / WHEEL_TICK_US) / elapsed;
+}
+
+/**
+ * Free the rate control state.
+ *
+ * @param pi: Pointer to the packet info structure.
+ */
+void aimd_clean(t_packinfo *pi) {
+	free(pi->aimd);
+	pi->aimd = NULL;
+}
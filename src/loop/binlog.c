@@ -0,0 +1,223 @@
+#include "../../inc/loop.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BINLOG_MAP_SIZE (sizeof(t_binlog_hdr) + (size_t)BINLOG_SEGMENT_RECORDS * sizeof(t_binlog_rec))
+
+/**
+ * Convert a timeval to nanoseconds.
+ */
+static uint64_t tv_to_ns(const struct timeval *tv) {
+	return (uint64_t)tv->tv_sec * 1000000000ULL + (uint64_t)tv->tv_usec * 1000;
+}
+
+/**
+ * Flush the records written since the last sync to the file, asynchronously.
+ *
+ * @param log: Result log.
+ */
+static void binlog_sync(t_binlog *log) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t end = sizeof(t_binlog_hdr) + log->hdr->nb_records * sizeof(t_binlog_rec);
+	size_t start = log->synced & ~(page - 1);
+
+	msync(log->map, page, MS_ASYNC);
+	if (end > start)
+		msync(log->map + start, end - start, MS_ASYNC);
+	log->synced = end;
+}
+
+/**
+ * Timer callback: periodic msync, re-armed for as long as the loop runs.
+ */
+static void binlog_sync_expired(t_timer *t, void *ctx) {
+	t_packinfo *pi = ctx;
+
+	binlog_sync(pi->binlog);
+	if (pingloop)
+		wheel_add(pi->wheel, t, pi->wheel->now + BINLOG_SYNC_SEC * (1000000 / WHEEL_TICK_US));
+}
+
+/**
+ * Open the active log file, appending to it if it is a valid log.
+ *
+ * The file is sized for a whole segment up front (sparse) and mapped
+ * shared, so appending a record is a plain store into the mapping.
+ *
+ * @param log: Result log, with its path set.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+static int binlog_open(t_binlog *log) {
+	struct stat st;
+	int fd;
+
+	if ((fd = open(log->path, O_RDWR | O_CREAT, 0644)) == -1 || fstat(fd, &st) == -1) {
+		ft_printf("ft_ping: %s: %s\n", log->path, strerror(errno));
+		goto err;
+	}
+	if (st.st_size != 0 && (size_t)st.st_size < sizeof(t_binlog_hdr)) {
+		ft_printf("ft_ping: %s: not a result log\n", log->path);
+		goto err;
+	}
+	if ((size_t)st.st_size < BINLOG_MAP_SIZE && ftruncate(fd, BINLOG_MAP_SIZE) == -1) {
+		ft_printf("ft_ping: %s: %s\n", log->path, strerror(errno));
+		goto err;
+	}
+	log->map = mmap(NULL, BINLOG_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (log->map == MAP_FAILED) {
+		log->map = NULL;
+		perror("mmap");
+		goto err;
+	}
+	log->fd = fd;
+	log->hdr = (t_binlog_hdr *)log->map;
+	log->recs = (t_binlog_rec *)(log->map + sizeof(t_binlog_hdr));
+	if (st.st_size == 0) {
+		struct timeval now;
+
+		clock_wall(log->clock, &log->clock->now, &now);
+		memcpy(log->hdr->magic, BINLOG_MAGIC, sizeof(log->hdr->magic));
+		log->hdr->version = BINLOG_VERSION;
+		log->hdr->rec_size = sizeof(t_binlog_rec);
+		log->hdr->created_ns = tv_to_ns(&now);
+	} else if (memcmp(log->hdr->magic, BINLOG_MAGIC, sizeof(log->hdr->magic))
+		|| log->hdr->version != BINLOG_VERSION || log->hdr->rec_size != sizeof(t_binlog_rec)
+		|| log->hdr->nb_records > BINLOG_SEGMENT_RECORDS) {
+		ft_printf("ft_ping: %s: not a result log\n", log->path);
+		munmap(log->map, BINLOG_MAP_SIZE);
+		log->map = NULL;
+		goto err;
+	}
+	log->synced = 0;
+	return 0;
+
+err:
+	if (fd != -1)
+		close(fd);
+	return -1;
+}
+
+/**
+ * Unmap and close the active log file, trimming it to its used size.
+ *
+ * @param log: Result log.
+ */
+static void binlog_close(t_binlog *log) {
+	size_t used;
+
+	if (log->map == NULL)
+		return;
+	used = sizeof(t_binlog_hdr) + log->hdr->nb_records * sizeof(t_binlog_rec);
+	msync(log->map, used, MS_SYNC);
+	munmap(log->map, BINLOG_MAP_SIZE);
+	log->map = NULL;
+	if (ftruncate(log->fd, used) == -1)
+		ft_printf("ft_ping: %s: %s\n", log->path, strerror(errno));
+	close(log->fd);
+}
+
+/**
+ * Move the full active file aside as <path>.<n> and start a new one.
+ *
+ * @param log: Result log.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+static int binlog_rotate(t_binlog *log) {
+	char name[PATH_MAX];
+	struct stat st;
+
+	binlog_close(log);
+	do
+		snprintf(name, sizeof(name), "%s.%u", log->path, log->segment++);
+	while (stat(name, &st) == 0);
+	if (rename(log->path, name) == -1) {
+		ft_printf("ft_ping: %s: %s\n", name, strerror(errno));
+		return -1;
+	}
+	return binlog_open(log);
+}
+
+/**
+ * Open the result log and schedule its periodic sync.
+ *
+ * @param pi: Pointer to packet tracking info; its timer wheel must be set.
+ * @param path: Path of the active log file.
+ * @param target: Address of the probed host, recorded with timeouts.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int binlog_init(t_packinfo *pi, const char *path, uint32_t target) {
+	t_binlog *log = calloc(1, sizeof(*log));
+
+	if (log == NULL) {
+		ft_printf("ft_ping: cannot allocate result log\n");
+		return -1;
+	}
+	log->path = path;
+	log->target = target;
+	log->fd = -1;
+	log->clock = &pi->clock;
+	if (binlog_open(log) == -1) {
+		free(log);
+		return -1;
+	}
+	pi->binlog = log;
+	log->sync_timer.fn = binlog_sync_expired;
+	if (pi->wheel)
+		wheel_add(pi->wheel, &log->sync_timer, pi->wheel->now + BINLOG_SYNC_SEC * (1000000 / WHEEL_TICK_US));
+	return 0;
+}
+
+/**
+ * Append one probe result.
+ *
+ * The record is filled in place, then published by bumping the record
+ * count, so readers of the live file only ever see complete records.
+ *
+ * @param log: Result log, or NULL when logging is disabled.
+ * @param target: Address the result came from (network order).
+ * @param seq: Sequence number of the probe.
+ * @param ttl: TTL of the reply, 0 for a timeout.
+ * @param outcome: One of e_binlog_outcome.
+ * @param sent: Send time of the probe, from the loop clock; the wall clock
+ *        time is recorded.
+ * @param rtt: Round-trip time, or NULL for a timeout.
+ */
+void binlog_append(t_binlog *log, uint32_t target, uint16_t seq, uint8_t ttl, uint8_t outcome,
+		const struct timeval *sent, const struct timeval *rtt) {
+	t_binlog_rec *rec;
+	struct timeval wall;
+
+	if (log == NULL || log->map == NULL)
+		return;
+	if (log->hdr->nb_records == BINLOG_SEGMENT_RECORDS && binlog_rotate(log) == -1)
+		return;
+	rec = &log->recs[log->hdr->nb_records];
+	rec->target = target ? target : log->target;
+	rec->seq = seq;
+	rec->ttl = ttl;
+	rec->outcome = outcome;
+	clock_wall(log->clock, sent, &wall);
+	rec->send_ns = tv_to_ns(&wall);
+	rec->rtt_ns = rtt ? tv_to_ns(rtt) : 0;
+	__atomic_store_n(&log->hdr->nb_records, log->hdr->nb_records + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Flush and close the result log.
+ *
+ * @param pi: Pointer to packet tracking info.
+ */
+void binlog_clean(t_packinfo *pi) {
+	if (pi->binlog == NULL)
+		return;
+	wheel_cancel(&pi->binlog->sync_timer);
+	binlog_close(pi->binlog);
+	free(pi->binlog);
+	pi->binlog = NULL;
+}
@@ -1,6 +1,6 @@
 #include "../../inc/ft_ping.h"
 
-static const char supported_opts[] = "h?qvcDitn";
+static const char supported_opts[] = "h?qvcDitnkMATX";
 
 /**
 * Make sure ping is running with admin rights.
@@ -43,6 +43,16 @@ static int handle_option(char opt, t_options *opts) {
         break;
     case 'n': opts->no_dns = 1;
         break;
+    case 'k': opts->verify_csum = 1;
+        break;
+    case 'M': opts->pmtu = 1;
+        break;
+    case 'A': opts->adaptive = 1;
+        break;
+    case 'T': opts->tsc = 1;
+        break;
+    case 'X': opts->daemon = 1;
+        break;
     default:
         ft_printf("ft_ping: invalid option -- '%c'\n", opt);
         return -1;
@@ -117,7 +127,7 @@ static int handle_interval_option(int argc, char **argv, int *index, t_options *
         return -1;
     }
     char *arg = argv[++(*index)];
-    float val = atoi(arg);
+    float val = atof(arg);
     if (val <= 0.0f) {
         ft_printf("ft_ping: invalid interval '%s'\n", arg);
         return -1;
@@ -126,6 +136,88 @@ static int handle_interval_option(int argc, char **argv, int *index, t_options *
     return 0;
 }
 
+/**
+ * Handle the '-W' option to set how long each probe waits for its reply.
+ *
+ * @param argc The argument count from main().
+ * @param argv The argument vector from main().
+ * @param index Pointer to the current index in argv, will be incremented to access the value.
+ * @param opts Pointer to the options structure where the timeout will be stored.
+ *
+ * @return 0 on success, -1 on failure (e.g., missing value, or not within 0-TIMEOUT_MAX_SEC).
+ */
+static int handle_timeout_option(int argc, char **argv, int *index, t_options *opts) {
+    if (*index + 1 >= argc) {
+        ft_printf("ft_ping: option -W requires an argument\n");
+        return -1;
+    }
+    char *arg = argv[++(*index)];
+    float val = atof(arg);
+    if (val <= 0.0f || val > TIMEOUT_MAX_SEC) {
+        ft_printf("ft_ping: invalid timeout '%s' (must be at most %d s)\n", arg, TIMEOUT_MAX_SEC);
+        return -1;
+    }
+    opts->timeout = val;
+    return 0;
+}
+
+/**
+ * Handle the '-a' option to adapt each probe's timeout to the measured
+ * RTT, between a floor and a ceiling given as `<min>:<max>` seconds.
+ *
+ * @param argc The argument count from main().
+ * @param argv The argument vector from main().
+ * @param index Pointer to the current index in argv, will be incremented to access the value.
+ * @param opts Pointer to the options structure where the bounds will be stored.
+ *
+ * @return 0 on success, -1 on failure (e.g., missing value, or bounds not positive, ordered
+ *         and at most TIMEOUT_MAX_SEC).
+ */
+static int handle_rto_option(int argc, char **argv, int *index, t_options *opts) {
+    char *end;
+
+    if (*index + 1 >= argc) {
+        ft_printf("ft_ping: option -a requires an argument\n");
+        return -1;
+    }
+    char *arg = argv[++(*index)];
+    opts->rto_min = strtof(arg, &end);
+    if (*end == ':')
+        opts->rto_max = strtof(end + 1, &end);
+    if (*end || opts->rto_min <= 0.0f || opts->rto_max < opts->rto_min || opts->rto_max > TIMEOUT_MAX_SEC) {
+        ft_printf("ft_ping: invalid timeout bounds '%s', expected <min>:<max>, at most %d s\n",
+            arg, TIMEOUT_MAX_SEC);
+        return -1;
+    }
+    opts->adaptive_rto = 1;
+    return 0;
+}
+
+/**
+ * Handle the '-w' option to stop after a fixed number of seconds.
+ *
+ * @param argc The argument count from main().
+ * @param argv The argument vector from main().
+ * @param index Pointer to the current index in argv, will be incremented to access the value.
+ * @param opts Pointer to the options structure where the deadline will be stored.
+ *
+ * @return 0 on success, -1 on failure (e.g., missing or non-positive value).
+ */
+static int handle_deadline_option(int argc, char **argv, int *index, t_options *opts) {
+    if (*index + 1 >= argc) {
+        ft_printf("ft_ping: option -w requires an argument\n");
+        return -1;
+    }
+    char *arg = argv[++(*index)];
+    int val = atoi(arg);
+    if (val <= 0) {
+        ft_printf("ft_ping: invalid deadline '%s'\n", arg);
+        return -1;
+    }
+    opts->deadline = val;
+    return 0;
+}
+
 /**
  * Handle the '-t' option to set the TTL (Time To Live).
  *
@@ -154,6 +246,218 @@ static int handle_ttl_option(int argc, char **argv, int *index, t_options *opts)
     return 0;
 }
 
+/**
+ * Handle the '-s' option to set the number of data bytes per packet.
+ *
+ * At least a timeval is needed to carry the send time, and the packet must
+ * fit in an IPv4 datagram. With -M, the size bounds the largest probe.
+ *
+ * @param argc The argument count from main().
+ * @param argv The argument vector from main().
+ * @param index Pointer to the current index in argv, will be incremented to access the size.
+ * @param opts Pointer to the options structure where the size will be stored.
+ *
+ * @return 0 on success, -1 on failure (e.g., missing or out-of-range value).
+ */
+static int handle_size_option(int argc, char **argv, int *index, t_options *opts) {
+    if (*index + 1 >= argc) {
+        ft_printf("ft_ping: option -s requires an argument\n");
+        return -1;
+    }
+    char *arg = argv[++(*index)];
+    int val = atoi(arg);
+    if (val < (int)sizeof(struct timeval) || val > (int)ICMP_MAX_BODY_SIZE) {
+        ft_printf("ft_ping: invalid packet size '%s' (must be %d-%d)\n", arg,
+            (int)sizeof(struct timeval), (int)ICMP_MAX_BODY_SIZE);
+        return -1;
+    }
+    opts->size = val;
+    return 0;
+}
+
+/**
+ * Handle the '-m' option to enable the TTL sweep mode.
+ *
+ * Every round sends one probe per TTL from 1 to the given value at once.
+ *
+ * @param argc The argument count from main().
+ * @param argv The argument vector from main().
+ * @param index Pointer to the current index in argv, will be incremented to access the value.
+ * @param opts Pointer to the options structure where the hop count will be stored.
+ *
+ * @return 0 on success, -1 on failure (e.g., missing or out-of-range value).
+ */
+static int handle_max_hops_option(int argc, char **argv, int *index, t_options *opts) {
+    if (*index + 1 >= argc) {
+        ft_printf("ft_ping: option -m requires an argument\n");
+        return -1;
+    }
+    char *arg = argv[++(*index)];
+    int val = atoi(arg);
+    if (val <= 0 || val > 255) {
+        ft_printf("ft_ping: invalid max hops '%s' (must be 1-255)\n", arg);
+        return -1;
+    }
+    opts->max_hops = (uint8_t)val;
+    return 0;
+}
+
+/**
+ * Handle the '-P' option: precision mode, pinned to the given CPU.
+ *
+ * @param argc The argument count from main().
+ * @param argv The argument vector from main().
+ * @param index Pointer to the current index in argv, will be incremented to access the CPU.
+ * @param opts Pointer to the options structure where the CPU will be stored.
+ *
+ * @return 0 on success, -1 on failure (missing or invalid CPU).
+ */
+static int handle_cpu_option(int argc, char **argv, int *index, t_options *opts) {
+    if (*index + 1 >= argc) {
+        ft_printf("ft_ping: option -P requires an argument\n");
+        return -1;
+    }
+    char *arg = argv[++(*index)];
+    int val = atoi(arg);
+    if (!ft_isdigit(arg[0])) {
+        ft_printf("ft_ping: invalid CPU '%s'\n", arg);
+        return -1;
+    }
+    opts->precision = 1;
+    opts->cpu = val;
+    return 0;
+}
+
+/**
+ * Handle the '-E' option to expose live statistics on a unix socket.
+ *
+ * @param argc The argument count from main().
+ * @param argv The argument vector from main().
+ * @param index Pointer to the current index in argv, will be incremented to access the path.
+ * @param opts Pointer to the options structure where the path will be stored.
+ *
+ * @return 0 on success, -1 on failure (missing path).
+ */
+static int handle_metrics_option(int argc, char **argv, int *index, t_options *opts) {
+    if (*index + 1 >= argc) {
+        ft_printf("ft_ping: option -E requires an argument\n");
+        return -1;
+    }
+    opts->metrics_path = argv[++(*index)];
+    return 0;
+}
+
+/**
+ * Handle the '-r' option to replay a capture file instead of pinging.
+ *
+ * @param argc The argument count from main().
+ * @param argv The argument vector from main().
+ * @param index Pointer to the current index in argv, will be incremented to access the path.
+ * @param opts Pointer to the options structure where the path will be stored.
+ *
+ * @return 0 on success, -1 on failure (missing path).
+ */
+static int handle_replay_option(int argc, char **argv, int *index, t_options *opts) {
+    if (*index + 1 >= argc) {
+        ft_printf("ft_ping: option -r requires an argument\n");
+        return -1;
+    }
+    opts->replay_path = argv[++(*index)];
+    return 0;
+}
+
+/**
+ * Handle the '-L' option to log every probe result to a binary file.
+ *
+ * @param argc The argument count from main().
+ * @param argv The argument vector from main().
+ * @param index Pointer to the current index in argv, will be incremented to access the path.
+ * @param opts Pointer to the options structure where the path will be stored.
+ *
+ * @return 0 on success, -1 on failure (missing path).
+ */
+static int handle_log_option(int argc, char **argv, int *index, t_options *opts) {
+    if (*index + 1 >= argc) {
+        ft_printf("ft_ping: option -L requires an argument\n");
+        return -1;
+    }
+    opts->log_path = argv[++(*index)];
+    return 0;
+}
+
+/**
+ * Handle the '-S' option to publish live statistics in shared memory.
+ *
+ * @param argc The argument count from main().
+ * @param argv The argument vector from main().
+ * @param index Pointer to the current index in argv, will be incremented to access the name.
+ * @param opts Pointer to the options structure where the name will be stored.
+ *
+ * @return 0 on success, -1 on failure (missing name).
+ */
+static int handle_shm_option(int argc, char **argv, int *index, t_options *opts) {
+    if (*index + 1 >= argc) {
+        ft_printf("ft_ping: option -S requires an argument\n");
+        return -1;
+    }
+    opts->shm_name = argv[++(*index)];
+    return 0;
+}
+
+/**
+ * Value of a hex digit.
+ *
+ * @return: The value, or -1 if c is not a hex digit.
+ */
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+        return (c | 0x20) - 'a' + 10;
+    return -1;
+}
+
+/**
+ * Handle the '-p' option to fill the payload with a pattern.
+ *
+ * The pattern is up to PATTERN_MAX_SIZE bytes given in hex, two digits per
+ * byte as for ping, or `random` for random bytes drawn once per run.
+ *
+ * @param argc The argument count from main().
+ * @param argv The argument vector from main().
+ * @param index Pointer to the current index in argv, will be incremented to access the pattern.
+ * @param opts Pointer to the options structure where the pattern will be stored.
+ *
+ * @return 0 on success, -1 on failure (missing or invalid pattern).
+ */
+static int handle_pattern_option(int argc, char **argv, int *index, t_options *opts) {
+    if (*index + 1 >= argc) {
+        ft_printf("ft_ping: option -p requires an argument\n");
+        return -1;
+    }
+    char *arg = argv[++(*index)];
+    size_t len = ft_strlen(arg);
+    if (ft_strcmp(arg, "random") == 0) {
+        opts->random_payload = 1;
+        return 0;
+    }
+    opts->pattern_len = 0;
+    for (size_t i = 0; i < len && opts->pattern_len >= 0; i += 2) {
+        int hi = hex_digit(arg[i]);
+        int lo = i + 1 < len ? hex_digit(arg[i + 1]) : 0;
+
+        if (hi == -1 || lo == -1 || opts->pattern_len == PATTERN_MAX_SIZE)
+            opts->pattern_len = -1;
+        else
+            opts->pattern[opts->pattern_len++] = i + 1 < len ? hi << 4 | lo : hi;
+    }
+    if (opts->pattern_len <= 0) {
+        ft_printf("ft_ping: invalid pattern '%s' (up to %d hex bytes, or random)\n", arg, PATTERN_MAX_SIZE);
+        return -1;
+    }
+    return 0;
+}
+
 /**
 * Parse command-line arguments to extract options and the target host.
 *
@@ -182,6 +486,50 @@ int parse_args(int argc, char **argv, char **host, t_options *opts) {
                 if (handle_ttl_option(argc, argv, &i, opts) == -1)
                     return -1;
                 break;
+            case 'W':
+                if (handle_timeout_option(argc, argv, &i, opts) == -1)
+                    return -1;
+                break;
+            case 'w':
+                if (handle_deadline_option(argc, argv, &i, opts) == -1)
+                    return -1;
+                break;
+            case 'a':
+                if (handle_rto_option(argc, argv, &i, opts) == -1)
+                    return -1;
+                break;
+            case 'm':
+                if (handle_max_hops_option(argc, argv, &i, opts) == -1)
+                    return -1;
+                break;
+            case 's':
+                if (handle_size_option(argc, argv, &i, opts) == -1)
+                    return -1;
+                break;
+            case 'E':
+                if (handle_metrics_option(argc, argv, &i, opts) == -1)
+                    return -1;
+                break;
+            case 'L':
+                if (handle_log_option(argc, argv, &i, opts) == -1)
+                    return -1;
+                break;
+            case 'S':
+                if (handle_shm_option(argc, argv, &i, opts) == -1)
+                    return -1;
+                break;
+            case 'r':
+                if (handle_replay_option(argc, argv, &i, opts) == -1)
+                    return -1;
+                break;
+            case 'P':
+                if (handle_cpu_option(argc, argv, &i, opts) == -1)
+                    return -1;
+                break;
+            case 'p':
+                if (handle_pattern_option(argc, argv, &i, opts) == -1)
+                    return -1;
+                break;
             default:
                 if (parse_option_arg(argv[i], opts) == -1)
                     return -1;
@@ -196,6 +544,12 @@ int parse_args(int argc, char **argv, char **host, t_options *opts) {
         print_help();
         return 1;
     }
+    if (opts->daemon) {
+        if (host_count == 0)
+            return 0;
+        ft_printf("ft_ping: -X takes no host\n");
+        return -1;
+    }
     if (host_count == 0) {
         ft_printf("ft_ping: missing host operand\n");
         return -1;
@@ -203,5 +557,29 @@ int parse_args(int argc, char **argv, char **host, t_options *opts) {
         ft_printf("ft_ping: only one host is allowed\n");
         return -1;
     }
+    if (opts->replay_path && opts->max_hops) {
+        ft_printf("ft_ping: -m cannot be used with -r\n");
+        return -1;
+    }
+    if (opts->pmtu && (opts->replay_path || opts->max_hops)) {
+        ft_printf("ft_ping: -M cannot be used with -m or -r\n");
+        return -1;
+    }
+    if (opts->adaptive && (opts->replay_path || opts->max_hops || opts->pmtu)) {
+        ft_printf("ft_ping: -A cannot be used with -m, -M or -r\n");
+        return -1;
+    }
+    if (opts->adaptive_rto && (opts->replay_path || opts->max_hops || opts->pmtu)) {
+        ft_printf("ft_ping: -a cannot be used with -m, -M or -r\n");
+        return -1;
+    }
+    if (opts->precision && opts->replay_path) {
+        ft_printf("ft_ping: -P cannot be used with -r\n");
+        return -1;
+    }
+    if (opts->shm_name && (opts->replay_path || opts->max_hops || opts->pmtu)) {
+        ft_printf("ft_ping: -S cannot be used with -m, -M or -r\n");
+        return -1;
+    }
     return 0;
 }
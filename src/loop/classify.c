@@ -0,0 +1,101 @@
+#include "../../inc/loop.h"
+
+/* Largest gap accepted between the echoed send time and the reception time. */
+#define STAMP_MAX_SKEW_SEC 3600
+
+/**
+ * Load an unaligned 16-bit field, in network order.
+ */
+static inline uint16_t load16(const uint8_t *p) {
+	uint16_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/**
+ * Classify one packet.
+ *
+ * Every field is loaded unconditionally from offsets that cannot leave a
+ * RECV_PACK_SIZE buffer (both header lengths are at most 60 bytes), and the
+ * checks are folded with bitwise operators rather than early returns, so a
+ * batch runs through the same straight-line code whatever it contains. A
+ * load past the received length only ever feeds a check that is masked out.
+ *
+ * @param p: Packet; buf, len, size and ts are read, the other fields are
+ *           written.
+ * @param ident: Echo identifier of this session.
+ * @param verify_csum: Also verify the IP and ICMP checksums.
+ * @param check_stamp: Check that replies echo a plausible send time.
+ */
+static inline void classify_one(t_pkt *p, uint16_t ident, _Bool verify_csum, _Bool check_stamp) {
+	const uint8_t *b = p->buf;
+	size_t len = p->len < 0 ? 0 : (size_t)p->len;
+	size_t cap = len < p->size ? len : p->size;
+	size_t ihl = (b[0] & 0x0f) * 4;
+	size_t tot = ntohs(load16(b + 2));
+	size_t end = tot < cap ? tot : cap;
+	const uint8_t *ih = b + ihl;
+	size_t quote = ihl + ICMP_HDR_SIZE;
+	size_t qihl = (b[quote] & 0x0f) * 4;
+	size_t echo = quote + qihl;
+	uint8_t type = ih[0];
+	struct timeval sent;
+
+	memcpy(&sent, ih + ICMP_HDR_SIZE, sizeof(sent));
+
+	_Bool hdr_ok = (cap >= IP_HDR_SIZE) & ((b[0] >> 4) == 4) & (ihl >= IP_HDR_SIZE)
+		& (end >= ihl + ICMP_HDR_SIZE);
+	_Bool icmp = b[9] == IPPROTO_ICMP;
+	_Bool reply = icmp & (type == ICMP_ECHOREPLY) & (load16(ih + 4) == ident);
+	_Bool stamp_ok = ((uint64_t)sent.tv_usec < 1000000)
+		& ((uint64_t)sent.tv_sec - (uint64_t)p->ts.tv_sec + STAMP_MAX_SKEW_SEC <= 2 * STAMP_MAX_SKEW_SEC);
+	_Bool reply_ok = (end >= ihl + ICMP_HDR_SIZE + sizeof(struct timeval)) & (stamp_ok | (!check_stamp));
+	_Bool error = icmp & (type < 32) & ((ICMP_ERR_TYPES >> (type & 31)) & 1);
+	_Bool quote_ok = (end >= quote + IP_HDR_SIZE) & ((b[quote] >> 4) == 4)
+		& (qihl >= IP_HDR_SIZE) & (end >= echo + ICMP_HDR_SIZE);
+	_Bool quote_ours = (b[quote + 9] == IPPROTO_ICMP) & (b[echo] == ICMP_ECHO)
+		& (load16(b + echo + 4) == ident);
+	_Bool csum_ok = 1;
+
+	if (verify_csum)
+		csum_ok = hdr_ok && tot <= len && checksum((unsigned short *)b, ihl) == 0
+			&& (tot > cap || checksum((unsigned short *)ih, tot - ihl) == 0);
+
+	_Bool malformed = (!hdr_ok) | (icmp & !csum_ok) | (reply & !reply_ok) | (error & !quote_ok);
+	_Bool ours_err = error & quote_ours;
+
+	p->cls = malformed ? PKT_MALFORMED : reply ? PKT_REPLY : ours_err ? PKT_ERROR : PKT_FOREIGN;
+	p->icmp_off = ihl;
+	p->quote_off = quote;
+	p->echo_off = ours_err ? echo : ihl;
+	p->seq = load16(b + p->echo_off + 6);
+	p->ttl = b[8];
+}
+
+/**
+ * Sort a batch of received packets into reply, error, foreign or malformed.
+ *
+ * A packet is malformed when its IP header is not a valid IPv4 header
+ * (options included), when it is too short for the ICMP header, when an
+ * echo reply for us does not carry a plausible send time (within
+ * STAMP_MAX_SKEW_SEC of ts, which must be set; only with check_stamp, as
+ * a capture echoes the clock of another run), when an error does not
+ * quote a full IP and ICMP header, or, with verify_csum, when a checksum
+ * is wrong or the datagram was truncated on the wire. len may exceed size
+ * when the source cut a large packet (MSG_TRUNC); only the IP checksum of
+ * such a packet can be verified. Errors are ours only when they
+ * quote one of our echo requests. On return icmp_off, echo_off and seq
+ * are valid for replies and errors.
+ *
+ * @param pkts: Packets, each with size, the length of its buffer, at least
+ *              RECV_PACK_SIZE.
+ * @param n: Number of packets.
+ * @param ident: Echo identifier of this session.
+ * @param verify_csum: Also verify the IP and ICMP checksums.
+ * @param check_stamp: Check that replies echo a plausible send time.
+ */
+void classify_batch(t_pkt *pkts, size_t n, uint16_t ident, _Bool verify_csum, _Bool check_stamp) {
+	for (size_t i = 0; i < n; i++)
+		classify_one(&pkts[i], ident, verify_csum, check_stamp);
+}
@@ -0,0 +1,98 @@
+#include "../../inc/loop.h"
+
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <cpuid.h>
+#endif
+
+/**
+ * Read a clock in nanoseconds.
+ */
+static uint64_t clock_read(clockid_t id) {
+	struct timespec ts;
+
+	clock_gettime(id, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Whether the TSC ticks at a constant rate across frequency changes and
+ * sleep states (invariant TSC), which extrapolating from it requires.
+ */
+static _Bool clock_tsc_invariant(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned a, b, c, d;
+
+	if (!__get_cpuid(0x80000007, &a, &b, &c, &d))
+		return 0;
+	return (d >> 8) & 1;
+#else
+	return 0;
+#endif
+}
+
+/**
+ * Read CLOCK_MONOTONIC, refresh the wall clock offset and, with the TSC,
+ * recalibrate it over the span since the last synchronization.
+ *
+ * @param c: Loop clock.
+ *
+ * Return the monotonic time in nanoseconds.
+ */
+static uint64_t clock_sync(t_clock *c) {
+	uint64_t tsc = c->tsc ? cycles_now() : 0;
+	uint64_t ns = clock_read(CLOCK_MONOTONIC);
+
+	if (c->tsc && ns - c->ns_base >= CLOCK_CALIB_NS && tsc > c->tsc_base) {
+		c->ns_per_cycle = (double)(ns - c->ns_base) / (tsc - c->tsc_base);
+		c->tsc_base = tsc;
+		c->ns_base = ns;
+	}
+	c->wall_offset_ns = (int64_t)(clock_read(CLOCK_REALTIME) - ns);
+	c->next_sync_ns = ns + (c->ns_per_cycle > 0 ? CLOCK_SYNC_NS : CLOCK_CALIB_NS);
+	return ns;
+}
+
+/**
+ * Start the loop clock.
+ *
+ * @param c: Loop clock.
+ * @param tsc: Use the TSC fast path if the CPU has an invariant TSC.
+ */
+void clock_init(t_clock *c, _Bool tsc) {
+	ft_memset(c, 0, sizeof(*c));
+	c->tsc = tsc && clock_tsc_invariant();
+	if (c->tsc)
+		c->tsc_base = cycles_now();
+	c->ns_base = clock_read(CLOCK_MONOTONIC);
+	clock_update(c);
+}
+
+/**
+ * Read the loop clock once; c->now and c->ns hold the result until the
+ * next call.
+ *
+ * Until the TSC is calibrated, and without it, this is one vDSO
+ * clock_gettime(); with it, a TSC read and a multiplication. A virtual
+ * clock keeps the time it was set to.
+ *
+ * @param c: Loop clock.
+ */
+void clock_update(t_clock *c) {
+	uint64_t ns;
+
+	if (c->virt)
+		ns = c->ns;
+	else if (c->ns_per_cycle > 0)
+		ns = c->ns_base + (uint64_t)((cycles_now() - c->tsc_base) * c->ns_per_cycle);
+	else
+		ns = clock_read(CLOCK_MONOTONIC);
+	if (!c->virt && ns >= c->next_sync_ns)
+		ns = clock_sync(c);
+	if (ns < c->ns)
+		ns = c->ns;
+	c->ns = ns;
+	c->now.tv_sec = ns / 1000000000ULL;
+	c->now.tv_usec = ns % 1000000000ULL / 1000;
+}
@@ -0,0 +1,502 @@
+#define _GNU_SOURCE
+#include "../../inc/loop.h"
+
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/*
+ * Client side: a packet source whose packets come from, and go out
+ * through, the daemon.
+ */
+
+/**
+ * Fill the unix socket address of the daemon.
+ *
+ * Return 0 on success, -1 if the path is too long.
+ */
+static int daemon_addr(struct sockaddr_un *addr, const char *path) {
+	ft_memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (ft_strlen(path) >= sizeof(addr->sun_path)) {
+		ft_printf("ft_ping: daemon socket path too long\n");
+		return -1;
+	}
+	memcpy(addr->sun_path, path, ft_strlen(path));
+	return 0;
+}
+
+/**
+ * Read the next packet forwarded by the daemon without blocking.
+ *
+ * @param src: Daemon packet source.
+ * @param buf: Buffer receiving the packet, starting at the IP header.
+ * @param size: Size of the buffer.
+ * @param ts: Time the daemon received the packet, on CLOCK_MONOTONIC.
+ *
+ * Return the full length of the packet, 0 if no packet is pending, -1 on
+ * error or when the daemon reports a failed send.
+ */
+static ssize_t daemon_next(t_source *src, uint8_t *buf, size_t size, struct timeval *ts) {
+	t_dmsg hdr_buf;
+	t_dmsg *hdr = &hdr_buf;
+	struct iovec iov[2] = {
+		{ .iov_base = hdr, .iov_len = sizeof(*hdr) },
+		{ .iov_base = buf, .iov_len = size },
+	};
+	struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+	ssize_t nb_bytes;
+
+	nb_bytes = recvmsg(src->fd, &msg, MSG_DONTWAIT);
+	if (nb_bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return 0;
+	if (nb_bytes == -1) {
+		ft_printf("recv err: %s\n", strerror(errno));
+		return -1;
+	}
+	if (nb_bytes < (ssize_t)sizeof(*hdr)) {
+		ft_printf("ft_ping: connection to the daemon lost\n");
+		return -1;
+	}
+	if (hdr->type == DMSG_ERROR) {
+		errno = hdr->err;
+		if (errno == EACCES)
+			ft_printf("ft_ping: socket access error. Are you trying to ping broadcast ?\n");
+		else
+			ft_printf("sendto err: %s\n", strerror(errno));
+		return -1;
+	}
+	if (hdr->type != DMSG_PACKET)
+		return 0;
+	ts->tv_sec = hdr->sec;
+	ts->tv_usec = hdr->usec;
+	return hdr->len;
+}
+
+/**
+ * Hand an echo request to the daemon for sending.
+ *
+ * @param src: Daemon packet source.
+ * @param buf: ICMP packet, header included.
+ * @param len: Length of the packet.
+ * @param dst: Destination address.
+ * @param ttl: Time to live of this packet, 0 for the default (-t).
+ *
+ * Return the number of bytes of the packet, -1 on error with errno set.
+ */
+static ssize_t daemon_send(t_source *src, const uint8_t *buf, size_t len,
+		const struct sockaddr_in *dst, uint8_t ttl) {
+	t_dmsg hdr = {
+		.type = DMSG_SEND,
+		.ttl = ttl ? ttl : src->ttl,
+		.addr = dst->sin_addr.s_addr,
+		.len = len,
+	};
+	struct iovec iov[2] = {
+		{ .iov_base = &hdr, .iov_len = sizeof(hdr) },
+		{ .iov_base = (void *)buf, .iov_len = len },
+	};
+	struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+
+	if (sendmsg(src->fd, &msg, MSG_NOSIGNAL) == -1)
+		return -1;
+	return len;
+}
+
+/**
+ * Disconnect from the daemon; it releases our identifier.
+ *
+ * @param src: Daemon packet source.
+ */
+static void daemon_close(t_source *src) {
+	close(src->fd);
+}
+
+/**
+ * Make a packet source going through the probe daemon at `path`.
+ *
+ * No raw socket and no root rights are needed: the daemon sends our echo
+ * requests and forwards back only the packets that carry, or quote, our
+ * echo identifier.
+ *
+ * @param src: Packet source to initialize.
+ * @param path: Unix socket of the daemon.
+ * @param ident: Set to the echo identifier the daemon assigned us.
+ * @param ttl: Default time to live of our requests (-t).
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int source_open_daemon(t_source *src, const char *path, uint16_t *ident, uint8_t ttl) {
+	struct sockaddr_un addr;
+	t_dmsg hello = { .type = DMSG_HELLO };
+	int fd;
+
+	if (daemon_addr(&addr, path) == -1)
+		return -1;
+	errno = 0;
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET, 0)) == -1
+		|| connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1
+		|| send(fd, &hello, sizeof(hello), MSG_NOSIGNAL) == -1
+		|| recv(fd, &hello, sizeof(hello), 0) != sizeof(hello)) {
+		ft_printf("ft_ping: daemon %s: %s\n", path, errno ? strerror(errno) : "connection refused");
+		if (fd != -1)
+			close(fd);
+		return -1;
+	}
+	if (hello.type != DMSG_HELLO) {
+		ft_printf("ft_ping: daemon %s: %s\n", path, strerror(hello.err));
+		close(fd);
+		return -1;
+	}
+	*ident = hello.ident;
+	ft_memset(src, 0, sizeof(*src));
+	src->fd = fd;
+	src->ttl = ttl;
+	src->next = daemon_next;
+	src->send = daemon_send;
+	src->close = daemon_close;
+	return 0;
+}
+
+/*
+ * Daemon side: one raw socket, many clients.
+ */
+
+/**
+ * Echo identifier a received packet belongs to.
+ *
+ * Echo requests and replies carry it in their header, ICMP errors in the
+ * echo request they quote. Only the headers are looked at: the owner's
+ * classifier does the full validation.
+ *
+ * @param b: Packet, starting at the IP header.
+ * @param len: Bytes available in b.
+ *
+ * Return the identifier, or -1 if the packet is not about an echo.
+ */
+static int demux_ident(const uint8_t *b, size_t len) {
+	size_t ihl = (b[0] & 0x0f) * 4;
+	size_t quote = ihl + ICMP_HDR_SIZE;
+	size_t qihl;
+	uint16_t id;
+	uint8_t type;
+
+	if (ihl < IP_HDR_SIZE || len < quote)
+		return -1;
+	type = b[ihl];
+	if (type == ICMP_ECHOREPLY || type == ICMP_ECHO) {
+		memcpy(&id, b + ihl + 4, sizeof(id));
+		return id;
+	}
+	if (type >= 32 || !((ICMP_ERR_TYPES >> type) & 1) || len < quote + IP_HDR_SIZE)
+		return -1;
+	qihl = (b[quote] & 0x0f) * 4;
+	if (qihl < IP_HDR_SIZE || len < quote + qihl + ICMP_HDR_SIZE
+		|| b[quote + 9] != IPPROTO_ICMP || b[quote + qihl] != ICMP_ECHO)
+		return -1;
+	memcpy(&id, b + quote + qihl + 4, sizeof(id));
+	return id;
+}
+
+/**
+ * Send a header-only message to a client, without blocking.
+ */
+static void daemon_reply(const t_dclient *c, uint8_t type, int err) {
+	t_dmsg hdr = { .type = type, .ident = c->ident, .err = err };
+
+	send(c->fd, &hdr, sizeof(hdr), MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+/**
+ * Forget a client and release its identifier.
+ */
+static void daemon_drop(t_daemon *d, int idx) {
+	t_dclient *c = &d->clients[idx];
+
+	if (c->ready)
+		d->owner[c->ident] = 0;
+	close(c->fd);
+	*c = d->clients[--d->nb_clients];
+	if (c != &d->clients[d->nb_clients] && c->ready)
+		d->owner[c->ident] = idx + 1;
+}
+
+/**
+ * Accept the pending connections.
+ */
+static void daemon_accept(t_daemon *d) {
+	int sndbuf = DAEMON_SNDBUF;
+	int fd;
+
+	while ((fd = accept4(d->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+		if (d->nb_clients == DAEMON_MAX_CLIENTS) {
+			close(fd);
+			continue;
+		}
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+		d->clients[d->nb_clients++] = (t_dclient){ .fd = fd };
+	}
+}
+
+/**
+ * Assign an echo identifier to a new client.
+ *
+ * The daemon picks it, so a client cannot read another one's replies: the
+ * low 16 bits of the client's pid (SO_PEERCRED), as a ping of its own
+ * would use, or the next free one when another client holds those.
+ *
+ * Return 0 on success, -1 if the client must be dropped.
+ */
+static int daemon_hello(t_daemon *d, int idx) {
+	t_dclient *c = &d->clients[idx];
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	uint16_t ident;
+
+	if (c->ready || getsockopt(c->fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+		daemon_reply(c, DMSG_ERROR, EPERM);
+		return -1;
+	}
+	ident = cred.pid;
+	while (d->owner[ident])
+		ident++;
+	c->ident = ident;
+	c->ready = 1;
+	d->owner[c->ident] = idx + 1;
+	d->nb_served++;
+	daemon_reply(c, DMSG_HELLO, 0);
+	return 0;
+}
+
+/**
+ * Take a send from the budget of a client.
+ *
+ * A token bucket of DAEMON_BURST probes refilled at DAEMON_RATE per
+ * second, kept as the time its debt is paid off (send_ns): a send is
+ * allowed while that time is at most a full bucket ahead of now.
+ *
+ * Return 1 if the client may send, 0 if it is over its rate.
+ */
+static _Bool daemon_rate_ok(t_daemon *d, t_dclient *c) {
+	uint64_t period = 1000000000ULL / DAEMON_RATE;
+
+	clock_update(&d->clock);
+	if (c->send_ns < d->clock.ns)
+		c->send_ns = d->clock.ns;
+	if (c->send_ns + period > d->clock.ns + DAEMON_BURST * period)
+		return 0;
+	c->send_ns += period;
+	return 1;
+}
+
+/**
+ * Send an echo request of a client on the raw socket.
+ *
+ * Only echo requests with the client's own identifier, of DAEMON_PROBE_MAX
+ * bytes at most, are let out, and no faster than the client's rate:
+ * requests over it are dropped, as a rate-limited network would.
+ *
+ * @param d: Daemon state.
+ * @param c: Sending client.
+ * @param hdr: DMSG_SEND header, followed by the packet.
+ * @param nb_bytes: Size of the whole message.
+ */
+static void daemon_send_probe(t_daemon *d, t_dclient *c, const t_dmsg *hdr, size_t nb_bytes) {
+	const uint8_t *pkt = (const uint8_t *)(hdr + 1);
+	struct sockaddr_in dst = { .sin_family = AF_INET, .sin_addr.s_addr = hdr->addr };
+	t_source raw;
+	uint16_t id;
+
+	if (hdr->len != nb_bytes - sizeof(*hdr) || hdr->len < ICMP_HDR_SIZE) {
+		daemon_reply(c, DMSG_ERROR, EPERM);
+		return;
+	}
+	memcpy(&id, pkt + 4, sizeof(id));
+	if (pkt[0] != ICMP_ECHO || id != c->ident) {
+		daemon_reply(c, DMSG_ERROR, EPERM);
+		return;
+	}
+	if (hdr->len > DAEMON_PROBE_MAX) {
+		daemon_reply(c, DMSG_ERROR, EMSGSIZE);
+		return;
+	}
+	if (!daemon_rate_ok(d, c)) {
+		d->nb_limited++;
+		return;
+	}
+	source_open_socket(&raw, d->raw_fd);
+	if (raw.send(&raw, pkt, hdr->len, &dst, hdr->ttl) == -1) {
+		daemon_reply(c, DMSG_ERROR, errno);
+		return;
+	}
+	d->nb_sent++;
+}
+
+/**
+ * Handle the messages waiting on a client connection.
+ *
+ * Return 0 if the client is still connected, -1 if it must be dropped.
+ */
+static int daemon_client(t_daemon *d, int idx, uint8_t *msg) {
+	const t_dmsg *hdr = (const t_dmsg *)msg;
+	ssize_t nb_bytes;
+
+	while ((nb_bytes = recv(d->clients[idx].fd, msg, DAEMON_MSG_MAX, 0)) > 0) {
+		if (nb_bytes < (ssize_t)sizeof(*hdr))
+			return -1;
+		if (hdr->type == DMSG_HELLO) {
+			if (daemon_hello(d, idx) == -1)
+				return -1;
+		} else if (hdr->type == DMSG_SEND && d->clients[idx].ready) {
+			daemon_send_probe(d, &d->clients[idx], hdr, nb_bytes);
+		} else {
+			return -1;
+		}
+	}
+	return nb_bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+}
+
+/**
+ * Drain the raw socket and forward every packet to the client it belongs to.
+ *
+ * Packets are forwarded whole, so that clients can check the payload of
+ * large replies. A client that does not keep up loses packets, as its own
+ * raw socket would on overflow.
+ *
+ * @param d: Daemon state.
+ * @param msg: Buffer of DAEMON_MSG_MAX bytes.
+ */
+static void daemon_forward(t_daemon *d, uint8_t *msg) {
+	t_dmsg *hdr = (t_dmsg *)msg;
+	uint8_t *pkt = msg + sizeof(*hdr);
+	ssize_t nb_bytes;
+	size_t cap;
+	int id;
+
+	while ((nb_bytes = recv(d->raw_fd, pkt, IP_MAXPACKET, MSG_DONTWAIT | MSG_TRUNC)) > 0) {
+		clock_update(&d->clock);
+		cap = (size_t)nb_bytes < IP_MAXPACKET ? (size_t)nb_bytes : IP_MAXPACKET;
+		if ((id = demux_ident(pkt, cap)) == -1 || d->owner[id] == 0) {
+			d->nb_unmatched++;
+			continue;
+		}
+		*hdr = (t_dmsg){ .type = DMSG_PACKET, .ident = id, .len = nb_bytes,
+			.sec = d->clock.now.tv_sec, .usec = d->clock.now.tv_usec };
+		if (send(d->clients[d->owner[id] - 1].fd, msg, sizeof(*hdr) + cap,
+				MSG_DONTWAIT | MSG_NOSIGNAL) == -1)
+			d->nb_dropped++;
+		else
+			d->nb_forwarded++;
+	}
+}
+
+/**
+ * Stop the daemon on SIGINT/SIGTERM.
+ */
+static void daemon_stop(int signum) {
+	(void)signum;
+	pingloop = 0;
+}
+
+/**
+ * Open the listening unix socket, writable by every local user.
+ *
+ * The path comes from the environment: only a stale socket is removed,
+ * and the mode is set by the umask at bind time rather than on the path
+ * afterwards, which could by then name another file.
+ *
+ * Return the socket, or -1 on failure.
+ */
+static int daemon_listen(const char *path) {
+	struct sockaddr_un addr;
+	mode_t mask;
+	int ret;
+	int fd;
+
+	if (daemon_addr(&addr, path) == -1 || unlink_stale_socket(path) == -1)
+		return -1;
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
+		perror("socket (daemon)");
+		return -1;
+	}
+	mask = umask(0111);
+	ret = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(mask);
+	if (ret == -1 || listen(fd, SOMAXCONN) == -1) {
+		ft_printf("ft_ping: %s: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/**
+ * Run the probe daemon until SIGINT or SIGTERM.
+ *
+ * One raw socket serves every client: the kernel copies each ICMP packet
+ * once, to this socket, and the daemon hands it to the single client whose
+ * echo identifier it carries.
+ *
+ * @param path: Unix socket to listen on.
+ *
+ * Return the exit code of the program.
+ */
+int daemon_run(const char *path) {
+	struct pollfd *fds;
+	struct sigaction sa = { .sa_handler = daemon_stop };
+	uint8_t *msg;
+	t_daemon *d;
+	int ret = E_EXIT_ERR_HOST;
+
+	d = calloc(1, sizeof(*d));
+	fds = calloc(DAEMON_MAX_CLIENTS + 2, sizeof(*fds));
+	msg = malloc(DAEMON_MSG_MAX);
+	if (d == NULL || fds == NULL || msg == NULL) {
+		ft_printf("ft_ping: cannot allocate daemon state\n");
+		goto out;
+	}
+	if ((d->raw_fd = init_raw_socket()) == -1)
+		goto out;
+	clock_init(&d->clock, 0);
+	if ((d->listen_fd = daemon_listen(path)) == -1) {
+		close(d->raw_fd);
+		goto out;
+	}
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+	ft_printf("ft_ping: daemon listening on %s\n", path);
+
+	while (pingloop) {
+		int nb = d->nb_clients;
+
+		fds[0] = (struct pollfd){ .fd = d->raw_fd, .events = POLLIN };
+		fds[1] = (struct pollfd){ .fd = d->listen_fd, .events = POLLIN };
+		for (int i = 0; i < nb; i++)
+			fds[i + 2] = (struct pollfd){ .fd = d->clients[i].fd, .events = POLLIN };
+		if (poll(fds, nb + 2, -1) == -1)
+			continue;
+		if (fds[0].revents & POLLIN)
+			daemon_forward(d, msg);
+		for (int i = nb - 1; i >= 0; i--)
+			if (fds[i + 2].revents && daemon_client(d, i, msg) == -1)
+				daemon_drop(d, i);
+		if (fds[1].revents & POLLIN)
+			daemon_accept(d);
+	}
+
+	while (d->nb_clients)
+		daemon_drop(d, d->nb_clients - 1);
+	close(d->listen_fd);
+	close(d->raw_fd);
+	unlink_stale_socket(path);
+	printf("ft_ping daemon: %lu clients served, %lu probes sent, %lu rate-limited, "
+		"%lu packets forwarded, %lu unmatched, %lu dropped\n", d->nb_served, d->nb_sent,
+		d->nb_limited, d->nb_forwarded, d->nb_unmatched, d->nb_dropped);
+	ret = E_EXIT_OK;
+out:
+	free(msg);
+	free(fds);
+	free(d);
+	return ret;
+}
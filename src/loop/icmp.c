@@ -1,5 +1,8 @@
 #include "../../inc/loop.h"
 
+/* Echo requests are built here, so large -s sizes stay off the stack. */
+static uint8_t send_buf[ICMP_HDR_SIZE + ICMP_MAX_BODY_SIZE];
+
 /**
  * Calculate the ICMP checksum for a buffer.
  *
@@ -9,7 +12,7 @@
  * @param nbytes: Size of the buffer in bytes.
  * Return The computed checksum.
  */
-static unsigned short checksum(unsigned short *ptr, int nbytes) {
+unsigned short checksum(unsigned short *ptr, int nbytes) {
 	unsigned long sum;
 	unsigned short oddbyte;
 
@@ -31,57 +34,226 @@ static unsigned short checksum(unsigned short *ptr, int nbytes) {
 /**
  * Fills the ICMP echo request header and adds a timestamp to the payload.
  *
- * The function prepares an ICMP echo request with current timestamp for RTT computation.
+ * The function prepares an ICMP echo request with its send time for RTT
+ * computation. The time is read from the loop clock, not the wall clock:
+ * only the live run that sent it reads it back. A replayed capture has
+ * capture times instead, and times the reply against its request (see
+ * icmp_echo_sent()).
  *
  * @param buf: Buffer to store the ICMP packet.
  * @param packet_len: Total length of the packet (header + body).
+ * @param ident: Echo identifier of the run, pi->ident.
+ * @param seq: Sequence number to stamp in the header.
+ * @param sent: Send time to stamp in the payload.
  *
  * Return 0 on success, -1 on error.
  */
-static int fill_icmp_echo_packet(uint8_t *buf, int packet_len) {
-	static int seq = 0;
+int fill_icmp_echo_packet(uint8_t *buf, int packet_len, uint16_t ident, uint16_t seq, const struct timeval *sent) {
 	struct icmphdr *hdr = (struct icmphdr *)buf;
-	struct timeval *timestamp = skip_icmphdr(buf);
 
-	if (gettimeofday(timestamp, NULL) == -1) {
-		ft_printf("gettimeofday err: %s\n", strerror(errno));
-		return -1;
-	}
+	memcpy(skip_icmphdr(buf), sent, sizeof(*sent));
 	hdr->type = ICMP_ECHO;
-	hdr->un.echo.id = getpid();
-	hdr->un.echo.sequence = seq++;
+	hdr->code = 0;
+	hdr->un.echo.id = ident;
+	hdr->un.echo.sequence = seq;
+	hdr->checksum = 0;
 	hdr->checksum = checksum((unsigned short *)buf, packet_len);
 	return 0;
 }
 
+/**
+ * Send time of the echo request an echo reply answers.
+ *
+ * Live, it is the time echoed in the reply. In a replay, the echoed time
+ * is on the clock of the run that was captured, so the capture time of
+ * the matching request is used; the echoed time is only a fallback for
+ * a reply whose request is not in the capture.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param icmph: Echo reply, with at least a timeval after its header.
+ * @param sent: Send time of the request.
+ */
+void icmp_echo_sent(const t_packinfo *pi, const struct icmphdr *icmph, struct timeval *sent) {
+	if (pi->replay_sent && timerisset(&pi->replay_sent[icmph->un.echo.sequence])) {
+		*sent = pi->replay_sent[icmph->un.echo.sequence];
+		return;
+	}
+	memcpy(sent, (const uint8_t *)icmph + ICMP_HDR_SIZE, sizeof(*sent));
+}
+
+/**
+ * Payload of every echo request, after the send time. It is written once
+ * by payload_init() and never touched by the send paths.
+ */
+uint8_t *icmp_payload(void) {
+	return send_buf + ICMP_HDR_SIZE + sizeof(struct timeval);
+}
+
+/**
+ * Forget any reply seen for a sequence number about to be reused.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param seq: Sequence number of the probe being sent.
+ */
+static void seq_seen_clear(t_packinfo *pi, uint16_t seq) {
+	pi->seq_seen[seq >> 3] &= ~(1 << (seq & 7));
+}
+
+/**
+ * Mark a sequence number as answered.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param seq: Sequence number of the reply.
+ *
+ * Return 1 if a reply for this sequence was already seen (duplicate), 0 otherwise.
+ */
+static _Bool seq_seen_test_and_set(t_packinfo *pi, uint16_t seq) {
+	uint8_t bit = 1 << (seq & 7);
+	_Bool seen = pi->seq_seen[seq >> 3] & bit;
+
+	pi->seq_seen[seq >> 3] |= bit;
+	return seen;
+}
+
+/**
+ * Timer callback of a probe whose deadline passed without an answer.
+ *
+ * @param t: The probe timer; its id is the sequence number.
+ * @param ctx: Packet info tracker.
+ */
+static void probe_expired(t_timer *t, void *ctx) {
+	t_packinfo *pi = ctx;
+	uint64_t timeout = pi->rto ? pi->rto->armed[t->id] : pi->probe_timeout;
+	uint64_t waited = (pi->wheel->now - t->expires + timeout) * WHEEL_TICK_US;
+	struct timeval ago = { .tv_sec = waited / 1000000, .tv_usec = waited % 1000000 };
+	struct timeval sent;
+
+	timersub(&pi->clock.now, &ago, &sent);
+	pi->nb_pending--;
+	pi->ctr.nb_timeout++;
+	shmstats_on_timeout(pi->shm);
+	metrics_on_timeout(pi->metrics, &sent);
+	PROBE1(timeout, t->id);
+	rto_on_timeout(pi->rto);
+	if (pi->binlog)
+		binlog_append(pi->binlog, 0, t->id, 0, BINLOG_TIMEOUT, &sent, NULL);
+	if (pi->hops)
+		sweep_expired(pi, t->id);
+	else if (pi->pmtu)
+		pmtu_expired(pi, t->id);
+	else if (pi->aimd)
+		aimd_on_loss(pi, t->id);
+}
+
+/**
+ * Allocate one deadline timer per sequence number, and the receive
+ * buffers, large enough for a whole reply to a probe of pi->body_size.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param wheel: Timer wheel the deadlines are filed in.
+ * @param timeout: Time a probe waits for its answer, in wheel ticks.
+ *
+ * Return 0 on success, -1 on allocation failure.
+ */
+int icmp_probes_init(t_packinfo *pi, t_wheel *wheel, uint64_t timeout) {
+	pi->recv_size = IP_MAX_HDR_SIZE + ICMP_HDR_SIZE + pi->body_size;
+	if (pi->recv_size < RECV_PACK_SIZE)
+		pi->recv_size = RECV_PACK_SIZE;
+	pi->probe_timers = calloc(UINT16_MAX + 1, sizeof(*pi->probe_timers));
+	pi->recv_bufs = malloc(RECV_BATCH * pi->recv_size);
+	if (pi->probe_timers == NULL || pi->recv_bufs == NULL) {
+		ft_printf("ft_ping: cannot allocate probe state\n");
+		icmp_probes_clean(pi);
+		return -1;
+	}
+	pi->wheel = wheel;
+	pi->probe_timeout = timeout;
+	pi->nb_pending = 0;
+	return 0;
+}
+
+/**
+ * Start waiting for the answer to a probe that was just sent: for -W,
+ * or with -a for the current adaptive timeout.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param seq: Sequence number of the probe.
+ */
+void icmp_arm_probe(t_packinfo *pi, uint16_t seq) {
+	t_timer *t;
+
+	if (pi->probe_timers == NULL)
+		return;
+	t = &pi->probe_timers[seq];
+	if (!wheel_cancel(t))
+		pi->nb_pending++;
+	t->fn = probe_expired;
+	t->id = seq;
+	wheel_add(pi->wheel, t, pi->wheel->now + (pi->rto ? rto_arm(pi->rto, seq) : pi->probe_timeout));
+}
+
+/**
+ * Stop waiting for a probe that got its answer.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param seq: Sequence number of the probe.
+ *
+ * Return 1 if the probe was still waited for, 0 if it had already timed out.
+ */
+_Bool icmp_disarm_probe(t_packinfo *pi, uint16_t seq) {
+	if (pi->probe_timers == NULL || !wheel_cancel(&pi->probe_timers[seq]))
+		return 0;
+	pi->nb_pending--;
+	return 1;
+}
+
+/**
+ * Free the probe timers and the receive buffers.
+ *
+ * @param pi: Pointer to packet tracking info.
+ */
+void icmp_probes_clean(t_packinfo *pi) {
+	free(pi->probe_timers);
+	pi->probe_timers = NULL;
+	free(pi->recv_bufs);
+	pi->recv_bufs = NULL;
+}
+
 /**
  * Send an ICMP echo request.
  *
  * Constructs and sends an ICMP ECHO request to the destination.
  *
- * @param sock_fd: Socket file descriptor.
+ * @param src: Packet source the request goes out through.
  * @param si: Pointer to remote socket info.
  * @param pi: Pointer to packet tracking info.
 
  * Return 0 on success, -1 on failure.
  */
-int icmp_send_ping(int sock_fd, const t_sockinfo *si, t_packinfo *pi) {
+int icmp_send_ping(t_source *src, const t_sockinfo *si, t_packinfo *pi) {
 	ssize_t nb_bytes;
-	uint8_t buf[sizeof(struct icmphdr) + ICMP_BODY_SIZE] = {};
+	size_t len = ICMP_HDR_SIZE + pi->body_size;
+	uint64_t start = cycles_now();
 
-	if (fill_icmp_echo_packet(buf, sizeof(buf)) == -1)
+	if (fill_icmp_echo_packet(send_buf, len, pi->ident, pi->nb_send, &pi->clock.now) == -1)
 		return -1;
-
     if (pi->nb_send == 0) {
-        gettimeofday(&pi->start_time, NULL);
+        pi->start_time = pi->clock.now;
     }
+	lossmap_on_send(pi, pi->nb_send, &pi->clock.now);
+	seq_seen_clear(pi, pi->nb_send);
 
-	nb_bytes = sendto(sock_fd, buf, sizeof(buf), 0,
-			  (const struct sockaddr *)&si->remote_addr,
-			  sizeof(si->remote_addr));
+	nb_bytes = src->send(src, send_buf, len, &si->remote_addr, 0);
+	pi->ctr.nb_send_calls++;
 	if (nb_bytes == -1)
 		goto err;
+	PROBE2(send, (uint16_t)pi->nb_send, pi->ident);
+	icmp_arm_probe(pi, pi->nb_send);
+	pi->ctr.bytes_sent += nb_bytes;
+	pi->ctr.cycles_send += cycles_now() - start;
 	pi->nb_send++;
+	metrics_on_send(pi->metrics);
+	shmstats_on_send(pi->shm);
 	return 0;
 
 err:
@@ -95,75 +267,236 @@ err:
 }
 
 /**
- * @brief Checks if an ICMP packet is addressed to this process.
+ * Send an ICMP echo request carrying its own TTL.
+ *
+ * The TTL is set on this packet only, so that probes for every hop can
+ * share the same socket without touching its default TTL.
  *
- * Discards echo requests from ourselves when pinging localhost.
+ * @param src: Packet source the request goes out through.
+ * @param si: Pointer to remote socket info.
+ * @param ttl: Time to live of this probe only.
+ * @param ident: Echo identifier of the run.
+ * @param seq: Sequence number of the probe.
+ * @param sent: Send time, from the loop clock.
  *
- * @param buf Pointer to the received ICMP packet.
- * @return true if the packet is an ECHO reply for this process.
+ * Return 0 on success, -1 on failure.
  */
-static _Bool is_addressed_to_us(uint8_t *buf) {
-	struct icmphdr *hdr_sent;
-	struct icmphdr *hdr_rep = (struct icmphdr *)buf;
+int icmp_send_ttl_probe(t_source *src, const t_sockinfo *si, uint8_t ttl, uint16_t ident, uint16_t seq,
+		const struct timeval *sent) {
+	size_t len = ICMP_HDR_SIZE + ICMP_BODY_SIZE;
 
-	if (hdr_rep->type == ICMP_ECHO)
-		return 0;
+	if (fill_icmp_echo_packet(send_buf, len, ident, seq, sent) == -1)
+		return -1;
+	if (src->send(src, send_buf, len, &si->remote_addr, ttl) == -1) {
+		ft_printf("sendmsg err: %s\n", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
 
-	if (hdr_rep->type != ICMP_ECHOREPLY)
-		buf += ICMP_HDR_SIZE + IP_HDR_SIZE;
-	hdr_sent = (struct icmphdr *)buf;
+/**
+ * Send an ICMP echo request with a given payload size.
+ *
+ * With IP_PMTUDISC_DO set on the socket, a probe larger than the MTU the
+ * kernel knows for the route is refused locally with EMSGSIZE.
+ *
+ * @param src: Packet source the request goes out through.
+ * @param si: Pointer to remote socket info.
+ * @param ident: Echo identifier of the run.
+ * @param seq: Sequence number of the probe.
+ * @param body_size: Payload size, at least the size of a timeval.
+ * @param sent: Send time, from the loop clock.
+ *
+ * Return 0 on success, 1 if the probe is too big to leave the host, -1 on failure.
+ */
+int icmp_send_sized_probe(t_source *src, const t_sockinfo *si, uint16_t ident, uint16_t seq, uint16_t body_size,
+		const struct timeval *sent) {
+	size_t len = ICMP_HDR_SIZE + body_size;
 
-	return hdr_sent->un.echo.id == getpid();
+	if (fill_icmp_echo_packet(send_buf, len, ident, seq, sent) == -1)
+		return -1;
+	if (src->send(src, send_buf, len, &si->remote_addr, 0) == -1) {
+		if (errno == EMSGSIZE)
+			return 1;
+		ft_printf("sendto err: %s\n", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Record an echo reply, or a duplicate of one, in the result log.
+ *
+ * @param pi: Packet info tracker.
+ * @param pkt: Received echo reply, classified.
+ * @param outcome: BINLOG_REPLY, BINLOG_LATE or BINLOG_DUP.
+ */
+static void log_reply(t_packinfo *pi, const t_pkt *pkt, uint8_t outcome) {
+	struct iphdr *ip = (struct iphdr *)pkt->buf;
+	struct timeval sent;
+	struct timeval rtt;
+
+	if (pi->binlog == NULL)
+		return;
+	icmp_echo_sent(pi, (const struct icmphdr *)(pkt->buf + pkt->icmp_off), &sent);
+	timersub(&pkt->ts, &sent, &rtt);
+	if (rtt.tv_sec < 0)
+		timerclear(&rtt);
+	binlog_append(pi->binlog, ip->saddr, pkt->seq, ip->ttl, outcome, &sent, &rtt);
 }
 
 /**
- * Receive an ICMP echo reply from a non-blocking socket.
+ * Account for a classified packet.
  *
- * Reads the incoming packet and prints information if it's valid.
+ * Echo replies addressed to us update the RTT list and are printed,
+ * errors quoting one of our probes are reported (and, with -A, source
+ * quenches slow the probe rate down), malformed packets are
+ * counted and anything else is ignored.
  *
- * @param sock_fd: RAW socket file descriptor.
+ * @param pkt: Received packet, classified by classify_batch().
  * @param pi: Packet info tracker.
  * @param opts: Program options.
+ * @param si: Pointer to remote socket info.
 
- * Return 1 if a packet was received, 0 if no data, -1 on error.
+ * Return 1 if the packet was handled, 0 if it was not for us, -1 on error.
  */
-int icmp_recv_ping(int sock_fd, t_packinfo *pi, const t_options *opts, const t_sockinfo *si) {
-    uint8_t buf[RECV_PACK_SIZE] = {};
-    ssize_t nb_bytes;
-    struct icmphdr *icmph;
-    struct iovec iov[1] = {
-        [0] = { .iov_base = buf, .iov_len = sizeof(buf)}
-    };
-    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 1 };
-
-    nb_bytes = recvmsg(sock_fd, &msg, MSG_DONTWAIT);
-    if (errno != EAGAIN && errno != EWOULDBLOCK && nb_bytes == -1) {
-        ft_printf("recvmsg err: %s\n", strerror(errno));
-        return -1;
-    } else if (nb_bytes == -1) {
-        return 0;
-    }
+int icmp_handle_packet(const t_pkt *pkt, t_packinfo *pi, const t_options *opts, const t_sockinfo *si) {
+    struct icmphdr *icmph = (struct icmphdr *)(pkt->buf + pkt->icmp_off);
+    struct timeval wall;
+    struct timeval sent;
+    uint64_t start;
+    _Bool late;
 
-    icmph = skip_iphdr(buf);
-    if (!icmph)
+    if (pkt->cls == PKT_MALFORMED) {
+        pi->ctr.nb_malformed++;
         return 0;
+    }
 
-    if (icmph->type == ICMP_ECHOREPLY) {
-        if (!is_addressed_to_us((uint8_t *)icmph))
-            return 0;
+    if (pi->hops)
+        return sweep_recv(pi, pkt, si);
+    if (pi->pmtu)
+        return pmtu_recv(pi, pkt, si);
 
+    if (pkt->cls == PKT_REPLY) {
+        if (seq_seen_test_and_set(pi, pkt->seq)) {
+            pi->nb_dup++;
+            shmstats_on_dup(pi->shm);
+            log_reply(pi, pkt, BINLOG_DUP);
+            print_dup_info(pkt->buf, pkt->len, opts, si);
+            return 1;
+        }
+        late = pi->probe_timers && !icmp_disarm_probe(pi, pkt->seq);
+        if (!late && pi->aimd)
+            aimd_on_reply(pi, pkt->seq);
         pi->nb_ok++;
-        if (rtts_save_new(pi, icmph) == NULL)
+        if (rtts_save_new(pi, icmph, &pkt->ts) == -1)
             return -1;
-        if (print_recv_info(buf, nb_bytes, opts, pi, si) == -1)
+        jitter_on_reply(&pi->jitter, pkt->seq, &pi->rtt_last);
+        rto_on_reply(pi->rto, &pi->rtt_last);
+        if (pi->metrics) {
+            icmp_echo_sent(pi, icmph, &sent);
+            metrics_on_reply(pi->metrics, &sent, &pi->rtt_last, late);
+        }
+        shmstats_on_reply(pi->shm, &pi->rtt_last, late);
+        log_reply(pi, pkt, late ? BINLOG_LATE : BINLOG_REPLY);
+        PROBE2(recv, pkt->seq,
+               pi->rtt_last.tv_sec * 1000000 + pi->rtt_last.tv_usec);
+        start = cycles_now();
+        clock_wall(&pi->clock, &pkt->ts, &wall);
+        if (print_recv_info(pkt->buf, pkt->len, &wall, opts, pi, si) == -1)
             return -1;
+        pi->ctr.cycles_print += cycles_now() - start;
+        payload_check(pi, pkt, opts);
+    }
+    else if (pkt->cls == PKT_ERROR) {
+        if (pi->aimd && icmph->type == ICMP_SOURCE_QUENCH)
+            aimd_on_quench(pi, pkt->seq);
+        clock_wall(&pi->clock, &pkt->ts, &wall);
+        print_err_info(pkt->buf, &wall, opts);
     }
-    else if (icmph->type == ICMP_TIME_EXCEEDED) {
-        struct iphdr *ip = (struct iphdr *)buf;
-        char addr_str[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &ip->saddr, addr_str, sizeof(addr_str));
-        ft_printf("From %s: Time to live exceeded\n", addr_str);
+    else
+        return 0;
+
+    return 1;
+}
+
+/**
+ * Classify a single received packet and account for it.
+ *
+ * @param buf: Received packet, starting at the IP header, in a buffer of
+ *             at least RECV_PACK_SIZE bytes.
+ * @param nb_bytes: Number of bytes received.
+ * @param t_recv: Reception time of the packet.
+ * @param pi: Packet info tracker.
+ * @param opts: Program options.
+ * @param si: Pointer to remote socket info.
+
+ * Return 1 if the packet was handled, 0 if it was not for us, -1 on error.
+ */
+int icmp_process_packet(uint8_t *buf, ssize_t nb_bytes, const struct timeval *t_recv, t_packinfo *pi, const t_options *opts, const t_sockinfo *si) {
+    t_pkt pkt = { .buf = buf, .len = nb_bytes, .size = RECV_PACK_SIZE, .ts = *t_recv };
+
+    classify_batch(&pkt, 1, pi->ident, opts->verify_csum, pi->replay_sent == NULL);
+    return icmp_handle_packet(&pkt, pi, opts, si);
+}
+
+/**
+ * Drain the packets waiting on a packet source.
+ *
+ * Reads up to RECV_BATCH packets, classifies them in one pass, then
+ * accounts for each in arrival order. Polls, empty polls, bytes and the
+ * time spent in each stage are accumulated in pi->ctr, and the packets
+ * the source dropped locally so far are copied to pi->nb_local_drop.
+ *
+ * @param src: Packet source (raw socket or capture file).
+ * @param pi: Packet info tracker.
+ * @param opts: Program options.
+ * @param si: Pointer to remote socket info.
+
+ * Return 1 if a packet was received, 0 if no data, -1 on error.
+ */
+int icmp_recv_ping(t_source *src, t_packinfo *pi, const t_options *opts, const t_sockinfo *si) {
+    t_pkt pkts[RECV_BATCH];
+    ssize_t nb_bytes = 0;
+    uint64_t start = cycles_now();
+    uint64_t polled;
+    size_t n = 0;
+
+    while (n < RECV_BATCH) {
+        timerclear(&pkts[n].ts);
+        pkts[n].buf = pi->recv_bufs + n * pi->recv_size;
+        pkts[n].size = pi->recv_size;
+        nb_bytes = src->next(src, pkts[n].buf, pi->recv_size, &pkts[n].ts);
+        pi->ctr.nb_recv_calls++;
+        if (nb_bytes == 0)
+            pi->ctr.nb_eagain++;
+        if (nb_bytes <= 0)
+            break;
+        pi->ctr.bytes_recv += nb_bytes;
+        pkts[n].len = nb_bytes;
+        n++;
     }
+    polled = cycles_now();
+    pi->ctr.cycles_recv += polled - start;
+    pi->nb_local_drop = src->drops;
+    if (nb_bytes == -1)
+        return -1;
+    if (n == 0)
+        return 0;
+
+    clock_update(&pi->clock);
+    for (size_t i = 0; i < n; i++)
+        if (!timerisset(&pkts[i].ts))
+            pkts[i].ts = pi->clock.now;
+    classify_batch(pkts, n, pi->ident, opts->verify_csum, 1);
+    for (size_t i = 0; i < n; i++) {
+        int ret = icmp_handle_packet(&pkts[i], pi, opts, si);
 
+        if (ret == -1)
+            return -1;
+        if (ret == 0 && pkts[i].cls != PKT_MALFORMED)
+            pi->ctr.nb_foreign++;
+    }
+    pi->ctr.cycles_process += cycles_now() - polled;
     return 1;
 }
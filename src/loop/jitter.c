@@ -0,0 +1,75 @@
+#include "../../inc/loop.h"
+
+/**
+ * Account for the RTT of a reply in the delay variation statistics.
+ *
+ * Duplicates must not be fed: they would count as a zero RTT delta.
+ *
+ * @param j: Delay variation statistics.
+ * @param seq: Sequence number of the reply.
+ * @param rtt: RTT of the reply.
+ */
+void jitter_on_reply(t_jitter *j, uint16_t seq, const struct timeval *rtt) {
+	int64_t us = (int64_t)rtt->tv_sec * 1000000 + rtt->tv_usec;
+	double dev = us - j->mean;
+
+	j->nb++;
+	j->mean += dev / j->nb;
+	j->m2 += dev * (us - j->mean);
+	j->has_ipdv = 0;
+	if (j->nb > 1) {
+		int64_t delta = us - j->last_rtt;
+		uint64_t abs = delta < 0 ? -delta : delta;
+
+		j->jitter += (abs - j->jitter) / JITTER_GAIN;
+		j->delta_hist[shm_hist_bin(abs)]++;
+		j->nb_delta++;
+		if (seq == (uint16_t)(j->last_seq + 1)) {
+			j->has_ipdv = 1;
+			j->ipdv = delta;
+			if (j->nb_ipdv == 0 || delta < j->ipdv_min)
+				j->ipdv_min = delta;
+			if (j->nb_ipdv == 0 || delta > j->ipdv_max)
+				j->ipdv_max = delta;
+			j->nb_ipdv++;
+		}
+	}
+	j->last_rtt = us;
+	j->last_seq = seq;
+}
+
+/**
+ * Sample standard deviation of the RTTs.
+ *
+ * @param j: Delay variation statistics.
+ *
+ * Return the standard deviation in microseconds, 0 below two replies.
+ */
+double jitter_stddev(const t_jitter *j) {
+	return j->nb > 1 ? sqrt(j->m2 / (j->nb - 1)) : 0.0;
+}
+
+/**
+ * Quantile of the absolute RTT deltas.
+ *
+ * @param j: Delay variation statistics.
+ * @param q: Quantile, between 0 and 1.
+ *
+ * Return the upper bound of the histogram bin holding it, in microseconds,
+ * or 0 without any delta.
+ */
+uint64_t jitter_delta_quantile(const t_jitter *j, double q) {
+	uint64_t rank = (uint64_t)ceil(q * j->nb_delta);
+	uint64_t seen = 0;
+
+	if (j->nb_delta == 0)
+		return 0;
+	if (rank == 0)
+		rank = 1;
+	for (int bin = 0; bin < SHM_HIST_BINS; bin++) {
+		seen += j->delta_hist[bin];
+		if (seen >= rank)
+			return shm_hist_upper(bin);
+	}
+	return shm_hist_upper(SHM_HIST_BINS - 1);
+}
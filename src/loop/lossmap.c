@@ -0,0 +1,141 @@
+#include "../../inc/loop.h"
+
+/**
+ * Set up the probe outcome map of a ping run.
+ *
+ * @param pi: Pointer to packet tracking info.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int lossmap_init(t_packinfo *pi) {
+	t_lossmap *l = calloc(1, sizeof(*l));
+
+	if (l == NULL || (l->sent_ms = calloc(UINT16_MAX + 1, sizeof(*l->sent_ms))) == NULL) {
+		ft_printf("ft_ping: cannot allocate loss map\n");
+		free(l);
+		return -1;
+	}
+	pi->lossmap = l;
+	return 0;
+}
+
+/**
+ * Close the current run of equal outcomes.
+ *
+ * @param l: Probe outcome map.
+ * @param end_ms: Send time of the probe that ended the run.
+ */
+static void lossmap_close_run(t_lossmap *l, uint32_t end_ms) {
+	if (!l->run_lost || l->run_len == 0)
+		return;
+	l->nb_bursts++;
+	l->burst_hist[63 - __builtin_clzll(l->run_len)]++;
+	if (l->run_len > l->longest) {
+		l->longest = l->run_len;
+		l->longest_start_ms = l->run_start_ms;
+		l->longest_end_ms = end_ms;
+	}
+}
+
+/**
+ * Fold the oldest probe still in the bitmap into the runs.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param l: Probe outcome map.
+ */
+static void lossmap_fold(t_packinfo *pi, t_lossmap *l) {
+	uint16_t seq = l->first_seq + l->nb_folded;
+	_Bool lost = !(pi->seq_seen[seq >> 3] & (1 << (seq & 7)));
+
+	if (l->run_len && lost != l->run_lost) {
+		lossmap_close_run(l, l->sent_ms[seq]);
+		if (lost)
+			l->nb_to_lost++;
+		else
+			l->nb_to_recv++;
+		l->run_len = 0;
+	}
+	if (l->run_len == 0) {
+		l->run_lost = lost;
+		l->run_start_ms = l->sent_ms[seq];
+	}
+	l->run_len++;
+	if (lost)
+		l->nb_lost++;
+	else
+		l->nb_recv++;
+	l->nb_folded++;
+}
+
+/**
+ * Record a probe about to be sent, before its sequence number is cleared
+ * from the bitmap; the probe 65536 sends ago, which used it, is folded
+ * first. Must be called after pi->start_time is set.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param seq: Sequence number of the probe.
+ * @param sent: Send time of the probe.
+ */
+void lossmap_on_send(t_packinfo *pi, uint16_t seq, const struct timeval *sent) {
+	t_lossmap *l = pi->lossmap;
+	struct timeval since;
+
+	if (l == NULL)
+		return;
+	if (pi->nb_send == 0)
+		l->first_seq = seq;
+	if (pi->nb_send - l->nb_folded > UINT16_MAX)
+		lossmap_fold(pi, l);
+	timersub(sent, &pi->start_time, &since);
+	l->sent_ms[seq] = since.tv_sec < 0 ? 0 : since.tv_sec * 1000 + since.tv_usec / 1000;
+}
+
+/**
+ * Fold every probe left in the bitmap, at the end of the run. Probes
+ * still unanswered count as lost, as in the loss percentage; a burst
+ * running at the end is marked open.
+ *
+ * @param pi: Pointer to packet tracking info.
+ */
+void lossmap_finish(t_packinfo *pi) {
+	t_lossmap *l = pi->lossmap;
+	uint64_t longest;
+	struct timeval since;
+
+	if (l == NULL)
+		return;
+	while (l->nb_folded < (uint64_t)pi->nb_send)
+		lossmap_fold(pi, l);
+	longest = l->longest;
+	timersub(&pi->end_time, &pi->start_time, &since);
+	lossmap_close_run(l, since.tv_sec < 0 ? 0 : since.tv_sec * 1000 + since.tv_usec / 1000);
+	l->longest_open = l->longest != longest;
+	l->run_len = 0;
+}
+
+/**
+ * Convert a send time of the map to wall clock time.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param ms: Milliseconds since pi->start_time.
+ * @param wall: Wall clock time.
+ */
+void lossmap_wall(const t_packinfo *pi, uint32_t ms, struct timeval *wall) {
+	struct timeval since = { .tv_sec = ms / 1000, .tv_usec = ms % 1000 * 1000 };
+	struct timeval t;
+
+	timeradd(&pi->start_time, &since, &t);
+	clock_wall(&pi->clock, &t, wall);
+}
+
+/**
+ * Free the probe outcome map.
+ *
+ * @param pi: Pointer to the packet info structure.
+ */
+void lossmap_clean(t_packinfo *pi) {
+	if (pi->lossmap)
+		free(pi->lossmap->sent_ms);
+	free(pi->lossmap);
+	pi->lossmap = NULL;
+}
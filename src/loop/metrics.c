@@ -0,0 +1,332 @@
+#include "../../inc/loop.h"
+
+#include <stdarg.h>
+#include <sys/un.h>
+
+static const struct {
+	const char *name;
+	int secs;
+} windows[] = {
+	{ "10s", 10 },
+	{ "1m", 60 },
+	{ "5m", 300 },
+};
+
+/**
+ * Open the metrics endpoint: a non-blocking unix stream socket at `path`.
+ *
+ * @param pi: Pointer to the packet info structure receiving the metrics state.
+ * @param path: Filesystem path of the unix socket.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int metrics_init(t_packinfo *pi, char *path) {
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	t_metrics *m;
+
+	if (ft_strlen(path) >= sizeof(addr.sun_path)) {
+		ft_printf("ft_ping: metrics socket path too long\n");
+		return -1;
+	}
+	if ((m = calloc(1, sizeof(*m))) == NULL) {
+		ft_printf("ft_ping: cannot allocate metrics\n");
+		return -1;
+	}
+	for (int i = 0; i < METRICS_MAX_CLIENTS; i++)
+		m->clients[i].fd = -1;
+	m->path = path;
+	m->clock = &pi->clock;
+	memcpy(addr.sun_path, path, ft_strlen(path));
+
+	m->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (m->listen_fd == -1) {
+		perror("socket (metrics)");
+		free(m);
+		return -1;
+	}
+	if (unlink_stale_socket(path) == -1) {
+		close(m->listen_fd);
+		free(m);
+		return -1;
+	}
+	if (bind(m->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1
+		|| listen(m->listen_fd, METRICS_MAX_CLIENTS) == -1) {
+		perror("bind (metrics)");
+		close(m->listen_fd);
+		free(m);
+		return -1;
+	}
+	pi->metrics = m;
+	return 0;
+}
+
+/**
+ * Get the bucket of the current second, recycling it if it is stale.
+ *
+ * @param m: Pointer to the metrics state.
+ *
+ * Return pointer to the current bucket.
+ */
+static t_bucket *metrics_bucket(t_metrics *m) {
+	time_t now = m->clock->now.tv_sec;
+	t_bucket *b;
+
+	b = &m->ring[now % METRICS_RING_SIZE];
+	if (b->sec != now) {
+		ft_memset(b, 0, sizeof(*b));
+		b->sec = now;
+	}
+	return b;
+}
+
+/**
+ * Get the bucket of a past second, if the ring still holds it.
+ *
+ * @param m: Pointer to the metrics state.
+ * @param sec: Second of the bucket.
+ *
+ * Return pointer to the bucket, or NULL if it was recycled.
+ */
+static t_bucket *metrics_bucket_at(t_metrics *m, time_t sec) {
+	t_bucket *b = &m->ring[sec % METRICS_RING_SIZE];
+
+	return b->sec == sec && sec != 0 ? b : NULL;
+}
+
+/**
+ * Account for a sent probe in the current bucket.
+ *
+ * @param m: Pointer to the metrics state, may be NULL.
+ */
+void metrics_on_send(t_metrics *m) {
+	if (m)
+		metrics_bucket(m)->nb_send++;
+}
+
+/**
+ * Account for a received reply in the bucket its probe was sent in, so
+ * that a window only ever compares probes with their own replies.
+ *
+ * @param m: Pointer to the metrics state, may be NULL.
+ * @param sent: Send time of the probe, on the loop clock.
+ * @param rtt: Round-trip time of the reply.
+ * @param late: The probe already timed out: its timeout is taken back.
+ */
+void metrics_on_reply(t_metrics *m, const struct timeval *sent, const struct timeval *rtt, _Bool late) {
+	t_bucket *b;
+	uint64_t usec;
+
+	if (!m || (b = metrics_bucket_at(m, sent->tv_sec)) == NULL)
+		return;
+	if (late && b->nb_timeout)
+		b->nb_timeout--;
+	usec = rtt->tv_sec * 1000000 + rtt->tv_usec;
+	if (b->nb_recv == 0 || usec < b->rtt_min)
+		b->rtt_min = usec;
+	if (usec > b->rtt_max)
+		b->rtt_max = usec;
+	b->rtt_sum += usec;
+	b->rtt_sq_sum += usec * usec;
+	b->nb_recv++;
+}
+
+/**
+ * Account for a probe that timed out in the bucket it was sent in.
+ *
+ * @param m: Pointer to the metrics state, may be NULL.
+ * @param sent: Send time of the probe, on the loop clock.
+ */
+void metrics_on_timeout(t_metrics *m, const struct timeval *sent) {
+	t_bucket *b;
+
+	if (m && (b = metrics_bucket_at(m, sent->tv_sec)) != NULL)
+		b->nb_timeout++;
+}
+
+/**
+ * Merge the buckets of the last `secs` seconds into a single one, leaving
+ * out the second in progress.
+ *
+ * @param m: Pointer to the metrics state.
+ * @param now: Current second.
+ * @param secs: Length of the window.
+ * @param out: Aggregated bucket.
+ */
+static void metrics_window(const t_metrics *m, time_t now, int secs, t_bucket *out) {
+	ft_memset(out, 0, sizeof(*out));
+	for (int i = 1; i <= secs; i++) {
+		const t_bucket *b = &m->ring[(now - i) % METRICS_RING_SIZE];
+
+		if (b->sec != now - i || b->sec == 0)
+			continue;
+		if (b->nb_recv && (out->nb_recv == 0 || b->rtt_min < out->rtt_min))
+			out->rtt_min = b->rtt_min;
+		if (b->rtt_max > out->rtt_max)
+			out->rtt_max = b->rtt_max;
+		out->nb_send += b->nb_send;
+		out->nb_recv += b->nb_recv;
+		out->nb_timeout += b->nb_timeout;
+		out->rtt_sum += b->rtt_sum;
+		out->rtt_sq_sum += b->rtt_sq_sum;
+	}
+}
+
+/**
+ * Append formatted text to the response body, truncating it when full.
+ *
+ * @param body: Response body.
+ * @param size: Size of the body buffer.
+ * @param len: Length of the body so far, never past size - 1.
+ * @param fmt: printf format of the text.
+ */
+static void metrics_append(char *body, size_t size, size_t *len, const char *fmt, ...) {
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(body + *len, size - *len, fmt, ap);
+	va_end(ap);
+	if (n > 0)
+		*len = *len + n < size ? *len + n : size - 1;
+}
+
+/**
+ * Render the Prometheus text exposition into a client buffer.
+ *
+ * @param m: Pointer to the metrics state.
+ * @param si: Pointer to remote socket info.
+ * @param pi: Pointer to packet tracking info.
+ * @param c: Client whose buffer receives the response.
+ */
+static void metrics_render(const t_metrics *m, const t_sockinfo *si, const t_packinfo *pi, t_metrics_client *c) {
+	char body[METRICS_BUF_SIZE - 128];
+	time_t now = m->clock->now.tv_sec;
+	size_t len = 0;
+	t_bucket w;
+
+	metrics_append(body, sizeof(body), &len,
+		"# HELP ft_ping_sent_total Echo requests sent.\n"
+		"# TYPE ft_ping_sent_total counter\n"
+		"ft_ping_sent_total{target=\"%s\"} %d\n"
+		"# HELP ft_ping_received_total Echo replies received.\n"
+		"# TYPE ft_ping_received_total counter\n"
+		"ft_ping_received_total{target=\"%s\"} %d\n",
+		si->str_sin_addr, pi->nb_send, si->str_sin_addr, pi->nb_ok);
+	metrics_append(body, sizeof(body), &len,
+		"# HELP ft_ping_window_loss_ratio Share of the probes sent over the window that timed out, "
+		"of those answered or timed out.\n"
+		"# TYPE ft_ping_window_loss_ratio gauge\n"
+		"# HELP ft_ping_window_rtt_seconds Round-trip time over the window.\n"
+		"# TYPE ft_ping_window_rtt_seconds gauge\n");
+	for (size_t i = 0; i < sizeof(windows) / sizeof(*windows); i++) {
+		double avg = 0.0;
+		double var = 0.0;
+
+		metrics_window(m, now, windows[i].secs, &w);
+		if (w.nb_recv) {
+			avg = (double)w.rtt_sum / w.nb_recv;
+			var = (double)w.rtt_sq_sum / w.nb_recv - avg * avg;
+		}
+		metrics_append(body, sizeof(body), &len,
+			"ft_ping_window_loss_ratio{target=\"%s\",window=\"%s\"} %f\n"
+			"ft_ping_window_rtt_seconds{target=\"%s\",window=\"%s\",stat=\"min\"} %f\n"
+			"ft_ping_window_rtt_seconds{target=\"%s\",window=\"%s\",stat=\"avg\"} %f\n"
+			"ft_ping_window_rtt_seconds{target=\"%s\",window=\"%s\",stat=\"max\"} %f\n"
+			"ft_ping_window_rtt_seconds{target=\"%s\",window=\"%s\",stat=\"stddev\"} %f\n",
+			si->str_sin_addr, windows[i].name,
+			w.nb_timeout ? (double)w.nb_timeout / (w.nb_recv + w.nb_timeout) : 0.0,
+			si->str_sin_addr, windows[i].name, w.rtt_min / 1e6,
+			si->str_sin_addr, windows[i].name, avg / 1e6,
+			si->str_sin_addr, windows[i].name, w.rtt_max / 1e6,
+			si->str_sin_addr, windows[i].name, var > 0.0 ? sqrt(var) / 1e6 : 0.0);
+	}
+	c->len = snprintf(c->buf, sizeof(c->buf),
+		"HTTP/1.0 200 OK\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n"
+		"Content-Length: %zu\r\n\r\n%s", len, body);
+	c->off = 0;
+	c->replying = 1;
+}
+
+/**
+ * Drop a client connection.
+ *
+ * @param c: Client to close.
+ */
+static void metrics_drop(t_metrics_client *c) {
+	close(c->fd);
+	c->fd = -1;
+	c->replying = 0;
+	c->len = 0;
+}
+
+/**
+ * Make progress on the metrics endpoint without ever blocking.
+ *
+ * Called once per loop iteration: accepts pending connections, reads
+ * requests until the end of headers, then writes the response as far
+ * as the socket buffer allows. A slow scraper only delays itself.
+ *
+ * @param si: Pointer to remote socket info.
+ * @param pi: Pointer to packet tracking info.
+ */
+void metrics_serve(const t_sockinfo *si, const t_packinfo *pi) {
+	t_metrics *m = pi->metrics;
+	t_metrics_client *c;
+	ssize_t n;
+	int fd;
+
+	if (!m)
+		return;
+	while ((fd = accept(m->listen_fd, NULL, NULL)) != -1) {
+		for (c = m->clients; c < m->clients + METRICS_MAX_CLIENTS && c->fd != -1; c++)
+			;
+		if (c == m->clients + METRICS_MAX_CLIENTS) {
+			close(fd);
+			break;
+		}
+		c->fd = fd;
+	}
+	for (c = m->clients; c < m->clients + METRICS_MAX_CLIENTS; c++) {
+		if (c->fd == -1)
+			continue;
+		if (!c->replying) {
+			n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len - 1, MSG_DONTWAIT);
+			if (n == 0 || (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+				metrics_drop(c);
+				continue;
+			}
+			if (n > 0)
+				c->len += n;
+			c->buf[c->len] = '\0';
+			if (!ft_strnstr(c->buf, "\r\n\r\n", c->len) && !ft_strnstr(c->buf, "\n\n", c->len)
+				&& c->len < sizeof(c->buf) - 1)
+				continue;
+			metrics_render(m, si, pi, c);
+		}
+		n = send(c->fd, c->buf + c->off, c->len - c->off, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			continue;
+		if (n == -1 || (c->off += n) == c->len)
+			metrics_drop(c);
+	}
+}
+
+/**
+ * Close the endpoint and free the metrics state.
+ *
+ * @param pi: Pointer to the packet info structure.
+ */
+void metrics_clean(t_packinfo *pi) {
+	t_metrics *m = pi->metrics;
+
+	if (!m)
+		return;
+	for (int i = 0; i < METRICS_MAX_CLIENTS; i++)
+		if (m->clients[i].fd != -1)
+			close(m->clients[i].fd);
+	close(m->listen_fd);
+	unlink(m->path);
+	free(m);
+	pi->metrics = NULL;
+}
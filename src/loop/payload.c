@@ -0,0 +1,133 @@
+#include "../../inc/loop.h"
+
+#include <sys/random.h>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+/**
+ * Write the payload every echo request carries after its send time.
+ *
+ * It is written once, to the send buffer, and is the expected content of
+ * every reply: zeros by default, the -p pattern repeated, or random bytes
+ * drawn once per run.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param opts: Pointer to the user options structure.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int payload_init(t_packinfo *pi, const t_options *opts) {
+	uint8_t *payload = icmp_payload();
+	size_t len = PAYLOAD_MAX_SIZE;
+
+	if (opts->random_payload) {
+		for (size_t off = 0; off < len; ) {
+			ssize_t nb = getrandom(payload + off, len - off, 0);
+
+			if (nb == -1 && errno != EINTR) {
+				ft_printf("ft_ping: getrandom: %s\n", strerror(errno));
+				return -1;
+			}
+			off += nb > 0 ? nb : 0;
+		}
+	} else if (opts->pattern_len) {
+		for (size_t off = 0; off < len; off++)
+			payload[off] = opts->pattern[off % opts->pattern_len];
+	}
+	pi->payload = payload;
+	return 0;
+}
+
+/**
+ * Offset of the first byte that differs between two buffers.
+ *
+ * Compares 64 bytes per iteration with SSE2, then 16, then byte by byte.
+ *
+ * @param a: First buffer.
+ * @param b: Second buffer.
+ * @param n: Bytes to compare.
+ *
+ * Return the offset of the first difference, or n if the buffers are equal.
+ */
+static size_t payload_diff(const uint8_t *a, const uint8_t *b, size_t n) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 64 <= n; i += 64) {
+		__m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)));
+		__m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 16)), _mm_loadu_si128((const __m128i *)(b + i + 16)));
+		__m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 32)), _mm_loadu_si128((const __m128i *)(b + i + 32)));
+		__m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 48)), _mm_loadu_si128((const __m128i *)(b + i + 48)));
+
+		if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3))) != 0xffff)
+			break;
+	}
+	for (; i + 16 <= n; i += 16) {
+		unsigned eq = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+			_mm_loadu_si128((const __m128i *)(b + i))));
+
+		if (eq != 0xffff)
+			return i + __builtin_ctz(~eq);
+	}
+#else
+	for (; i + 8 <= n; i += 8) {
+		uint64_t x;
+		uint64_t y;
+
+		memcpy(&x, a + i, sizeof(x));
+		memcpy(&y, b + i, sizeof(y));
+		if (x != y)
+			break;
+	}
+#endif
+	for (; i < n; i++)
+		if (a[i] != b[i])
+			return i;
+	return n;
+}
+
+/**
+ * Check the payload echoed in a reply against the one sent.
+ *
+ * Only the bytes received are compared: a reply cut short on the way is
+ * not corrupted. Mismatching bytes are counted and the first
+ * PAYLOAD_REPORT_MAX of them printed, by offset in the ICMP data as ping
+ * has always numbered them.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param pkt: Echo reply, classified.
+ * @param opts: Pointer to the user options structure.
+ *
+ * Return the number of mismatching bytes.
+ */
+size_t payload_check(t_packinfo *pi, const t_pkt *pkt, const t_options *opts) {
+	size_t start = pkt->icmp_off + ICMP_HDR_SIZE + sizeof(struct timeval);
+	size_t avail = (size_t)pkt->len < pkt->size ? (size_t)pkt->len : pkt->size;
+	size_t n = pi->body_size - sizeof(struct timeval);
+	const uint8_t *got = pkt->buf + start;
+	size_t offs[PAYLOAD_REPORT_MAX];
+	size_t nb_diff = 0;
+
+	if (pi->payload == NULL || pi->body_size <= sizeof(struct timeval) || avail <= start)
+		return 0;
+	if (n > avail - start)
+		n = avail - start;
+	for (size_t off = payload_diff(got, pi->payload, n); off < n;
+			off = off + 1 + payload_diff(got + off + 1, pi->payload + off + 1, n - off - 1)) {
+		if (nb_diff < PAYLOAD_REPORT_MAX)
+			offs[nb_diff] = off;
+		nb_diff++;
+	}
+	if (nb_diff == 0)
+		return 0;
+	pi->nb_corrupt++;
+	if (opts->quiet)
+		return nb_diff;
+	printf("icmp_seq=%d: payload corrupted, %zu of %zu bytes differ:", pkt->seq, nb_diff, n);
+	for (size_t i = 0; i < nb_diff && i < PAYLOAD_REPORT_MAX; i++)
+		printf(" #%zu 0x%02x != 0x%02x", offs[i] + sizeof(struct timeval), got[offs[i]], pi->payload[offs[i]]);
+	printf(nb_diff > PAYLOAD_REPORT_MAX ? " ...\n" : "\n");
+	return nb_diff;
+}
@@ -0,0 +1,344 @@
+#include "../../inc/loop.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PCAP_MAGIC_US 0xa1b2c3d4
+#define PCAP_MAGIC_NS 0xa1b23c4d
+#define PCAPNG_SHB 0x0a0d0d0a
+#define PCAPNG_BYTE_ORDER 0x1a2b3c4d
+#define PCAPNG_IDB 1
+#define PCAPNG_EPB 6
+#define PCAPNG_OPT_TSRESOL 9
+#define PCAPNG_TSRESOL_MAX10 19
+#define PCAPNG_TSRESOL_MAX2 63
+
+#define LINKTYPE_NULL 0
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW_BSD 12
+#define LINKTYPE_RAW_OPENBSD 14
+#define LINKTYPE_RAW 101
+#define LINKTYPE_LINUX_SLL 113
+#define LINKTYPE_IPV4 228
+#define LINKTYPE_LINUX_SLL2 276
+
+/**
+ * Read a 16-bit field in the byte order of the capture.
+ *
+ * @param src: Capture packet source.
+ * @param p: Pointer to the field, may be unaligned.
+ */
+static uint16_t rd16(const t_source *src, const uint8_t *p) {
+	uint16_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return src->swapped ? __builtin_bswap16(v) : v;
+}
+
+/**
+ * Read a 32-bit field in the byte order of the capture.
+ *
+ * @param src: Capture packet source.
+ * @param p: Pointer to the field, may be unaligned.
+ */
+static uint32_t rd32(const t_source *src, const uint8_t *p) {
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return src->swapped ? __builtin_bswap32(v) : v;
+}
+
+/**
+ * Strip the link-layer header of a captured frame.
+ *
+ * @param linktype: Link type of the interface the frame was captured on.
+ * @param data: Captured frame.
+ * @param caplen: Captured length.
+ * @param ip: Output pointer to the IPv4 header.
+ *
+ * Return the length left from the IPv4 header, or -1 if the frame is not IPv4.
+ */
+static ssize_t strip_link(uint32_t linktype, const uint8_t *data, size_t caplen, const uint8_t **ip) {
+	size_t off;
+	uint16_t proto;
+
+	switch (linktype) {
+	case LINKTYPE_NULL:
+		if (caplen < 4 || (data[0] != AF_INET && data[3] != AF_INET))
+			return -1;
+		off = 4;
+		break;
+	case LINKTYPE_ETHERNET:
+		off = 12;
+		if (caplen < off + 2)
+			return -1;
+		proto = (data[off] << 8) | data[off + 1];
+		while ((proto == 0x8100 || proto == 0x88a8) && caplen >= off + 6) {
+			off += 4;
+			proto = (data[off] << 8) | data[off + 1];
+		}
+		if (proto != 0x0800)
+			return -1;
+		off += 2;
+		break;
+	case LINKTYPE_RAW_BSD:
+	case LINKTYPE_RAW_OPENBSD:
+	case LINKTYPE_RAW:
+	case LINKTYPE_IPV4:
+		off = 0;
+		break;
+	case LINKTYPE_LINUX_SLL:
+		if (caplen < 16 || ((data[14] << 8) | data[15]) != 0x0800)
+			return -1;
+		off = 16;
+		break;
+	case LINKTYPE_LINUX_SLL2:
+		if (caplen < 20 || ((data[0] << 8) | data[1]) != 0x0800)
+			return -1;
+		off = 20;
+		break;
+	default:
+		return -1;
+	}
+	if (caplen < off + IP_HDR_SIZE || (data[off] >> 4) != 4)
+		return -1;
+	*ip = data + off;
+	return caplen - off;
+}
+
+/**
+ * Hand a captured frame over to the caller.
+ *
+ * The IPv4 packet is copied into the caller's buffer, truncated to its size
+ * like recvmsg() would, and its capture time is converted to a timeval.
+ *
+ * @param src: Capture packet source.
+ * @param iface: Interface the frame was captured on.
+ * @param data: Captured frame.
+ * @param caplen: Captured length.
+ * @param units: Capture time, in units of the interface resolution.
+ * @param buf: Buffer receiving the packet.
+ * @param size: Size of the buffer.
+ * @param ts: Capture time of the packet.
+ *
+ * Return the number of bytes copied, or 0 if the frame is not IPv4.
+ */
+static ssize_t deliver(t_source *src, const t_pcap_iface *iface, const uint8_t *data, size_t caplen,
+		uint64_t units, uint8_t *buf, size_t size, struct timeval *ts) {
+	const uint8_t *ip;
+	ssize_t len = strip_link(iface->linktype, data, caplen, &ip);
+
+	if (len <= 0)
+		return 0;
+	if ((size_t)len > size)
+		len = size;
+	memcpy(buf, ip, len);
+	ts->tv_sec = units / iface->ts_per_sec;
+	ts->tv_usec = (unsigned __int128)(units % iface->ts_per_sec) * 1000000 / iface->ts_per_sec;
+	src->nb_packets++;
+	return len;
+}
+
+/**
+ * Read the next IPv4 packet of a classic pcap file.
+ *
+ * @param src: Capture packet source.
+ * @param buf: Buffer receiving the packet, starting at the IP header.
+ * @param size: Size of the buffer.
+ * @param ts: Capture time of the packet.
+ *
+ * Return the number of bytes copied, 0 at end of file (src->eof is set), -1 on error.
+ */
+static ssize_t pcap_next(t_source *src, uint8_t *buf, size_t size, struct timeval *ts) {
+	const uint8_t *rec;
+	uint32_t caplen;
+	ssize_t len;
+
+	while (src->off + 16 <= src->map_len) {
+		rec = src->map + src->off;
+		caplen = rd32(src, rec + 8);
+		if (src->off + 16 + caplen > src->map_len)
+			break;
+		src->off += 16 + caplen;
+		len = deliver(src, &src->ifaces[0], rec + 16, caplen,
+			(uint64_t)rd32(src, rec) * src->ifaces[0].ts_per_sec + rd32(src, rec + 4),
+			buf, size, ts);
+		if (len > 0)
+			return len;
+	}
+	src->eof = 1;
+	return 0;
+}
+
+/**
+ * Register a pcapng interface description block.
+ *
+ * The timestamp resolution must fit in 64 bits: 10^19 and 2^63 at most.
+ *
+ * @param src: Capture packet source.
+ * @param blk: Start of the block.
+ * @param blk_len: Total length of the block.
+ *
+ * Return 0 on success, -1 if the resolution is out of range.
+ */
+static int pcapng_add_iface(t_source *src, const uint8_t *blk, uint32_t blk_len) {
+	t_pcap_iface *iface;
+	size_t off = 16;
+
+	if (src->nb_ifaces >= PCAP_MAX_IFACES || blk_len < 20)
+		return 0;
+	iface = &src->ifaces[src->nb_ifaces++];
+	iface->linktype = rd16(src, blk + 8);
+	iface->ts_per_sec = 1000000;
+	while (off + 4 <= blk_len - 4) {
+		uint16_t code = rd16(src, blk + off);
+		uint16_t len = rd16(src, blk + off + 2);
+
+		if (code == 0)
+			break;
+		if (code == PCAPNG_OPT_TSRESOL && len >= 1) {
+			uint8_t res = blk[off + 4];
+
+			if ((res & 0x7f) > ((res & 0x80) ? PCAPNG_TSRESOL_MAX2 : PCAPNG_TSRESOL_MAX10))
+				return -1;
+			iface->ts_per_sec = 1;
+			for (int i = 0; i < (res & 0x7f); i++)
+				iface->ts_per_sec *= (res & 0x80) ? 2 : 10;
+		}
+		off += 4 + ((len + 3) & ~3);
+	}
+	return 0;
+}
+
+/**
+ * Read the next IPv4 packet of a pcapng file.
+ *
+ * Section headers switch the byte order and reset the interface table,
+ * interface blocks define link type and timestamp resolution, enhanced
+ * packet blocks carry the packets. Other blocks are skipped.
+ *
+ * @param src: Capture packet source.
+ * @param buf: Buffer receiving the packet, starting at the IP header.
+ * @param size: Size of the buffer.
+ * @param ts: Capture time of the packet.
+ *
+ * Return the number of bytes copied, 0 at end of file (src->eof is set), -1 on error.
+ */
+static ssize_t pcapng_next(t_source *src, uint8_t *buf, size_t size, struct timeval *ts) {
+	const uint8_t *blk;
+	uint32_t type;
+	uint32_t blk_len;
+	ssize_t len;
+
+	while (src->off + 12 <= src->map_len) {
+		blk = src->map + src->off;
+		memcpy(&type, blk, sizeof(type));
+		if (type == PCAPNG_SHB) {
+			uint32_t bom;
+
+			memcpy(&bom, blk + 8, sizeof(bom));
+			src->swapped = bom != PCAPNG_BYTE_ORDER;
+			src->nb_ifaces = 0;
+		}
+		type = rd32(src, blk);
+		blk_len = rd32(src, blk + 4);
+		if (blk_len < 12 || src->off + blk_len > src->map_len) {
+			ft_printf("ft_ping: truncated pcapng block at offset %zu\n", src->off);
+			return -1;
+		}
+		src->off += blk_len;
+		if (type == PCAPNG_IDB) {
+			if (pcapng_add_iface(src, blk, blk_len) == -1) {
+				ft_printf("ft_ping: bad timestamp resolution at offset %zu: not a capture file\n",
+					src->off - blk_len);
+				return -1;
+			}
+		} else if (type == PCAPNG_EPB && blk_len >= 32) {
+			uint32_t id = rd32(src, blk + 8);
+			uint32_t caplen = rd32(src, blk + 20);
+
+			if (id >= (uint32_t)src->nb_ifaces || caplen > blk_len - 28)
+				continue;
+			len = deliver(src, &src->ifaces[id], blk + 28, caplen,
+				((uint64_t)rd32(src, blk + 12) << 32) | rd32(src, blk + 16),
+				buf, size, ts);
+			if (len > 0)
+				return len;
+		}
+	}
+	src->eof = 1;
+	return 0;
+}
+
+/**
+ * Unmap the capture file.
+ *
+ * @param src: Capture packet source.
+ */
+static void pcap_close(t_source *src) {
+	if (src->map)
+		munmap(src->map, src->map_len);
+	src->map = NULL;
+}
+
+/**
+ * Make a packet source reading a pcap or pcapng capture file.
+ *
+ * The file is mapped in memory and read sequentially, so replay speed is
+ * bound by parsing rather than by read() calls.
+ *
+ * @param src: Packet source to initialize.
+ * @param path: Path of the capture file.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int source_open_pcap(t_source *src, const char *path) {
+	struct stat st;
+	uint32_t magic;
+	int fd;
+
+	ft_memset(src, 0, sizeof(*src));
+	src->fd = -1;
+	src->close = pcap_close;
+	if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+		ft_printf("ft_ping: %s: %s\n", path, strerror(errno));
+		if (fd != -1)
+			close(fd);
+		return -1;
+	}
+	if (st.st_size < 24) {
+		ft_printf("ft_ping: %s: not a capture file\n", path);
+		close(fd);
+		return -1;
+	}
+	src->map_len = st.st_size;
+	src->map = mmap(NULL, src->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (src->map == MAP_FAILED) {
+		src->map = NULL;
+		perror("mmap");
+		return -1;
+	}
+	madvise(src->map, src->map_len, MADV_SEQUENTIAL);
+
+	memcpy(&magic, src->map, sizeof(magic));
+	if (magic == PCAPNG_SHB) {
+		src->pcapng = 1;
+		src->next = pcapng_next;
+		return 0;
+	}
+	src->swapped = magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS);
+	magic = rd32(src, src->map);
+	if (magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS) {
+		ft_printf("ft_ping: %s: not a capture file\n", path);
+		pcap_close(src);
+		return -1;
+	}
+	src->ifaces[0].linktype = rd32(src, src->map + 20) & 0xffff;
+	src->ifaces[0].ts_per_sec = magic == PCAP_MAGIC_NS ? 1000000000 : 1000000;
+	src->nb_ifaces = 1;
+	src->off = 24;
+	src->next = pcap_next;
+	return 0;
+}
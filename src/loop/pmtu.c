@@ -0,0 +1,234 @@
+#include "../../inc/loop.h"
+
+/**
+ * MTU the kernel currently knows for the route to the target.
+ *
+ * Read with IP_MTU on a connected UDP socket, which reflects both the
+ * outgoing interface and any path MTU already learned for the destination.
+ *
+ * @param si: Pointer to remote socket info.
+ *
+ * Return the route MTU, or 0 if it cannot be read.
+ */
+static int route_mtu(const t_sockinfo *si) {
+	struct sockaddr_in addr = si->remote_addr;
+	socklen_t len = sizeof(int);
+	int mtu = 0;
+	int fd;
+
+	if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) == -1)
+		return 0;
+	addr.sin_port = htons(1025);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1
+		|| getsockopt(fd, IPPROTO_IP, IP_MTU, &mtu, &len) == -1)
+		mtu = 0;
+	close(fd);
+	return mtu;
+}
+
+/**
+ * Set up path MTU discovery between PMTU_MIN and an upper bound.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param si: Pointer to remote socket info.
+ * @param max_size: Largest IP packet size to try, 0 for the route MTU.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int pmtu_init(t_packinfo *pi, const t_sockinfo *si, int max_size) {
+	t_pmtu *pm = calloc(1, sizeof(*pm));
+
+	if (pm == NULL) {
+		ft_printf("ft_ping: cannot allocate path MTU state\n");
+		return -1;
+	}
+	if (max_size == 0 && (max_size = route_mtu(si)) == 0)
+		max_size = 1500;
+	pm->lo = PMTU_MIN;
+	pm->hi = max_size < PMTU_MIN ? PMTU_MIN : max_size > IP_MAXPACKET ? IP_MAXPACKET : max_size;
+	pi->pmtu = pm;
+	return 0;
+}
+
+/**
+ * Narrow the MTU range with the outcome of a finished round.
+ *
+ * The largest size answered is a lower bound. Sizes refused locally or
+ * with "frag needed", and sizes above that lower bound which got no answer
+ * at all (a black hole), are upper bounds. A next-hop MTU reported by a
+ * router caps the range, so it is probed right away.
+ *
+ * @param pm: Path MTU state.
+ */
+static void pmtu_narrow(t_pmtu *pm) {
+	for (int i = 0; i < PMTU_PROBES; i++)
+		if (pm->probes[i].state == PMTU_OK && pm->probes[i].size > pm->lo)
+			pm->lo = pm->probes[i].size;
+	for (int i = 0; i < PMTU_PROBES; i++) {
+		t_pmtu_probe *p = &pm->probes[i];
+
+		if ((p->state == PMTU_TOO_BIG || (p->state == PMTU_LOST && p->size > pm->lo))
+			&& p->size <= pm->hi)
+			pm->hi = p->size - 1;
+	}
+	if (pm->hint >= pm->lo && pm->hint < pm->hi)
+		pm->hi = pm->hint;
+	if (pm->hi < pm->lo)
+		pm->hi = pm->lo;
+}
+
+/**
+ * Close a round once none of its probes is pending.
+ *
+ * Either the range has converged and the loop stops, or the next round is
+ * let out immediately rather than after the interval.
+ *
+ * @param pi: Pointer to packet tracking info.
+ */
+static void pmtu_round_done(t_packinfo *pi) {
+	t_pmtu *pm = pi->pmtu;
+
+	pmtu_narrow(pm);
+	if (pm->hi <= pm->lo) {
+		pi->end_time = pi->clock.now;
+		pingloop = 0;
+	} else
+		send_packet = 1;
+}
+
+/**
+ * Send one round of DF probes spread evenly over the open MTU range.
+ *
+ * Probe i of a round has sequence number `round_seq + i` and IP size
+ * lo + ceil((hi - lo) * (i + 1) / PMTU_PROBES), so the largest probe is
+ * always hi and the range shrinks about PMTU_PROBES + 1 times per round.
+ * Sizes that round to the same value are sent once.
+ *
+ * @param src: Packet source, a socket with IP_PMTUDISC_DO set.
+ * @param si: Pointer to remote socket info.
+ * @param pi: Pointer to packet tracking info.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int pmtu_send_round(t_source *src, const t_sockinfo *si, t_packinfo *pi) {
+	t_pmtu *pm = pi->pmtu;
+	uint32_t range = pm->hi - pm->lo;
+	uint16_t prev = pm->lo;
+	uint64_t start = cycles_now();
+	int ret;
+
+	if (pi->nb_send == 0)
+		pi->start_time = pi->clock.now;
+	pi->round_seq += PMTU_PROBES;
+	pm->nb_rounds++;
+	pm->nb_pending = 0;
+	for (int i = 0; i < PMTU_PROBES; i++) {
+		t_pmtu_probe *p = &pm->probes[i];
+		uint16_t seq = pi->round_seq + i;
+
+		p->size = pm->lo + (range * (i + 1) + PMTU_PROBES - 1) / PMTU_PROBES;
+		p->state = PMTU_IDLE;
+		if (p->size == prev)
+			continue;
+		prev = p->size;
+		pi->ctr.nb_send_calls++;
+		ret = icmp_send_sized_probe(src, si, pi->ident, seq, p->size - IP_HDR_SIZE - ICMP_HDR_SIZE, &pi->clock.now);
+		if (ret == -1)
+			return -1;
+		pi->nb_send++;
+		if (ret == 1) {
+			p->state = PMTU_TOO_BIG;
+			continue;
+		}
+		PROBE2(send, seq, pi->ident);
+		icmp_arm_probe(pi, seq);
+		pi->ctr.bytes_sent += p->size - IP_HDR_SIZE;
+		p->state = PMTU_PENDING;
+		pm->nb_pending++;
+	}
+	pi->ctr.cycles_send += cycles_now() - start;
+	if (pm->nb_pending == 0)
+		pmtu_round_done(pi);
+	return 0;
+}
+
+/**
+ * Settle a probe of the current round.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param idx: Index of the probe in the round.
+ * @param state: PMTU_OK, PMTU_TOO_BIG or PMTU_LOST.
+ */
+static void pmtu_settle(t_packinfo *pi, uint16_t idx, uint8_t state) {
+	t_pmtu *pm = pi->pmtu;
+
+	pm->probes[idx].state = state;
+	if (--pm->nb_pending == 0)
+		pmtu_round_done(pi);
+}
+
+/**
+ * Account for an answer to a probe of the current round.
+ *
+ * Echo replies from the target mean the size went through; "fragmentation
+ * needed" errors quoting the probe mean it did not, and carry the MTU of
+ * the next hop (RFC 1191). Other errors are left to time out.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param pkt: Received packet, classified.
+ * @param si: Pointer to remote socket info.
+ *
+ * Return 1 if the packet answered a pending probe, 0 otherwise, -1 on error.
+ */
+int pmtu_recv(t_packinfo *pi, const t_pkt *pkt, const t_sockinfo *si) {
+	const struct iphdr *ip = (const struct iphdr *)pkt->buf;
+	const struct icmphdr *icmph = (const struct icmphdr *)(pkt->buf + pkt->icmp_off);
+	t_pmtu *pm = pi->pmtu;
+	uint16_t idx = pkt->seq - pi->round_seq;
+	uint16_t mtu;
+
+	if (idx >= PMTU_PROBES || pm->probes[idx].state != PMTU_PENDING)
+		return 0;
+	if (pkt->cls == PKT_REPLY && ip->saddr == si->remote_addr.sin_addr.s_addr) {
+		icmp_disarm_probe(pi, pkt->seq);
+		pi->nb_ok++;
+		if (rtts_save_new(pi, (struct icmphdr *)icmph, &pkt->ts) == -1)
+			return -1;
+		PROBE2(recv, pkt->seq, pi->rtt_last.tv_sec * 1000000 + pi->rtt_last.tv_usec);
+		pmtu_settle(pi, idx, PMTU_OK);
+		return 1;
+	}
+	if (pkt->cls != PKT_ERROR || icmph->type != ICMP_DEST_UNREACH || icmph->code != ICMP_FRAG_NEEDED)
+		return 0;
+	icmp_disarm_probe(pi, pkt->seq);
+	mtu = ntohs(icmph->un.frag.mtu);
+	if (mtu >= PMTU_MIN && mtu < pm->probes[idx].size && (pm->hint == 0 || mtu < pm->hint)) {
+		pm->hint = mtu;
+		pm->hint_from.s_addr = ip->saddr;
+	}
+	pmtu_settle(pi, idx, PMTU_TOO_BIG);
+	return 1;
+}
+
+/**
+ * Count a probe that got no answer in time as lost.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param seq: Sequence number of the probe.
+ */
+void pmtu_expired(t_packinfo *pi, uint16_t seq) {
+	uint16_t idx = seq - pi->round_seq;
+
+	if (idx < PMTU_PROBES && pi->pmtu->probes[idx].state == PMTU_PENDING)
+		pmtu_settle(pi, idx, PMTU_LOST);
+}
+
+/**
+ * Free the path MTU state.
+ *
+ * @param pi: Pointer to the packet info structure.
+ */
+void pmtu_clean(t_packinfo *pi) {
+	free(pi->pmtu);
+	pi->pmtu = NULL;
+}
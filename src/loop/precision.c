@@ -0,0 +1,54 @@
+#define _GNU_SOURCE
+#include "../../inc/loop.h"
+
+#include <sched.h>
+#include <sys/mman.h>
+
+/**
+ * Fault in the stack the probe loop will run on, so that it is locked
+ * with the rest of the process.
+ */
+static void precision_prefault_stack(void) {
+	volatile uint8_t stack[PRECISION_STACK_PREFAULT];
+
+	for (size_t off = 0; off < sizeof(stack); off += 4096)
+		stack[off] = 0;
+}
+
+/**
+ * Enter precision mode (-P), once every buffer of the run is allocated.
+ *
+ * The process is pinned to one CPU, its memory locked and faulted in, so
+ * that the probe loop never waits on a page fault, and it is switched to
+ * SCHED_FIFO, so that it is not preempted by ordinary tasks. Pinning is
+ * what was asked for and must succeed; locking and real-time priority
+ * need privileges, and only warn without them.
+ *
+ * The loop busy-polls its socket, so at real-time priority it takes all of
+ * its CPU but the 5% real-time throttling leaves. The CPU should be one
+ * nothing else needs: on a single-CPU host it also runs the network stack
+ * that delivers the replies, so priority is left alone there.
+ *
+ * @param cpu: CPU to run on.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int precision_enter(int cpu) {
+	struct sched_param sp = { .sched_priority = PRECISION_RT_PRIO };
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+		ft_printf("ft_ping: cannot run on CPU %d: %s\n", cpu, strerror(errno));
+		return -1;
+	}
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1)
+		ft_printf("ft_ping: warning: mlockall: %s\n", strerror(errno));
+	precision_prefault_stack();
+	if (sysconf(_SC_NPROCESSORS_ONLN) < 2)
+		ft_printf("ft_ping: warning: single CPU, not switching to SCHED_FIFO\n");
+	else if (sched_setscheduler(0, SCHED_FIFO, &sp) == -1)
+		ft_printf("ft_ping: warning: SCHED_FIFO: %s\n", strerror(errno));
+	return 0;
+}
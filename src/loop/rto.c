@@ -0,0 +1,97 @@
+#include "../../inc/loop.h"
+
+/**
+ * Bound a timeout to the -a floor and ceiling.
+ */
+static double rto_clamp(const t_rto *r, double us) {
+	if (us < r->min)
+		return r->min;
+	if (us > r->max)
+		return r->max;
+	return us;
+}
+
+/**
+ * Set up adaptive probe timeouts (-a), starting from -W until the first
+ * answer.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param opts: Pointer to the user options structure.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int rto_init(t_packinfo *pi, const t_options *opts) {
+	t_rto *r = calloc(1, sizeof(*r));
+
+	if (r == NULL) {
+		ft_printf("ft_ping: cannot allocate timeout state\n");
+		return -1;
+	}
+	r->min = opts->rto_min * 1e6;
+	r->max = opts->rto_max * 1e6;
+	r->rto = rto_clamp(r, opts->timeout * 1e6);
+	pi->rto = r;
+	return 0;
+}
+
+/**
+ * Timeout of a probe about to be sent.
+ *
+ * @param r: Adaptive timeout state.
+ * @param seq: Sequence number of the probe.
+ *
+ * Return the timeout in wheel ticks, rounded up.
+ */
+uint64_t rto_arm(t_rto *r, uint16_t seq) {
+	uint64_t ticks = (uint64_t)ceil(r->rto / WHEEL_TICK_US);
+
+	r->armed[seq] = ticks;
+	return ticks;
+}
+
+/**
+ * Account for the RTT of an answer (RFC 6298, 2.2 and 2.3).
+ *
+ * Late answers count too: ft_ping never sends a probe twice, so no RTT is
+ * ambiguous, and they are the ones that tell a timeout is too short.
+ * Duplicates must not be fed.
+ *
+ * @param r: Adaptive timeout state, or NULL without -a.
+ * @param rtt: RTT of the answer.
+ */
+void rto_on_reply(t_rto *r, const struct timeval *rtt) {
+	double us = rtt->tv_sec * 1e6 + rtt->tv_usec;
+
+	if (r == NULL)
+		return;
+	if (r->nb_samples++ == 0) {
+		r->srtt = us;
+		r->rttvar = us / 2;
+	} else {
+		r->rttvar += RTO_BETA * (fabs(r->srtt - us) - r->rttvar);
+		r->srtt += RTO_ALPHA * (us - r->srtt);
+	}
+	r->rto = rto_clamp(r, r->srtt + fmax(WHEEL_TICK_US, RTO_K * r->rttvar));
+}
+
+/**
+ * Back the timeout off after a probe timed out (RFC 6298, 5.5).
+ *
+ * @param r: Adaptive timeout state, or NULL without -a.
+ */
+void rto_on_timeout(t_rto *r) {
+	if (r == NULL)
+		return;
+	r->rto = rto_clamp(r, r->rto * 2);
+	r->nb_backoff++;
+}
+
+/**
+ * Free the adaptive timeout state.
+ *
+ * @param pi: Pointer to the packet info structure.
+ */
+void rto_clean(t_packinfo *pi) {
+	free(pi->rto);
+	pi->rto = NULL;
+}
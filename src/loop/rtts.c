@@ -3,139 +3,105 @@
 /**
  * Calculate the round-trip time (RTT) of a received ICMP packet.
  *
+ * @param pi: Pointer to the packet info structure.
  * @param icmph: Pointer to the received ICMP header.
- * @param new_rtt: Pointer to the RTT node where the result will be stored.
+ * @param t_recv: Reception time of the packet.
+ * @param rtt: Where the result will be stored.
  *
- * The function extracts the timestamp stored in the ICMP body, gets the current
- * time, and computes the delta (current - send) to obtain the RTT.
+ * The function gets the send time of the request (see icmp_echo_sent())
+ * and computes the delta (reception - send) to obtain the RTT. A clock
+ * stepped back between send and reception would give a negative delta,
+ * counted as 0.
  *
- * @return: 0 on success, -1 on failure (gettimeofday error).
+ * @return: 0 on success.
  */
-static int calc_packet_rtt(struct icmphdr *icmph, t_rtt_node *new_rtt)
+static int calc_packet_rtt(const t_packinfo *pi, struct icmphdr *icmph, const struct timeval *t_recv,
+		struct timeval *rtt)
 {
-	struct timeval *t_send;
-	struct timeval t_recv;
+	struct timeval t_send;
 
-	t_send = ((struct timeval *)skip_icmphdr(icmph));
-	if (gettimeofday(&t_recv, NULL) == -1) {
-		ft_printf("gettimeofday err: %s\n", strerror(errno));
-		return -1;
-	}
-	timersub(&t_recv, t_send, &new_rtt->val);
+	icmp_echo_sent(pi, icmph, &t_send);
+	timersub(t_recv, &t_send, rtt);
+	if (rtt->tv_sec < 0)
+		timerclear(rtt);
 	return 0;
 }
 
 /**
- * Compute RTT for the received ICMP packet and add it to the end of the RTT list.
+ * Convert a duration in microseconds to a timeval.
+ */
+static void us_to_timeval(uint64_t us, struct timeval *tv) {
+	tv->tv_sec = us / 1000000;
+	tv->tv_usec = us % 1000000;
+}
+
+/**
+ * Compute RTT for the received ICMP packet and append it to the RTT array.
+ *
+ * RTTs are kept in microseconds, 4 bytes each, in one array grown by
+ * doubling; the last one is also kept whole in pi->rtt_last.
  *
- * @param pi: Pointer to the packet info structure containing the RTT list.
+ * @param pi: Pointer to the packet info structure containing the RTT array.
  * @param icmph: Pointer to the received ICMP header.
+ * @param t_recv: Reception time of the packet.
  *
- * @return: Pointer to the newly added RTT node, or NULL on allocation/error.
+ * @return: 0 on success, -1 on allocation failure.
  */
-t_rtt_node * rtts_save_new(t_packinfo *pi, struct icmphdr *icmph) {
-	t_rtt_node *elem = pi->rtt_list;
-	t_rtt_node *new_rtt = NULL;
+int rtts_save_new(t_packinfo *pi, struct icmphdr *icmph, const struct timeval *t_recv) {
+	uint64_t us;
+
+	if (pi->nb_rtts == pi->rtts_cap) {
+		size_t cap = pi->rtts_cap ? pi->rtts_cap * 2 : RTTS_INIT_CAP;
+		uint32_t *rtts = realloc(pi->rtts, cap * sizeof(*rtts));
 
-	if ((new_rtt = malloc(sizeof(*new_rtt))) == NULL)
-		return NULL;
-	if (calc_packet_rtt(icmph, new_rtt) == -1)
-		return NULL;
-	new_rtt->next = NULL;
-	if (elem != NULL) {
-		while (elem->next)
-			elem = elem->next;
-		elem->next = new_rtt;
-	} else {
-		pi->rtt_list = new_rtt;
+		if (rtts == NULL)
+			return -1;
+		pi->rtts = rtts;
+		pi->rtts_cap = cap;
 	}
-	pi->rtt_last = new_rtt;
-	return new_rtt;
+	if (calc_packet_rtt(pi, icmph, t_recv, &pi->rtt_last) == -1)
+		return -1;
+	us = (uint64_t)pi->rtt_last.tv_sec * 1000000 + pi->rtt_last.tv_usec;
+	pi->rtts[pi->nb_rtts++] = us < UINT32_MAX ? us : UINT32_MAX;
+	return 0;
 }
 
 /**
- * Free all RTT nodes from the RTT list in the packet info structure.
+ * Free the RTT array in the packet info structure.
  *
  * @param pi: Pointer to the packet info structure.
  */
 void rtts_clean(t_packinfo *pi) {
-	t_rtt_node *elem = pi->rtt_list;
-	t_rtt_node *tmp;
-
-	while (elem) {
-		tmp = elem;
-		elem = elem->next;
-		free(tmp);
-	}
+	free(pi->rtts);
+	pi->rtts = NULL;
+	pi->nb_rtts = 0;
+	pi->rtts_cap = 0;
 }
 
 /**
- * Compute the standard deviation of RTT values stored in the packet info structure.
- *
- * @param pi: Pointer to the packet info structure with the RTT list.
- * @param nb_elem: Number of RTT values in the list.
+ * Compute RTT statistics from the array: min, max, average, and standard deviation.
  *
- * Stores result in `pi->stddev`.
- */
-void calc_stddev(t_packinfo *pi, long nb_elem) {
-	t_rtt_node *elem = pi->rtt_list;
-	struct timeval *avg = &pi->avg;
-	long sec_dev = 0;
-	long usec_dev = 0;
-	long total_sec_dev = 0;
-	long total_usec_dev = 0;
-
-	while (elem) {
-		sec_dev = elem->val.tv_sec - avg->tv_sec;
-		sec_dev *= sec_dev;
-		total_sec_dev += sec_dev;
-		usec_dev = elem->val.tv_usec - avg->tv_usec;
-		usec_dev *= usec_dev;
-		total_usec_dev += usec_dev;
-		elem = elem->next;
-	}
-	if (nb_elem - 1 > 0) {
-		total_sec_dev /= nb_elem - 1;
-		total_usec_dev /= nb_elem - 1;
-		pi->stddev.tv_sec = (long)sqrt(total_sec_dev);
-		pi->stddev.tv_usec = (long)sqrt(total_usec_dev);
-	} else {
-		pi->stddev.tv_sec = 0;
-		pi->stddev.tv_usec = 0;
-	}
-}
-
-/**
- * Compute RTT statistics from the list: min, max, average, and standard deviation.
+ * The array is scanned once, branch-free, so the compiler can vectorize
+ * it. The standard deviation comes from the running variance kept by
+ * jitter_on_reply().
  *
- * @param pi: Pointer to the packet info structure.
+ * @param pi: Pointer to the packet info structure, with at least one RTT.
  *
  * Sets pi->min, pi->max, pi->avg, and pi->stddev fields.
  */
 void rtts_calc_stats(t_packinfo *pi) {
-	t_rtt_node *elem = pi->rtt_list;
-	long nb_elem = 0;
-	long total_sec = 0;
-	long total_usec = 0;
-
-	pi->min = &elem->val;
-	pi->max = &elem->val;
-	while (elem) {
-		if (timercmp(pi->min, &elem->val, >))
-			pi->min = &elem->val;
-		else if (timercmp(pi->max, &elem->val, <))
-			pi->max = &elem->val;
+	const uint32_t *rtts = pi->rtts;
+	uint32_t min = UINT32_MAX;
+	uint32_t max = 0;
+	uint64_t sum = 0;
 
-		total_sec += elem->val.tv_sec;
-		total_usec += elem->val.tv_usec;
-		if (total_usec > 100000) {
-			total_usec -= 100000;
-			++total_sec;
-		}
-		++nb_elem;
-		elem = elem->next;
+	for (size_t i = 0; i < pi->nb_rtts; i++) {
+		min = rtts[i] < min ? rtts[i] : min;
+		max = rtts[i] > max ? rtts[i] : max;
+		sum += rtts[i];
 	}
-	pi->avg.tv_sec = total_sec / nb_elem;
-	pi->avg.tv_usec = total_usec / nb_elem;
-	calc_stddev(pi, nb_elem);
-}
\ No newline at end of file
+	us_to_timeval(min, &pi->min);
+	us_to_timeval(max, &pi->max);
+	us_to_timeval(sum / pi->nb_rtts, &pi->avg);
+	us_to_timeval(llround(jitter_stddev(&pi->jitter)), &pi->stddev);
+}
@@ -0,0 +1,218 @@
+#include "../../inc/loop.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Start an update of the segment: readers that overlap it will retry.
+ */
+static inline void shm_begin(t_shm_stats *m) {
+	__atomic_store_n(&m->seq, m->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * Publish an update of the segment.
+ */
+static inline void shm_end(t_shm_stats *m) {
+	__atomic_store_n(&m->seq, m->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Get the slot of the current second, recycling it if it is stale, and
+ * stamp the update time. Must be called between shm_begin() and shm_end().
+ *
+ * Readers sample the segment on their own clock: slots are wall clock
+ * seconds.
+ *
+ * @param s: Live statistics.
+ *
+ * Return pointer to the current slot.
+ */
+static t_shm_slot *shm_slot(t_shmstats *s) {
+	t_shm_stats *m = s->map;
+	struct timeval now;
+	t_shm_slot *slot;
+
+	clock_wall(s->clock, &s->clock->now, &now);
+	m->update_usec = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+	slot = &m->ring[now.tv_sec % SHM_RING_SIZE];
+	if (slot->sec != now.tv_sec) {
+		ft_memset(slot, 0, sizeof(*slot));
+		slot->sec = now.tv_sec;
+	}
+	return slot;
+}
+
+/**
+ * Create the live statistics segment /dev/shm/<name>.
+ *
+ * The segment is world-readable so that unprivileged readers can sample a
+ * root ft_ping. An existing segment of the same name is taken over.
+ *
+ * @param pi: Pointer to the packet info structure receiving the segment.
+ * @param name: Segment name, with or without its leading slash.
+ * @param target: Address of the target, in network order.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int shmstats_init(t_packinfo *pi, const char *name, uint32_t target) {
+	t_shmstats *s;
+	int fd;
+
+	if (name[0] == '/')
+		name++;
+	if (!name[0] || ft_strchr(name, '/') || ft_strlen(name) + 2 > SHM_NAME_MAX) {
+		ft_printf("ft_ping: invalid shared memory name '%s'\n", name);
+		return -1;
+	}
+	if ((s = calloc(1, sizeof(*s))) == NULL) {
+		ft_printf("ft_ping: cannot allocate live statistics\n");
+		return -1;
+	}
+	s->clock = &pi->clock;
+	s->name[0] = '/';
+	memcpy(s->name + 1, name, ft_strlen(name) + 1);
+	if ((fd = shm_open(s->name, O_RDWR | O_CREAT, 0644)) == -1) {
+		ft_printf("ft_ping: shm_open %s: %s\n", s->name, strerror(errno));
+		free(s);
+		return -1;
+	}
+	fchmod(fd, 0644);
+	if (ftruncate(fd, sizeof(t_shm_stats)) == -1
+		|| (s->map = mmap(NULL, sizeof(t_shm_stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		ft_printf("ft_ping: %s: %s\n", s->name, strerror(errno));
+		close(fd);
+		shm_unlink(s->name);
+		free(s);
+		return -1;
+	}
+	close(fd);
+
+	shm_begin(s->map);
+	ft_memset(&s->map->pid, 0, sizeof(t_shm_stats) - offsetof(t_shm_stats, pid));
+	memcpy(s->map->magic, SHM_MAGIC, sizeof(s->map->magic));
+	s->map->version = SHM_VERSION;
+	s->map->size = sizeof(t_shm_stats);
+	s->map->pid = getpid();
+	s->map->target = target;
+	s->map->state = SHM_RUNNING;
+	s->map->rtt_min = UINT64_MAX;
+	shm_slot(s);
+	s->map->start_sec = s->map->update_usec / 1000000;
+	shm_end(s->map);
+	pi->shm = s;
+	return 0;
+}
+
+/**
+ * Account for a sent probe.
+ *
+ * @param s: Live statistics, may be NULL.
+ */
+void shmstats_on_send(t_shmstats *s) {
+	if (!s)
+		return;
+	shm_begin(s->map);
+	shm_slot(s)->nb_send++;
+	s->map->nb_send++;
+	shm_end(s->map);
+}
+
+/**
+ * Account for a received reply.
+ *
+ * A late reply, to a probe that already timed out, takes that probe out
+ * of the total timeouts; the slot of the second the timeout fired in
+ * keeps it, and the current slot counts the reply as late.
+ *
+ * @param s: Live statistics, may be NULL.
+ * @param rtt: Round-trip time of the reply.
+ * @param late: Whether the probe had already timed out.
+ */
+void shmstats_on_reply(t_shmstats *s, const struct timeval *rtt, _Bool late) {
+	uint64_t usec;
+	t_shm_slot *slot;
+	t_shm_stats *m;
+	int bin;
+
+	if (!s)
+		return;
+	m = s->map;
+	usec = rtt->tv_sec * 1000000 + rtt->tv_usec;
+	bin = shm_hist_bin(usec);
+
+	shm_begin(m);
+	slot = shm_slot(s);
+	if (slot->nb_recv == 0 || usec < slot->rtt_min)
+		slot->rtt_min = usec;
+	if (usec > slot->rtt_max)
+		slot->rtt_max = usec;
+	slot->rtt_sum += usec;
+	slot->hist[bin]++;
+	slot->nb_recv++;
+	if (late) {
+		slot->nb_late++;
+		if (m->nb_timeout)
+			m->nb_timeout--;
+	}
+	m->rtt_last = usec;
+	m->rtt_min = usec < m->rtt_min ? usec : m->rtt_min;
+	m->rtt_max = usec > m->rtt_max ? usec : m->rtt_max;
+	m->rtt_sum += usec;
+	m->rtt_sq_sum += (double)usec * usec;
+	m->hist[bin]++;
+	m->nb_recv++;
+	shm_end(m);
+}
+
+/**
+ * Account for a duplicate reply.
+ *
+ * @param s: Live statistics, may be NULL.
+ */
+void shmstats_on_dup(t_shmstats *s) {
+	if (!s)
+		return;
+	shm_begin(s->map);
+	shm_slot(s);
+	s->map->nb_dup++;
+	shm_end(s->map);
+}
+
+/**
+ * Account for a probe that timed out.
+ *
+ * @param s: Live statistics, may be NULL.
+ */
+void shmstats_on_timeout(t_shmstats *s) {
+	if (!s)
+		return;
+	shm_begin(s->map);
+	shm_slot(s)->nb_timeout++;
+	s->map->nb_timeout++;
+	shm_end(s->map);
+}
+
+/**
+ * Mark the segment stopped and remove it.
+ *
+ * Readers that still have it mapped keep the final statistics.
+ *
+ * @param pi: Pointer to the packet info structure.
+ */
+void shmstats_clean(t_packinfo *pi) {
+	t_shmstats *s = pi->shm;
+
+	if (!s)
+		return;
+	shm_begin(s->map);
+	s->map->state = SHM_STOPPED;
+	shm_end(s->map);
+	munmap(s->map, sizeof(t_shm_stats));
+	shm_unlink(s->name);
+	free(s);
+	pi->shm = NULL;
+}
@@ -0,0 +1,211 @@
+#include "../../inc/loop.h"
+
+#include <time.h>
+
+/**
+ * Read the next packet from the raw socket without blocking.
+ *
+ * Packets larger than the buffer are truncated, but their full length is
+ * returned (MSG_TRUNC) so replies to large probes are sized correctly.
+ * The socket has no timestamp of its own: ts is left cleared, and the
+ * caller stamps the whole batch with one loop clock read. The count of
+ * packets the socket dropped so far, for lack of buffer space, comes with
+ * the first packet queued after a drop (SO_RXQ_OVFL); it is kept in
+ * src->drops.
+ *
+ * @param src: Socket packet source.
+ * @param buf: Buffer receiving the packet, starting at the IP header.
+ * @param size: Size of the buffer.
+ * @param ts: Reception time of the packet, left untouched.
+ *
+ * Return the length of the packet, 0 if no packet is pending, -1 on error.
+ */
+static ssize_t socket_next(t_source *src, uint8_t *buf, size_t size, struct timeval *ts) {
+	struct iovec iov[1] = {
+		[0] = { .iov_base = buf, .iov_len = size }
+	};
+	uint8_t cbuf[CMSG_SPACE(sizeof(uint32_t))];
+	struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 1,
+		.msg_control = cbuf, .msg_controllen = sizeof(cbuf) };
+	struct cmsghdr *cmsg;
+	ssize_t nb_bytes;
+
+	nb_bytes = recvmsg(src->fd, &msg, MSG_DONTWAIT | MSG_TRUNC);
+	if (errno != EAGAIN && errno != EWOULDBLOCK && nb_bytes == -1) {
+		ft_printf("recvmsg err: %s\n", strerror(errno));
+		return -1;
+	} else if (nb_bytes == -1) {
+		return 0;
+	}
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+			memcpy(&src->drops, CMSG_DATA(cmsg), sizeof(src->drops));
+	(void)ts;
+	return nb_bytes;
+}
+
+/**
+ * Send an ICMP packet through the raw socket.
+ *
+ * A non-zero TTL is passed as an IP_TTL control message and applies to
+ * this packet only; otherwise the socket default (-t) is used.
+ *
+ * @param src: Socket packet source.
+ * @param buf: ICMP packet, header included.
+ * @param len: Length of the packet.
+ * @param dst: Destination address.
+ * @param ttl: Time to live of this packet, 0 for the socket default.
+ *
+ * Return the number of bytes sent, -1 on error with errno set.
+ */
+static ssize_t socket_send(t_source *src, const uint8_t *buf, size_t len,
+		const struct sockaddr_in *dst, uint8_t ttl) {
+	uint8_t cbuf[CMSG_SPACE(sizeof(int))] = {};
+	struct iovec iov = { .iov_base = (void *)buf, .iov_len = len };
+	struct msghdr msg = {
+		.msg_name = (void *)dst,
+		.msg_namelen = sizeof(*dst),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	struct cmsghdr *cmsg;
+	int val = ttl;
+
+	if (ttl == 0)
+		return sendto(src->fd, buf, len, 0, (const struct sockaddr *)dst, sizeof(*dst));
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = IPPROTO_IP;
+	cmsg->cmsg_type = IP_TTL;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &val, sizeof(val));
+	return sendmsg(src->fd, &msg, 0);
+}
+
+/**
+ * Close the raw socket.
+ *
+ * @param src: Socket packet source.
+ */
+static void socket_close(t_source *src) {
+	close(src->fd);
+}
+
+/**
+ * Make a packet source reading from and sending through the live raw socket.
+ *
+ * @param src: Packet source to initialize.
+ * @param sock_fd: RAW socket file descriptor, closed with the source.
+ */
+void source_open_socket(t_source *src, int sock_fd) {
+	ft_memset(src, 0, sizeof(*src));
+	src->fd = sock_fd;
+	src->next = socket_next;
+	src->send = socket_send;
+	src->close = socket_close;
+}
+
+/**
+ * Account for one of our own echo requests found in a capture.
+ *
+ * The echo identifier of the session is learned from the first request to
+ * the target, so a capture of any ft_ping or ping run can be replayed.
+ *
+ * @param buf: Packet, starting at the IP header.
+ * @param nb_bytes: Length of the packet.
+ * @param ts: Capture time of the packet.
+ * @param pi: Packet info tracker.
+ * @param si: Pointer to remote socket info.
+ * @param learned: Whether the session identifier is already known.
+ *
+ * Return 1 if the packet was one of our requests, 0 otherwise.
+ */
+static int replay_request(uint8_t *buf, ssize_t nb_bytes, const struct timeval *ts,
+		t_packinfo *pi, const t_sockinfo *si, _Bool *learned) {
+	struct iphdr *ip = (struct iphdr *)buf;
+	struct icmphdr *icmph = (struct icmphdr *)(buf + ip->ihl * 4);
+
+	if ((size_t)nb_bytes < ip->ihl * 4U + ICMP_HDR_SIZE || icmph->type != ICMP_ECHO
+		|| ip->daddr != si->remote_addr.sin_addr.s_addr)
+		return 0;
+	if (!*learned) {
+		pi->ident = icmph->un.echo.id;
+		*learned = 1;
+	}
+	if (icmph->un.echo.id != pi->ident)
+		return 0;
+	if (pi->nb_send == 0)
+		pi->start_time = *ts;
+	pi->replay_sent[icmph->un.echo.sequence] = *ts;
+	lossmap_on_send(pi, icmph->un.echo.sequence, ts);
+	pi->seq_seen[icmph->un.echo.sequence >> 3] &= ~(1 << (icmph->un.echo.sequence & 7));
+	pi->nb_send++;
+	return 1;
+}
+
+/**
+ * Feed a whole capture through the receive and statistics path.
+ *
+ * Requests to the target count as sent probes, every other packet goes
+ * through icmp_process_packet() exactly like a live one, stamped with its
+ * capture time instead of the wall clock. Replies are timed against the
+ * capture time of their request, kept per sequence number: the send time
+ * they echo is on the clock of the captured run.
+ *
+ * @param src: Capture packet source.
+ * @param pi: Packet info tracker.
+ * @param opts: Program options.
+ * @param si: Pointer to remote socket info.
+ *
+ * Return 0 on success, -1 on error.
+ */
+int source_replay(t_source *src, t_packinfo *pi, const t_options *opts, const t_sockinfo *si) {
+	uint8_t buf[RECV_PACK_SIZE];
+	struct timespec start;
+	struct timespec end;
+	struct timeval ts = {};
+	_Bool learned = 0;
+	ssize_t nb_bytes;
+	int ret = -1;
+
+	if ((pi->replay_sent = calloc(UINT16_MAX + 1, sizeof(*pi->replay_sent))) == NULL) {
+		ft_printf("ft_ping: cannot allocate replay state\n");
+		return -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (pingloop) {
+		ft_memset(buf, 0, sizeof(buf));
+		nb_bytes = src->next(src, buf, sizeof(buf), &ts);
+		if (nb_bytes == -1)
+			goto out;
+		if (src->eof)
+			break;
+		if (replay_request(buf, nb_bytes, &ts, pi, si, &learned))
+			continue;
+		if (!learned) {
+			struct icmphdr *icmph = (struct icmphdr *)(buf + ((struct iphdr *)buf)->ihl * 4);
+
+			if (icmph->type != ICMP_ECHOREPLY || ((struct iphdr *)buf)->saddr != si->remote_addr.sin_addr.s_addr)
+				continue;
+			pi->ident = icmph->un.echo.id;
+			learned = 1;
+		}
+		if (icmp_process_packet(buf, nb_bytes, &ts, pi, opts, si) == -1)
+			goto out;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	pi->end_time = ts;
+
+	if (opts->verb) {
+		double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+
+		printf("replayed %zu packets in %.3f ms (%.0f packets/s)\n", src->nb_packets, ms,
+			ms > 0.0 ? src->nb_packets * 1e3 / ms : 0.0);
+	}
+	ret = 0;
+out:
+	free(pi->replay_sent);
+	pi->replay_sent = NULL;
+	return ret;
+}
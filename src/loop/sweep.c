@@ -0,0 +1,189 @@
+#include "../../inc/loop.h"
+
+/* Bytes of every column of a hop, widest first so each stays aligned. */
+#define HOP_SIZE (sizeof(uint64_t) + 6 * sizeof(uint32_t) + sizeof(struct in_addr) + sizeof(uint8_t))
+
+/**
+ * Allocate the per-hop table used by the TTL sweep mode: the t_hops
+ * header followed by its columns, in one block.
+ *
+ * @param pi: Pointer to the packet info structure.
+ * @param max_hops: Highest TTL probed by each round.
+ *
+ * Return 0 on success, -1 on allocation failure.
+ */
+int sweep_init(t_packinfo *pi, uint8_t max_hops) {
+	t_hops *h = calloc(1, sizeof(*h) + max_hops * HOP_SIZE);
+	uint8_t *col = (uint8_t *)(h + 1);
+
+	if (h == NULL) {
+		ft_printf("ft_ping: cannot allocate hop table\n");
+		return -1;
+	}
+	h->total_us = (uint64_t *)col;
+	col += max_hops * sizeof(uint64_t);
+	h->history = (uint32_t *)col;
+	h->nb_send = h->history + max_hops;
+	h->nb_recv = h->nb_send + max_hops;
+	h->last_us = h->nb_recv + max_hops;
+	h->best_us = h->last_us + max_hops;
+	h->worst_us = h->best_us + max_hops;
+	h->addr = (struct in_addr *)(h->worst_us + max_hops);
+	h->pending = (uint8_t *)(h->addr + max_hops);
+	pi->hops = h;
+	pi->nb_hops = max_hops;
+	pi->path_len = 0;
+	return 0;
+}
+
+/**
+ * Give up on the probes of the current round still waiting for an answer.
+ *
+ * Their deadline timers are fired early, so each of them is accounted
+ * for as a timeout exactly once.
+ *
+ * @param pi: Pointer to packet tracking info.
+ */
+void sweep_check_timeouts(t_packinfo *pi) {
+	uint8_t *pending = pi->hops->pending;
+
+	for (int i = 0; i < pi->nb_hops; i++) {
+		if (!pending[i])
+			continue;
+		pending[i] = 0;
+		if (pi->probe_timers)
+			wheel_fire(&pi->probe_timers[(uint16_t)(pi->round_seq + i)], pi);
+	}
+}
+
+/**
+ * Mark the hop of a timed out probe as no longer waiting.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param seq: Sequence number of the probe.
+ */
+void sweep_expired(t_packinfo *pi, uint16_t seq) {
+	uint16_t idx = seq - pi->round_seq;
+
+	if (idx < pi->nb_hops)
+		pi->hops->pending[idx] = 0;
+}
+
+/**
+ * Send one probe per TTL, all at once.
+ *
+ * Every probe of a round gets the sequence number `round_seq + ttl - 1`, so a
+ * reply or a quoted time-exceeded header maps straight back to its hop.
+ * Once the destination has answered, TTLs beyond it are no longer probed.
+ *
+ * @param src: Packet source the probes go out through.
+ * @param si: Pointer to remote socket info.
+ * @param pi: Pointer to packet tracking info.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int sweep_send_round(t_source *src, const t_sockinfo *si, t_packinfo *pi) {
+	int last = pi->path_len ? pi->path_len : pi->nb_hops;
+	uint64_t start = cycles_now();
+	t_hops *h = pi->hops;
+
+	if (pi->nb_send == 0)
+		pi->start_time = pi->clock.now;
+	sweep_check_timeouts(pi);
+	pi->round_seq = (uint16_t)(pi->nb_send * pi->nb_hops);
+	h->round_time = pi->clock.now;
+	for (int i = 0; i < last; i++) {
+		pi->ctr.nb_send_calls++;
+		if (icmp_send_ttl_probe(src, si, i + 1, pi->ident, pi->round_seq + i, &pi->clock.now) == -1)
+			return -1;
+		PROBE2(send, (uint16_t)(pi->round_seq + i), pi->ident);
+		icmp_arm_probe(pi, pi->round_seq + i);
+		pi->ctr.bytes_sent += ICMP_HDR_SIZE + ICMP_BODY_SIZE;
+		h->history[i] <<= 1;
+		h->nb_send[i]++;
+		h->pending[i] = 1;
+	}
+	pi->ctr.cycles_send += cycles_now() - start;
+	pi->nb_send++;
+	return 0;
+}
+
+/**
+ * Check that a classified packet answers a probe sent to the target.
+ *
+ * Echo replies must come from the target; time exceeded errors must quote
+ * a probe addressed to it. Other errors are not sweep answers.
+ *
+ * @param pkt: Classified packet.
+ * @param si: Pointer to remote socket info.
+ *
+ * Return 1 if the packet answers one of our probes, 0 otherwise.
+ */
+static _Bool sweep_is_answer(const t_pkt *pkt, const t_sockinfo *si) {
+	const struct iphdr *ip = (const struct iphdr *)pkt->buf;
+	const struct iphdr *inner = (const struct iphdr *)(pkt->buf + pkt->quote_off);
+
+	if (pkt->cls == PKT_REPLY)
+		return ip->saddr == si->remote_addr.sin_addr.s_addr;
+	return pkt->cls == PKT_ERROR && pkt->buf[pkt->icmp_off] == ICMP_TIME_EXCEEDED
+		&& inner->daddr == si->remote_addr.sin_addr.s_addr;
+}
+
+/**
+ * Account for a reply to the current sweep round.
+ *
+ * @param pi: Pointer to packet tracking info.
+ * @param pkt: Received packet, classified.
+ * @param si: Pointer to remote socket info.
+ *
+ * Return 1 if the packet answered a pending probe, 0 otherwise.
+ */
+int sweep_recv(t_packinfo *pi, const t_pkt *pkt, const t_sockinfo *si) {
+	struct iphdr *ip = (struct iphdr *)pkt->buf;
+	t_hops *h = pi->hops;
+	struct timeval rtt;
+	uint32_t us;
+	uint16_t idx;
+
+	if (!sweep_is_answer(pkt, si))
+		return 0;
+	idx = (uint16_t)(pkt->seq - pi->round_seq);
+	if (idx >= pi->nb_hops || !h->pending[idx])
+		return 0;
+
+	icmp_disarm_probe(pi, pkt->seq);
+	timersub(&pkt->ts, &h->round_time, &rtt);
+	if (rtt.tv_sec < 0)
+		timerclear(&rtt);
+	us = rtt.tv_sec < UINT32_MAX / 1000000 ? rtt.tv_sec * 1000000 + rtt.tv_usec : UINT32_MAX;
+	h->pending[idx] = 0;
+	h->addr[idx].s_addr = ip->saddr;
+	h->history[idx] |= 1;
+	h->last_us[idx] = us;
+	h->total_us[idx] += us;
+	if (h->nb_recv[idx] == 0 || us < h->best_us[idx])
+		h->best_us[idx] = us;
+	if (h->nb_recv[idx] == 0 || us > h->worst_us[idx])
+		h->worst_us[idx] = us;
+	h->nb_recv[idx]++;
+	binlog_append(pi->binlog, ip->saddr, pkt->seq, ip->ttl, BINLOG_REPLY, &h->round_time, &rtt);
+	PROBE2(recv, pkt->seq, us);
+
+	if (pkt->cls == PKT_REPLY) {
+		if (pi->path_len == 0 || idx + 1 < pi->path_len)
+			pi->path_len = idx + 1;
+		pi->nb_ok = h->nb_recv[pi->path_len - 1];
+	}
+	return 1;
+}
+
+/**
+ * Free the per-hop table.
+ *
+ * @param pi: Pointer to the packet info structure.
+ */
+void sweep_clean(t_packinfo *pi) {
+	free(pi->hops);
+	pi->hops = NULL;
+	pi->nb_hops = 0;
+}
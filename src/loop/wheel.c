@@ -0,0 +1,240 @@
+#include "../../inc/loop.h"
+
+#define ROOT_SIZE (1 << WHEEL_ROOT_BITS)
+#define ROOT_MASK (ROOT_SIZE - 1)
+#define LEVEL_SIZE (1 << WHEEL_LEVEL_BITS)
+#define LEVEL_MASK (LEVEL_SIZE - 1)
+#define LEVEL_SHIFT(l) (WHEEL_ROOT_BITS + (l) * WHEEL_LEVEL_BITS)
+#define WHEEL_SPAN ((1ULL << LEVEL_SHIFT(WHEEL_LEVELS)) - 1)
+
+/**
+ * Time of the last loop clock read, in wheel ticks.
+ *
+ * @param c: Loop clock.
+ */
+uint64_t wheel_clock(const t_clock *c) {
+	return c->ns / (WHEEL_TICK_US * 1000);
+}
+
+/**
+ * Make a slot an empty circular list.
+ *
+ * @param head: Slot head.
+ */
+static void slot_init(t_timer *head) {
+	head->next = head;
+	head->prev = head;
+}
+
+/**
+ * Link a timer at the tail of a slot.
+ *
+ * @param head: Slot head.
+ * @param t: Timer to link.
+ */
+static void slot_push(t_timer *head, t_timer *t) {
+	t->prev = head->prev;
+	t->next = head;
+	head->prev->next = t;
+	head->prev = t;
+}
+
+/**
+ * Initialize an empty timer wheel.
+ *
+ * @param w: Wheel to initialize.
+ * @param now: Current time, in ticks.
+ */
+void wheel_init(t_wheel *w, uint64_t now) {
+	w->now = now;
+	for (int i = 0; i < ROOT_SIZE; i++)
+		slot_init(&w->root[i]);
+	for (int l = 0; l < WHEEL_LEVELS; l++)
+		for (int i = 0; i < LEVEL_SIZE; i++)
+			slot_init(&w->levels[l][i]);
+}
+
+/**
+ * File a timer in the slot matching its distance from now.
+ *
+ * Timers due within ROOT_SIZE ticks go to the root level, one slot per
+ * tick; each further level covers LEVEL_SIZE times the range of the one
+ * below. Timers beyond the wheel span park in the last level and are
+ * refiled when they come around.
+ *
+ * @param w: Timer wheel.
+ * @param t: Timer to file.
+ */
+static void wheel_file(t_wheel *w, t_timer *t) {
+	int64_t delta = (int64_t)(t->expires - w->now);
+	uint64_t expires = t->expires;
+
+	if (delta < ROOT_SIZE) {
+		if (delta < 0)
+			expires = w->now;
+		slot_push(&w->root[expires & ROOT_MASK], t);
+		return;
+	}
+	if ((uint64_t)delta > WHEEL_SPAN)
+		expires = w->now + WHEEL_SPAN;
+	for (int l = 0; l < WHEEL_LEVELS; l++) {
+		if ((uint64_t)delta < (1ULL << LEVEL_SHIFT(l + 1)) || l == WHEEL_LEVELS - 1) {
+			slot_push(&w->levels[l][(expires >> LEVEL_SHIFT(l)) & LEVEL_MASK], t);
+			return;
+		}
+	}
+}
+
+/**
+ * Arm a timer, or move it if it is already armed. O(1).
+ *
+ * @param w: Timer wheel.
+ * @param t: Timer, with its callback and id set.
+ * @param expires: Expiry time, in ticks.
+ */
+void wheel_add(t_wheel *w, t_timer *t, uint64_t expires) {
+	wheel_cancel(t);
+	t->expires = expires;
+	wheel_file(w, t);
+}
+
+/**
+ * Disarm a timer. O(1), and a no-op on a timer that is not armed.
+ *
+ * @param t: Timer to disarm.
+ *
+ * Return 1 if the timer was armed, 0 otherwise.
+ */
+_Bool wheel_cancel(t_timer *t) {
+	if (t->next == NULL)
+		return 0;
+	t->prev->next = t->next;
+	t->next->prev = t->prev;
+	t->next = NULL;
+	t->prev = NULL;
+	return 1;
+}
+
+/**
+ * Disarm a timer and run its callback right away.
+ *
+ * @param t: Timer to fire; nothing happens if it is not armed.
+ * @param ctx: Passed to the callback.
+ */
+void wheel_fire(t_timer *t, void *ctx) {
+	if (wheel_cancel(t))
+		t->fn(t, ctx);
+}
+
+/**
+ * Fire every timer still armed, whatever its expiry time.
+ *
+ * @param w: Timer wheel.
+ * @param ctx: Passed to every callback.
+ */
+void wheel_flush(t_wheel *w, void *ctx) {
+	for (int i = 0; i < ROOT_SIZE; i++)
+		while (w->root[i].next != &w->root[i])
+			wheel_fire(w->root[i].next, ctx);
+	for (int l = 0; l < WHEEL_LEVELS; l++)
+		for (int i = 0; i < LEVEL_SIZE; i++)
+			while (w->levels[l][i].next != &w->levels[l][i])
+				wheel_fire(w->levels[l][i].next, ctx);
+}
+
+/**
+ * Earliest tick at which wheel_advance() may have something to do.
+ *
+ * That is the first non-empty root slot, or the first cascade of a
+ * non-empty upper level slot, whichever comes first: time can be skipped
+ * forward to it without missing an expiry, which is what the simulator
+ * does.
+ *
+ * @param w: Timer wheel.
+ *
+ * Return the tick, or UINT64_MAX if no timer is armed.
+ */
+uint64_t wheel_next_expiry(const t_wheel *w) {
+	uint64_t next = UINT64_MAX;
+
+	for (int l = 0; l < WHEEL_LEVELS; l++) {
+		uint64_t span = 1ULL << LEVEL_SHIFT(l);
+		uint64_t base = (w->now + span - 1) & ~(span - 1);
+		uint64_t cur = (base >> LEVEL_SHIFT(l)) & LEVEL_MASK;
+
+		for (uint64_t i = 0; i < LEVEL_SIZE; i++) {
+			uint64_t tick = base + (((i - cur) & LEVEL_MASK) << LEVEL_SHIFT(l));
+
+			if (tick < next && w->levels[l][i].next != &w->levels[l][i])
+				next = tick;
+		}
+	}
+	for (uint64_t tick = w->now; tick < w->now + ROOT_SIZE && tick < next; tick++)
+		if (w->root[tick & ROOT_MASK].next != &w->root[tick & ROOT_MASK])
+			return tick;
+	return next;
+}
+
+/**
+ * Refile every timer of an upper level slot one level down.
+ *
+ * @param w: Timer wheel.
+ * @param level: Upper level to cascade from.
+ * @param idx: Slot index in that level.
+ *
+ * Return the slot index, so the caller knows whether the next level wraps too.
+ */
+static int wheel_cascade(t_wheel *w, int level, int idx) {
+	t_timer *head = &w->levels[level][idx];
+	t_timer *t = head->next;
+	t_timer *next;
+
+	slot_init(head);
+	while (t != head) {
+		next = t->next;
+		wheel_file(w, t);
+		t = next;
+	}
+	return idx;
+}
+
+/**
+ * Fire every timer due up to `now`.
+ *
+ * Each tick expires one root slot; every ROOT_SIZE ticks the next slot of
+ * the first level is cascaded down, and so on up the levels. Callbacks may
+ * re-arm their own timer or any other.
+ *
+ * @param w: Timer wheel.
+ * @param now: Current time, in ticks.
+ * @param ctx: Passed to every callback.
+ */
+void wheel_advance(t_wheel *w, uint64_t now, void *ctx) {
+	t_timer expired;
+	t_timer *t;
+	int idx;
+
+	while (w->now <= now) {
+		idx = w->now & ROOT_MASK;
+		for (int l = 0; idx == 0 && l < WHEEL_LEVELS; l++)
+			idx = wheel_cascade(w, l, (w->now >> LEVEL_SHIFT(l)) & LEVEL_MASK);
+		idx = w->now & ROOT_MASK;
+
+		slot_init(&expired);
+		if (w->root[idx].next != &w->root[idx]) {
+			expired.next = w->root[idx].next;
+			expired.prev = w->root[idx].prev;
+			expired.next->prev = &expired;
+			expired.prev->next = &expired;
+			slot_init(&w->root[idx]);
+		}
+		w->now++;
+		while ((t = expired.next) != &expired) {
+			wheel_cancel(t);
+			if (t->expires >= w->now)
+				wheel_file(w, t);
+			else
+				t->fn(t, ctx);
+		}
+	}
+}
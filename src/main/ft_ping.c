@@ -1,118 +1,189 @@
 #include "../../inc/ft_ping.h"
 
-_Bool pingloop = 1;
-_Bool send_packet = 1;
-t_packinfo *g_pi = NULL;
-
 /**
- * Signal handler for SIGINT and SIGALRM.
+ * Replay a capture file through the receive and statistics path.
+ *
+ * No socket is opened and no root rights are needed: echo requests and
+ * replies to `host` found in the capture are processed as if they had just
+ * been sent and received, with their capture timestamps.
  *
- * Handles program termination and scheduled packet sending.
+ * @param opts: Pointer to the user options structure.
+ * @param host: Target host whose exchanges are replayed.
  *
- * @param signum: The signal number received. Expected: SIGINT or SIGALRM.
+ * @return: Exit code of the program.
  */
-void    handler(int signum) {
-    if (signum == SIGINT) {
-        gettimeofday(&g_pi->end_time, NULL);
-        pingloop = 0;
+static int replay_capture(t_options *opts, char *host) {
+    t_sockinfo si = {};
+    t_packinfo pi = {};
+    t_source src;
+    int ret;
+
+    if (init_addr(&si, host) == -1)
+        return E_EXIT_ERR_HOST;
+    if (source_open_pcap(&src, opts->replay_path) == -1)
+        return E_EXIT_ERR_ARGS;
+    pi.clock.realtime = 1;
+    if (lossmap_init(&pi) == -1) {
+        src.close(&src);
+        return E_EXIT_ERR_HOST;
     }
-    else if (signum == SIGALRM)
-        send_packet = 1;
+    signal(SIGINT, &handler);
+    g_pi = &pi;
+
+    print_start_info(&si, opts, 0);
+    ret = source_replay(&src, &pi, opts, &si);
+    if (ret == 0)
+        print_end_info(&si, &pi);
+    src.close(&src);
+    rtts_clean(&pi);
+    lossmap_clean(&pi);
+    return ret == 0 && pi.nb_ok > 0 ? E_EXIT_OK : E_EXIT_ERR_HOST;
 }
 
 /**
- * Determines whether the ping loop should stop.
+ * Receive buffer for the replies of a run, from its probe rate and size.
  *
- * Used to control the main loop termination when a packet count is specified.
- *
- * @param pi: Pointer to the packet information structure.
  * @param opts: Pointer to the user options structure.
  *
- * @return: true if the sending count is reached and either:
- * - All expected replies have been received, or
- * - One second has passed since the last packet was sent.
- * - False otherwise
+ * @return: Size of the buffer, in bytes.
  */
-_Bool    should_stop(t_packinfo *pi, t_options *opts) {
-    if (opts->count != -1) {
-        if (pi->nb_send >= opts->count) {
-            struct timeval current_time;
-            gettimeofday(&current_time, NULL);
+static int run_rcvbuf(const t_options *opts) {
+    int body = opts->size == -1 ? ICMP_BODY_SIZE : opts->size;
+    double rate = opts->adaptive ? AIMD_MAX_RATE : 1.0 / opts->interval;
 
-            if (pi->nb_recv >= opts->count ||
-                (pi->last_send_time.tv_sec + 1 < current_time.tv_sec ||
-                (pi->last_send_time.tv_sec + 1 == current_time.tv_sec &&
-                 pi->last_send_time.tv_usec <= current_time.tv_usec))) {
-                return 1;
-                 }
-        }
-    }
-    return 0;
+    /* A round of maximal probes echoed back must not overflow the socket. */
+    if (opts->pmtu)
+        return PMTU_PROBES * 4 * IP_MAXPACKET;
+    if (opts->max_hops)
+        rate *= opts->max_hops;
+    return rcvbuf_size(rate, IP_HDR_SIZE + ICMP_HDR_SIZE + body);
 }
 
 /**
- * Arm a one-shot real-time interval timer to schedule the next ping.
+ * Open the packet source probes go through.
  *
- * Sets the ITIMER_REAL timer with the given interval (in seconds).
- * The timer is non-repeating (one-shot), used to trigger SIGALRM.
+ * With FT_PING_SOCKET set, probes go through the daemon listening there
+ * and no root rights are needed; otherwise through a raw socket of our own.
+ *
+ * @param src: Packet source to open.
+ * @param si: Pointer to the remote socket info to fill.
+ * @param host: Target host.
+ * @param opts: Pointer to the user options structure.
+ * @param ident: Echo identifier; the daemon may assign another one.
  *
- * @param interval The delay in seconds before the timer expires (can be fractional).
+ * @return: 0 on success, or the exit code of the program.
  */
-static void set_ping_timer(float interval) {
-    struct itimerval timer;
-    timer.it_value.tv_sec = (int)interval;
-    timer.it_value.tv_usec = (int)((interval - (int)interval) * 1e6);
-    timer.it_interval.tv_sec = 0;
-    timer.it_interval.tv_usec = 0;
-    setitimer(ITIMER_REAL, &timer, NULL);
+static int open_source(t_source *src, t_sockinfo *si, char *host, const t_options *opts, uint16_t *ident) {
+    const char *path = getenv(DAEMON_SOCKET_ENV);
+    int sock_fd;
+
+    if (path) {
+        if (opts->pmtu) {
+            ft_printf("ft_ping: -M cannot be used through the daemon\n");
+            return E_EXIT_ERR_ARGS;
+        }
+        if (opts->interval < 1.0 / DAEMON_RATE) {
+            ft_printf("ft_ping: the daemon sends %d probes per second at most, -i is too short\n", DAEMON_RATE);
+            return E_EXIT_ERR_ARGS;
+        }
+        if (init_addr(si, host) == -1 || source_open_daemon(src, path, ident, opts->ttl) == -1)
+            return E_EXIT_ERR_HOST;
+        return 0;
+    }
+    if (check_rights() == -1)
+        return E_EXIT_ERR_ARGS;
+    if (init_sock(&sock_fd, si, host, opts->ttl, opts->pmtu, opts->precision, run_rcvbuf(opts)) == -1)
+        return E_EXIT_ERR_HOST;
+    source_open_socket(src, sock_fd);
+    return 0;
 }
 
 int main(int argc, char **argv) {
     int ret;
-    int sock_fd;
+    t_source src;
+    t_wheel wheel;
     char *host = NULL;
-    t_options opts = { .count = -1, .interval = 1.0f, .ttl = 64, };
+    t_options opts = { .count = -1, .interval = 1.0f, .timeout = 1.0f, .ttl = 64, .size = -1, };
     t_sockinfo si = {};
     t_packinfo pi = {
         .last_send_time = {0, 0},
     };
 
-    if (check_rights() == -1)
-        return E_EXIT_ERR_ARGS;
     if ((ret = parse_args(argc, argv, &host, &opts)) != 0)
         return ret == -1 ? E_EXIT_ERR_ARGS : E_EXIT_OK;
-    if (init_sock(&sock_fd, &si, host, opts.ttl) == -1)
-        return E_EXIT_ERR_HOST;
+    if (opts.replay_path)
+        return replay_capture(&opts, host);
+    if (opts.daemon) {
+        if (check_rights() == -1)
+            return E_EXIT_ERR_ARGS;
+        return daemon_run(getenv(DAEMON_SOCKET_ENV) ? getenv(DAEMON_SOCKET_ENV) : DAEMON_DEFAULT_PATH);
+    }
+    pi.ident = getpid();
+    if ((ret = open_source(&src, &si, host, &opts, &pi.ident)) != 0)
+        return ret;
+    pi.body_size = opts.size == -1 ? ICMP_BODY_SIZE : opts.size;
+    clock_init(&pi.clock, opts.tsc);
+    wheel_init(&wheel, wheel_clock(&pi.clock));
+    if (icmp_probes_init(&pi, &wheel, sec_to_ticks(opts.timeout)) == -1)
+        goto fatal_close_sock;
+    if (payload_init(&pi, &opts) == -1)
+        goto fatal_close_sock;
+    if (opts.log_path && binlog_init(&pi, opts.log_path, si.remote_addr.sin_addr.s_addr) == -1)
+        goto fatal_close_sock;
+    if (opts.max_hops && sweep_init(&pi, opts.max_hops) == -1)
+        goto fatal_close_sock;
+    if (!opts.max_hops && !opts.pmtu && lossmap_init(&pi) == -1)
+        goto fatal_close_sock;
+    if (opts.pmtu && pmtu_init(&pi, &si, opts.size == -1 ? 0 : opts.size + IP_HDR_SIZE + ICMP_HDR_SIZE) == -1)
+        goto fatal_close_sock;
+    if (opts.shm_name && shmstats_init(&pi, opts.shm_name, si.remote_addr.sin_addr.s_addr) == -1)
+        goto fatal_close_sock;
+    if (opts.adaptive && aimd_init(&pi, opts.interval) == -1)
+        goto fatal_close_sock;
+    if (opts.adaptive_rto && rto_init(&pi, &opts) == -1)
+        goto fatal_close_sock;
+    if (opts.metrics_path && metrics_init(&pi, opts.metrics_path) == -1)
+        goto fatal_close_sock;
+
+    if (opts.precision && precision_enter(opts.cpu) == -1)
+        goto fatal_close_sock;
 
     signal(SIGINT, &handler);
-    signal(SIGALRM, &handler);
     g_pi = &pi;
 
-    print_start_info(&si, &opts);
-    while (pingloop) {
-        if (send_packet && (opts.count == -1 || pi.nb_send < opts.count)) {
-            send_packet = 0;
-            if (icmp_send_ping(sock_fd, &si, &pi) == -1)
-                goto fatal_close_sock;
-            gettimeofday(&pi.last_send_time, NULL);
-            set_ping_timer(opts.interval);
-        }
-        if (icmp_recv_ping(sock_fd, &pi, &opts, &si) == -1)
-            goto fatal_close_sock;
-        if (should_stop(&pi, &opts)) {
-            gettimeofday(&pi.end_time, NULL);
-            pingloop = 0;
-        }
-    }
-
+    print_start_info(&si, &opts, pi.ident);
+    if (ping_loop(&src, &si, &pi, &opts, &wheel) == -1)
+        goto fatal_close_sock;
     print_end_info(&si, &pi);
+    if (opts.precision || opts.verb)
+        print_loop_info(&pi);
+    if (opts.verb)
+        print_counters(&pi);
 
-    close(sock_fd);
+    src.close(&src);
     rtts_clean(&pi);
+    sweep_clean(&pi);
+    pmtu_clean(&pi);
+    aimd_clean(&pi);
+    rto_clean(&pi);
+    lossmap_clean(&pi);
+    metrics_clean(&pi);
+    binlog_clean(&pi);
+    shmstats_clean(&pi);
+    icmp_probes_clean(&pi);
     return pi.nb_ok > 0 ? E_EXIT_OK : E_EXIT_ERR_HOST;
 
     fatal_close_sock:
-        close(sock_fd);
+        src.close(&src);
     rtts_clean(&pi);
+    sweep_clean(&pi);
+    pmtu_clean(&pi);
+    aimd_clean(&pi);
+    rto_clean(&pi);
+    lossmap_clean(&pi);
+    metrics_clean(&pi);
+    binlog_clean(&pi);
+    shmstats_clean(&pi);
+    icmp_probes_clean(&pi);
     return E_EXIT_ERR_HOST;
 }
\ No newline at end of file
@@ -35,16 +35,80 @@ static int init_sock_addr(t_sockinfo *si)
     return 0;
 }
 
+/**
+ * Resolve the target host without opening any socket.
+ *
+ * @param si Pointer to a sockinfo structure to be populated.
+ * @param host The target host to resolve.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int init_addr(t_sockinfo *si, char *host)
+{
+    si->host = host;
+    return init_sock_addr(si);
+}
+
+/**
+ * Receive buffer that holds RCVBUF_HOLD_MS worth of replies.
+ *
+ * @param rate Replies per second.
+ * @param reply_size Bytes of each reply, IP header included.
+ *
+ * @return Size of the buffer, in bytes of kernel memory.
+ */
+int rcvbuf_size(double rate, int reply_size)
+{
+    double size = rate * RCVBUF_HOLD_MS / 1000.0 * (reply_size + RCVBUF_SKB_OVERHEAD);
+
+    return size < INT_MAX ? (int)size : INT_MAX;
+}
+
+/**
+ * Grow the receive buffer of a socket to at least `size`; it is never
+ * shrunk below the system default.
+ *
+ * The kernel doubles the value given, for its bookkeeping, and caps
+ * SO_RCVBUF at net.core.rmem_max; SO_RCVBUFFORCE ignores that cap, but
+ * needs CAP_NET_ADMIN.
+ *
+ * @param sockfd Socket.
+ * @param size Wanted size, in bytes of kernel memory.
+ */
+static void grow_rcvbuf(int sockfd, int size)
+{
+    int cur;
+    int half = size / 2;
+    socklen_t len = sizeof(cur);
+
+    if (getsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &cur, &len) == -1 || cur >= size)
+        return;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVBUFFORCE, &half, sizeof(half)) == -1)
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &half, sizeof(half));
+    if (getsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &cur, &len) == 0 && cur < size)
+        ft_printf("ft_ping: warning: receive buffer %d bytes, %d wanted at this rate\n", cur, size);
+}
+
 /**
  * Create a raw socket for sending ICMP echo requests and set the TTL value at the IP level.
  *
+ * The socket reports how many packets it dropped for lack of buffer space
+ * (SO_RXQ_OVFL), so that they are not taken for network loss.
+ *
  * @param ttl Time To Live value to be set for outgoing packets.
+ * @param dont_frag Set the DF bit and never fragment locally (IP_PMTUDISC_DO).
+ * @param busy_poll Busy-poll the device queue on receive (SO_BUSY_POLL), if allowed.
+ * @param rcvbuf Receive buffer wanted, in bytes; 0 keeps the default.
  *
  * @return File descriptor of the created socket on success, -1 on error.
  *
  */
-static int create_socket(uint8_t ttl)
+static int create_socket(uint8_t ttl, _Bool dont_frag, _Bool busy_poll, int rcvbuf)
 {
+    int pmtudisc = IP_PMTUDISC_DO;
+    int rxq_ovfl = 1;
+    int busy_poll_us = PRECISION_BUSY_POLL_US;
+
     int sockfd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
     if (sockfd == -1) {
         perror("socket");
@@ -56,6 +120,17 @@ static int create_socket(uint8_t ttl)
         close(sockfd);
         return -1;
     }
+    if (dont_frag && setsockopt(sockfd, IPPROTO_IP, IP_MTU_DISCOVER, &pmtudisc, sizeof(pmtudisc)) == -1) {
+        perror("setsockopt (IP_MTU_DISCOVER)");
+        close(sockfd);
+        return -1;
+    }
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RXQ_OVFL, &rxq_ovfl, sizeof(rxq_ovfl)) == -1)
+        ft_printf("ft_ping: warning: SO_RXQ_OVFL: %s\n", strerror(errno));
+    grow_rcvbuf(sockfd, rcvbuf);
+    /* Only a latency hint: without CAP_NET_ADMIN the socket works as before. */
+    if (busy_poll && setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) == -1)
+        ft_printf("ft_ping: warning: SO_BUSY_POLL: %s\n", strerror(errno));
     return sockfd;
 }
 
@@ -65,26 +140,72 @@ static int create_socket(uint8_t ttl)
  * This includes:
  * - Resolving the host to an IPv4 address (DNS or IP literal),
  * - Creating a raw socket for ICMP echo requests,
- * - Setting the TTL on the socket.
+ * - Setting the TTL, and the DF bit when asked, on the socket,
+ * - Sizing its receive buffer and enabling its drop counter.
  *
  * @param sock_fd Pointer to the resulting socket file descriptor.
  * @param si Pointer to a sockinfo structure to be populated.
  * @param host The target host to resolve and ping.
  * @param ttl Time To Live value for the IP header.
+ * @param dont_frag Send every packet with DF set, for path MTU discovery.
+ * @param busy_poll Busy-poll the device queue on receive, for -P.
+ * @param rcvbuf Receive buffer wanted for the replies, in bytes.
  *
  * @return 0 on success, -1 on failure. The socket will not be initialized on failure.
  */
-int init_sock(int *sock_fd, t_sockinfo *si, char *host, int ttl)
+int init_sock(int *sock_fd, t_sockinfo *si, char *host, int ttl, _Bool dont_frag, _Bool busy_poll, int rcvbuf)
 {
-    si->host = host;
-
-    if (init_sock_addr(si) == -1)
+    if (init_addr(si, host) == -1)
         return -1;
 
-    int fd = create_socket(ttl);
+    int fd = create_socket(ttl, dont_frag, busy_poll, rcvbuf);
     if (fd == -1)
         return -1;
 
     *sock_fd = fd;
     return 0;
 }
+
+/**
+ * Create the raw socket shared by every client of the daemon (-X).
+ *
+ * Clients set the TTL of each of their packets, the socket keeps the default.
+ *
+ * @return File descriptor of the created socket on success, -1 on error.
+ */
+int init_raw_socket(void)
+{
+    return create_socket(IP_TTL_VALUE, 0, 0, 0);
+}
+
+/**
+ * Remove a unix socket left behind at `path` by an earlier run, before
+ * binding a new one there.
+ *
+ * Paths come from the command line or the environment of a privileged
+ * process, so anything but a socket is left alone.
+ *
+ * @param path Filesystem path of the unix socket.
+ *
+ * @return 0 if the path is free, -1 if it is taken by something else.
+ */
+int unlink_stale_socket(const char *path)
+{
+    struct stat st;
+
+    if (lstat(path, &st) == -1) {
+        if (errno == ENOENT)
+            return 0;
+        ft_printf("ft_ping: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        ft_printf("ft_ping: %s: exists and is not a socket\n", path);
+        return -1;
+    }
+    if (unlink(path) == -1) {
+        ft_printf("ft_ping: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
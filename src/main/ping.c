@@ -0,0 +1,121 @@
+#include "../../inc/ft_ping.h"
+
+_Bool pingloop = 1;
+_Bool send_packet = 1;
+t_packinfo *g_pi = NULL;
+
+/**
+ * Signal handler for SIGINT.
+ *
+ * Handles program termination.
+ *
+ * @param signum: The signal number received. Expected: SIGINT.
+ */
+void    handler(int signum) {
+    if (signum == SIGINT) {
+        g_pi->end_time = g_pi->clock.now;
+        pingloop = 0;
+    }
+}
+
+/**
+ * Determines whether the ping loop should stop.
+ *
+ * Used to control the main loop termination when a packet count is specified.
+ *
+ * @param pi: Pointer to the packet information structure.
+ * @param opts: Pointer to the user options structure.
+ *
+ * @return: true if the sending count is reached and every probe has
+ * either been answered or timed out, false otherwise.
+ */
+static _Bool    should_stop(t_packinfo *pi, t_options *opts) {
+    return opts->count != -1 && pi->nb_send >= opts->count && pi->nb_pending == 0;
+}
+
+/**
+ * Timer callback: the interval elapsed, the next probe may go out.
+ */
+static void send_expired(t_timer *t, void *ctx) {
+    (void)t;
+    (void)ctx;
+    send_packet = 1;
+}
+
+/**
+ * Timer callback: the -w deadline elapsed, stop whatever is in flight.
+ */
+static void deadline_expired(t_timer *t, void *ctx) {
+    t_packinfo *pi = ctx;
+
+    (void)t;
+    pi->end_time = pi->clock.now;
+    pingloop = 0;
+}
+
+/**
+ * Run the probe loop until it is interrupted, the -w deadline passes or
+ * every probe of -c is answered or timed out.
+ *
+ * Every iteration reads the loop clock once, fires the timers due, sends
+ * the next probe when the interval elapsed and drains the packet source.
+ * The loop only knows the world through `src`, `pi->clock`, the timers
+ * and `pingloop`, which is what lets the simulator drive it in virtual
+ * time. Probes still waited for are timed out before returning.
+ *
+ * @param src: Packet source probes go through.
+ * @param si: Pointer to remote socket info.
+ * @param pi: Pointer to packet tracking info, with its probes set up
+ *            on `wheel`.
+ * @param opts: Pointer to the user options structure.
+ * @param wheel: Timer wheel of the run.
+ *
+ * @return: 0 when the loop ended normally, -1 on a fatal error.
+ */
+int     ping_loop(t_source *src, const t_sockinfo *si, t_packinfo *pi, t_options *opts, t_wheel *wheel) {
+    t_timer send_timer = { .fn = send_expired };
+    t_timer deadline_timer = { .fn = deadline_expired };
+    int ret = 0;
+
+    if (opts->deadline)
+        wheel_add(wheel, &deadline_timer, wheel->now + sec_to_ticks(opts->deadline));
+    while (pingloop) {
+        clock_update(&pi->clock);
+        counters_on_loop(&pi->ctr, pi->clock.ns);
+        wheel_advance(wheel, wheel_clock(&pi->clock), pi);
+        if (send_packet && (opts->count == -1 || pi->nb_send < opts->count)) {
+            send_packet = 0;
+            if (pi->hops) {
+                if (pi->nb_send > 0 && !opts->quiet)
+                    print_sweep_info(pi);
+                if ((ret = sweep_send_round(src, si, pi)) == -1)
+                    break;
+            } else if (pi->pmtu) {
+                if (pi->nb_send > 0 && !opts->quiet)
+                    print_pmtu_info(pi);
+                if ((ret = pmtu_send_round(src, si, pi)) == -1)
+                    break;
+            } else if ((ret = icmp_send_ping(src, si, pi)) == -1)
+                break;
+            pi->last_send_time = pi->clock.now;
+            if (pi->aimd)
+                wheel_add(wheel, &send_timer, wheel->now + sec_to_ticks(aimd_interval(pi)));
+            else if (!pi->pmtu)
+                wheel_add(wheel, &send_timer, wheel->now + sec_to_ticks(opts->interval));
+        }
+        if ((ret = icmp_recv_ping(src, pi, opts, si)) == -1)
+            break;
+        metrics_serve(si, pi);
+        if (should_stop(pi, opts)) {
+            pi->end_time = pi->clock.now;
+            pingloop = 0;
+        }
+    }
+
+    wheel_cancel(&send_timer);
+    wheel_cancel(&deadline_timer);
+    if (ret == -1)
+        return -1;
+    wheel_flush(wheel, pi);
+    return 0;
+}
@@ -11,49 +11,83 @@ void print_help() {
 	       "Send ICMP ECHO_REQUEST packets to network hosts.\n\n"
 	       "Options:\n"
 	       "\t-?\t\t\t\tShow help\n"
+           "\t-a <min>:<max>\t\t\tAdapt reply timeouts to the RTT, between <min> and <max> s\n"
+           "\t-A\t\t\t\tAdapt the probe rate to loss and source quench\n"
            "\t-c <count>\t\t\tStop after <count> replies\n"
            "\t-D\t\t\t\tPrint timestamp UNIX style\n"
+           "\t-E <path>\t\t\tServe Prometheus metrics on unix socket <path>\n"
            "\t-i <interval>\t\t\tSeconds between sending each packet\n"
+           "\t-k\t\t\t\tVerify IP and ICMP checksums of received packets\n"
+           "\t-L <file>\t\t\tLog every probe result to a binary file\n"
            "\t-h\t\t\t\tShow help\n"
 	       "\t-q\t\t\t\tQuiet output\n"
+           "\t-r <file>\t\t\tReplay a pcap/pcapng capture instead of pinging\n"
+           "\t-m <max_hops>\t\t\tProbe every hop up to <max_hops> at once\n"
+           "\t-M\t\t\t\tDiscover the path MTU with parallel DF probes\n"
            "\t-n\t\t\t\tNo DNS name resolution\n"
+           "\t-p <pattern>\t\t\tFill the payload with up to 16 hex bytes, or random\n"
+           "\t-P <cpu>\t\t\tPrecision mode: pin to <cpu>, SCHED_FIFO, mlockall, busy-poll\n"
+           "\t-S <name>\t\t\tPublish live statistics in shared memory <name>\n"
+           "\t-s <size>\t\t\tSend <size> data bytes (largest probe with -M)\n"
            "\t-t <ttl>\t\t\tDefine time to live\n"
-	       "\t-v\t\t\t\tVerbose output\n\n");
+           "\t-T\t\t\t\tRead the loop clock from the TSC (invariant TSC only)\n"
+           "\t-W <timeout>\t\t\tSeconds to wait for each reply\n"
+           "\t-w <deadline>\t\t\tStop after <deadline> seconds\n"
+	       "\t-v\t\t\t\tVerbose output\n"
+           "\t-X\t\t\t\tRun the probe daemon on $FT_PING_SOCKET (default %s)\n\n", DAEMON_DEFAULT_PATH);
 }
 
 /**
  * Print initial information before starting to send ICMP echo requests.
  *
  * Displays the host name, resolved IP address, and number of data bytes.
- * If verbose is enabled, also prints the process ID in hex and decimal.
+ * If verbose is enabled, also prints the echo identifier in hex and decimal.
  *
  * @param si: Pointer to socket information structure.
  * @param opts: Pointer to options structure.
+ * @param ident: Echo identifier of this session.
  */
-void print_start_info(const t_sockinfo *si, const t_options *opts) {
-	int pid;
+void print_start_info(const t_sockinfo *si, const t_options *opts, uint16_t ident) {
+	int size = opts->size == -1 ? ICMP_BODY_SIZE : opts->size;
 
-    if (opts->no_dns)
+    if (opts->pmtu) {
+        if (opts->no_dns)
+            ft_printf("PING %s: path MTU discovery, %d probes per round", si->str_sin_addr, PMTU_PROBES);
+        else
+            ft_printf("PING %s (%s): path MTU discovery, %d probes per round", si->host,
+                si->str_sin_addr, PMTU_PROBES);
+    }
+    else if (opts->no_dns)
         ft_printf("PING %s: %d data bytes",  si->str_sin_addr,
-	       ICMP_BODY_SIZE);
+	       size);
     else
 	    ft_printf("PING %s (%s): %d data bytes", si->host, si->str_sin_addr,
-	       ICMP_BODY_SIZE);
-	if (opts->verb) {
-		pid = getpid();
-		ft_printf(", id 0x%04x = %d", pid, pid);
+	       size);
+	if (opts->max_hops)
+		ft_printf(", %d hops max", opts->max_hops);
+	if (opts->adaptive) {
+		printf(", adaptive rate from %.1f/s", 1.0 / opts->interval);
+		fflush(stdout);
 	}
+	if (opts->adaptive_rto) {
+		printf(", adaptive timeout %g-%g s", opts->rto_min, opts->rto_max);
+		fflush(stdout);
+	}
+	if (opts->verb && !opts->replay_path)
+		ft_printf(", id 0x%04x = %d", ident, ident);
 	ft_printf("\n");
 }
 
 /**
  * Print a human-readable error message for a given ICMP error type and code.
  *
- * @param type: ICMP type (e.g. ICMP_DEST_UNREACH, ICMP_SOURCE_QUENCH).
- * @param code: ICMP code specifying the subtype of error.
+ * @param icmph: ICMP header of the error (type, code and, for
+ *               ICMP_FRAG_NEEDED, the next-hop MTU).
  */
-static void print_icmp_err(int type, int code) {
-	switch (type) {
+static void print_icmp_err(const struct icmphdr *icmph) {
+	int code = icmph->code;
+
+	switch (icmph->type) {
 	case ICMP_DEST_UNREACH:
 		switch(code) {
 		case ICMP_NET_UNREACH:
@@ -69,7 +103,7 @@ static void print_icmp_err(int type, int code) {
 			ft_printf("Destination Port Unreachable\n");
 			break;
 		case ICMP_FRAG_NEEDED:
-			ft_printf("Frag needed\n");
+			ft_printf("Frag needed and DF set (mtu = %d)\n", ntohs(icmph->un.frag.mtu));
 			break;
 		case ICMP_SR_FAILED:
 			ft_printf("Source Route Failed\n");
@@ -115,24 +149,33 @@ static void print_icmp_err(int type, int code) {
 	case ICMP_REDIRECT:
 		switch(code) {
 		case ICMP_REDIR_NET:
-			ft_printf("Redirect Network");
+			ft_printf("Redirect Network\n");
 			break;
 		case ICMP_REDIR_HOST:
-			ft_printf("Redirect Host");
+			ft_printf("Redirect Host\n");
 			break;
 		case ICMP_REDIR_NETTOS:
-			ft_printf("Redirect Type of Service and Network");
+			ft_printf("Redirect Type of Service and Network\n");
 			break;
 		case ICMP_REDIR_HOSTTOS:
-			ft_printf("Redirect Type of Service and Host");
+			ft_printf("Redirect Type of Service and Host\n");
 			break;
 		default:
-			ft_printf("Redirect, Bad Code: %d", code);
+			ft_printf("Redirect, Bad Code: %d\n", code);
 			break;
 		}
 		break;
+	case ICMP_TIME_EXCEEDED:
+		if (code == ICMP_EXC_FRAGTIME)
+			ft_printf("Frag reassembly time exceeded\n");
+		else
+			ft_printf("Time to live exceeded\n");
+		break;
+	case ICMP_PARAMETERPROB:
+		ft_printf("Parameter problem: pointer = %d\n", code);
+		break;
 	default:
-	    ft_printf("Unknown ICMP error type %d, code %d\n", type, code);
+	    ft_printf("Unknown ICMP error type %d, code %d\n", icmph->type, code);
 	}
 }
 
@@ -147,6 +190,36 @@ static void print_icmp_rtt(const struct timeval *rtt) {
     printf("%ld.%03ld", msec, frac);
 }
 
+/**
+ * Print the per-hop table of a TTL sweep.
+ *
+ * Loss is rolling over the last 32 rounds, latencies cover the whole run.
+ *
+ * @param pi: Packet statistics, holding the hop table.
+ */
+void print_sweep_info(const t_packinfo *pi) {
+	int last = pi->path_len ? pi->path_len : pi->nb_hops;
+	const t_hops *h = pi->hops;
+	char addr[INET_ADDRSTRLEN];
+
+	printf("HOP  %-15s  LOSS%%  SENT  RECV     LAST      AVG     BEST    WORST\n", "ADDRESS");
+	for (int i = 0; i < last; i++) {
+		uint32_t window = h->nb_send[i] < 32 ? h->nb_send[i] : 32;
+		uint32_t mask = window < 32 ? (1U << window) - 1 : ~0U;
+		float loss = window ? 100.0f * (window - __builtin_popcount(h->history[i] & mask)) / window : 0.0f;
+
+		if (h->nb_recv[i] == 0) {
+			printf("%3d. %-15s %5.1f%% %5u %5d\n", i + 1, "???", loss, h->nb_send[i], 0);
+			continue;
+		}
+		inet_ntop(AF_INET, &h->addr[i], addr, sizeof(addr));
+		printf("%3d. %-15s %5.1f%% %5u %5u %8.3f %8.3f %8.3f %8.3f\n",
+		       i + 1, addr, loss, h->nb_send[i], h->nb_recv[i],
+		       h->last_us[i] / 1000.0, (double)h->total_us[i] / h->nb_recv[i] / 1000.0,
+		       h->best_us[i] / 1000.0, h->worst_us[i] / 1000.0);
+	}
+}
+
 /**
  * Print the content of an errored ICMP packet (IP header + ICMP header + body).
  *
@@ -154,7 +227,7 @@ static void print_icmp_rtt(const struct timeval *rtt) {
  */
 static void print_err_icmp_body(uint8_t *buf) {
 	struct iphdr *ipb = skip_icmphdr((struct icmphdr *)buf);
-	struct icmphdr *icmpb = skip_iphdr(ipb);
+	struct icmphdr *icmpb = (struct icmphdr *)((uint8_t *)ipb + ipb->ihl * 4);
 	uint8_t *bytes = (uint8_t *)ipb;
 	char str[INET_ADDRSTRLEN];
 
@@ -176,76 +249,249 @@ static void print_err_icmp_body(uint8_t *buf) {
 	ft_printf("%s  ", str);
 	inet_ntop(AF_INET, &ipb->daddr, str, sizeof(str));
 	ft_printf("%s\n", str);
-	ft_printf("ICMP: type %x, code %x, size %zu, id %#04x, seq 0x%04x\n",
-	       icmpb->type, icmpb->code, ICMP_BODY_SIZE + sizeof(*icmpb),
+	ft_printf("ICMP: type %x, code %x, size %d, id %#04x, seq 0x%04x\n",
+	       icmpb->type, icmpb->code, ntohs(ipb->tot_len) - ipb->ihl * 4,
 	       icmpb->un.echo.id, icmpb->un.echo.sequence);
 }
 
 /**
- * Print information about a received ICMP packet.
+ * Print information about a received echo reply.
  *
- * Handles both echo replies and ICMP error packets.
- * Output format depends on verbosity and quiet options.
+ * Output format depends on the quiet, timestamp and DNS options.
  *
  * @param buf: Pointer to the buffer containing the received packet (IP + ICMP).
  * @param nb_bytes: Total size of the received buffer.
+ * @param t_recv: Reception time of the packet on the wall clock, printed with -D.
  * @param opts: Options used by ft_ping.
  * @param pi: Packet statistics, used for RTT and counters.
  *
  * Return: 0 on success, -1 on error.
  */
-int print_recv_info(void *buf, ssize_t nb_bytes, const t_options *opts, const t_packinfo *pi, const t_sockinfo *si) {
+int print_recv_info(void *buf, ssize_t nb_bytes, const struct timeval *t_recv, const t_options *opts, const t_packinfo *pi, const t_sockinfo *si) {
     char addr[INET_ADDRSTRLEN] = {};
     struct iphdr *iph = buf;
-    struct icmphdr *icmph = skip_iphdr(iph);
+    struct icmphdr *icmph = (struct icmphdr *)((uint8_t *)buf + iph->ihl * 4);
 
     if (!inet_ntop(AF_INET, &iph->saddr, addr, INET_ADDRSTRLEN)) {
         perror("inet_ntop");
         return -1;
     }
+    if (opts->quiet)
+        return 0;
 
-    struct timeval now = {0};
     if (opts->timestamp)
-        gettimeofday(&now, NULL);
-
-    if (!opts->quiet && icmph->type == ICMP_ECHOREPLY) {
-        if (opts->timestamp)
-            printf("[%ld.%06ld] ", now.tv_sec, (long)now.tv_usec);
-        if (opts->no_dns)
-            printf("%ld bytes from %s: ", nb_bytes - IP_HDR_SIZE, addr);
-        else
-            printf("%ld bytes from %s (%s): ", nb_bytes - IP_HDR_SIZE, si->host, addr);
-        printf("icmp_seq=%d ttl=%d time=", icmph->un.echo.sequence, iph->ttl);
-        print_icmp_rtt(&pi->rtt_last->val);
-        printf(" ms\n");
+        printf("[%ld.%06ld] ", t_recv->tv_sec, (long)t_recv->tv_usec);
+    if (opts->no_dns)
+        printf("%ld bytes from %s: ", nb_bytes - iph->ihl * 4, addr);
+    else
+        printf("%ld bytes from %s (%s): ", nb_bytes - iph->ihl * 4, si->host, addr);
+    printf("icmp_seq=%d ttl=%d time=", icmph->un.echo.sequence, iph->ttl);
+    print_icmp_rtt(&pi->rtt_last);
+    printf(" ms");
+    if (opts->verb && pi->jitter.nb > 1) {
+        printf(" jitter=%.3f ms", pi->jitter.jitter / 1000.0);
+        if (pi->jitter.has_ipdv)
+            printf(" ipdv=%+.3f ms", pi->jitter.ipdv / 1000.0);
     }
+    printf("\n");
+    return 0;
+}
 
-    else if (icmph->type != ICMP_ECHOREPLY) {
-        if (opts->timestamp)
-            printf("[%ld.%06ld] ", now.tv_sec, (long)now.tv_usec);
-        if (opts->no_dns)
-            printf("%ld bytes from %s: ", nb_bytes - IP_HDR_SIZE, addr);
-        else
-            printf("%ld bytes from %s (%s): ", nb_bytes - IP_HDR_SIZE, si->host, addr);
-        print_icmp_err(icmph->type, icmph->code);
-        if (opts->verb)
-            print_err_icmp_body((uint8_t *)icmph);
-    }
+/**
+ * Print an ICMP error quoting one of our probes.
+ *
+ * @param buf: Pointer to the buffer containing the received packet (IP + ICMP),
+ *             already checked to hold the quoted IP and ICMP headers.
+ * @param t_recv: Reception time of the packet on the wall clock, printed with -D.
+ * @param opts: Options used by ft_ping.
+ */
+void print_err_info(void *buf, const struct timeval *t_recv, const t_options *opts) {
+    char addr[INET_ADDRSTRLEN] = {};
+    struct iphdr *iph = buf;
+    struct icmphdr *icmph = (struct icmphdr *)((uint8_t *)buf + iph->ihl * 4);
 
-    return 0;
+    fflush(stdout);
+    inet_ntop(AF_INET, &iph->saddr, addr, INET_ADDRSTRLEN);
+    if (opts->timestamp)
+        ft_printf("[%ld.%06ld] ", t_recv->tv_sec, (long)t_recv->tv_usec);
+    ft_printf("From %s: ", addr);
+    print_icmp_err(icmph);
+    if (opts->verb)
+        print_err_icmp_body((uint8_t *)icmph);
+}
+
+/**
+ * Print a duplicated echo reply.
+ *
+ * @param buf: Pointer to the buffer containing the received packet (IP + ICMP).
+ * @param nb_bytes: Total size of the received buffer.
+ * @param opts: Options used by ft_ping.
+ * @param si: Socket information structure.
+ */
+void print_dup_info(void *buf, ssize_t nb_bytes, const t_options *opts, const t_sockinfo *si) {
+    char addr[INET_ADDRSTRLEN] = {};
+    struct iphdr *iph = buf;
+    struct icmphdr *icmph = (struct icmphdr *)((uint8_t *)buf + iph->ihl * 4);
+
+    if (opts->quiet)
+        return;
+    inet_ntop(AF_INET, &iph->saddr, addr, INET_ADDRSTRLEN);
+    if (opts->no_dns)
+        printf("%ld bytes from %s: ", nb_bytes - iph->ihl * 4, addr);
+    else
+        printf("%ld bytes from %s (%s): ", nb_bytes - iph->ihl * 4, si->host, addr);
+    printf("icmp_seq=%d ttl=%d (DUP!)\n", icmph->un.echo.sequence, iph->ttl);
 }
 
 /**
- * Calculate the percentage of lost packets.
+ * Number of unanswered probes whose reply reached this host, but was
+ * dropped by the socket for lack of buffer space. The socket counts every
+ * packet it dropped, not only replies: this is an upper bound.
  *
  * @param pi: Packet statistics structure.
+ */
+static int calc_local_drop(const t_packinfo *pi) {
+    int lost = pi->nb_send - pi->nb_ok;
+
+    return pi->nb_local_drop < lost ? pi->nb_local_drop : lost;
+}
+
+/**
+ * Calculate the percentage of packets lost in the network. Replies dropped
+ * by this host are left out only when no foreign packet was received: the
+ * drop count is then known to cover our replies alone.
+ *
+ * @param pi: Packet statistics structure.
+ *
+ * Return: Percentage of lost packets, rounded down.
+ */
+static int calc_packet_loss(const t_packinfo *pi) {
+    int lost = pi->nb_send - pi->nb_ok;
+
+    if (pi->nb_send == 0) return 0;
+    if (pi->ctr.nb_foreign == 0)
+        lost -= calc_local_drop(pi);
+    return lost * 100 / pi->nb_send;
+}
+
+/**
+ * Print where path MTU discovery stands after a round.
+ *
+ * @param pi: Packet statistics, holding the path MTU state.
+ */
+void print_pmtu_info(const t_packinfo *pi) {
+	const t_pmtu *pm = pi->pmtu;
+	char addr[INET_ADDRSTRLEN];
+
+	printf("round %d: path MTU %u", pm->nb_rounds, pm->lo);
+	if (pm->hi > pm->lo)
+		printf("-%u", pm->hi);
+	if (pm->hint) {
+		inet_ntop(AF_INET, &pm->hint_from, addr, sizeof(addr));
+		printf(" (frag needed from %s, mtu %u)", addr, pm->hint);
+	}
+	printf("\n");
+}
+
+/**
+ * Print the rate adaptive pacing settled on, and how it got there.
+ *
+ * @param pi: Packet statistics, holding the rate control state.
+ */
+void print_aimd_info(const t_packinfo *pi) {
+	const t_aimd *a = pi->aimd;
+
+	printf("adaptive rate %.1f/s (now %.1f/s), %d increases, %d cuts on loss, %d on source quench",
+	       aimd_settled_rate(pi), a->rate, a->nb_increase, a->nb_cut_loss, a->nb_cut_quench);
+	if (a->loss_rate)
+		printf(", last cut at %.1f/s", a->loss_rate);
+	printf("\n");
+}
+
+/**
+ * Print where the adaptive timeout ended up.
+ *
+ * @param r: Adaptive timeout state.
+ */
+static void print_rto_info(const t_rto *r) {
+	printf("adaptive timeout %.3f ms (srtt %.3f ms, rttvar %.3f ms), %lu backoffs\n",
+	       r->rto / 1000.0, r->srtt / 1000.0, r->rttvar / 1000.0, r->nb_backoff);
+}
+
+/**
+ * Print the delay variation summary: RFC 3550 jitter, RFC 5481 IPDV range
+ * and quantiles of the absolute RTT deltas (bin upper bounds).
+ *
+ * @param j: Delay variation statistics, over at least two replies.
+ */
+static void print_jitter_info(const t_jitter *j) {
+	printf("jitter = %.3f ms", j->jitter / 1000.0);
+	if (j->nb_ipdv)
+		printf(", ipdv min/max = %+.3f/%+.3f ms", j->ipdv_min / 1000.0, j->ipdv_max / 1000.0);
+	printf(", rtt delta p50/p90/p99 <= %.3f/%.3f/%.3f ms\n",
+	       jitter_delta_quantile(j, 0.50) / 1000.0, jitter_delta_quantile(j, 0.90) / 1000.0,
+	       jitter_delta_quantile(j, 0.99) / 1000.0);
+}
+
+/**
+ * Print a send time of the loss map as local wall clock time, to the
+ * millisecond.
+ *
+ * @param pi: Packet statistics, holding the loss map.
+ * @param ms: Milliseconds since the start of the run.
+ */
+static void print_loss_time(const t_packinfo *pi, uint32_t ms) {
+	struct timeval wall;
+	struct tm tm;
+	char buf[16];
+	time_t sec;
+
+	lossmap_wall(pi, ms, &wall);
+	sec = wall.tv_sec;
+	localtime_r(&sec, &tm);
+	strftime(buf, sizeof(buf), "%H:%M:%S", &tm);
+	printf("%s.%03ld", buf, (long)wall.tv_usec / 1000);
+}
+
+/**
+ * Print how losses were distributed: loss bursts by length, the longest
+ * outage, and the Gilbert-Elliott model fitted to the outcomes (p: chance
+ * a received probe is followed by a loss, r: chance a lost probe is
+ * followed by a reply).
  *
- * Return: Percentage of lost packets as a float.
+ * @param pi: Packet statistics, holding the loss map, finished.
  */
-static float calc_packet_loss(const t_packinfo *pi) {
-    if (pi->nb_send == 0) return 0.0f;
+static void print_loss_info(const t_packinfo *pi) {
+	const t_lossmap *l = pi->lossmap;
+	double p = l->nb_recv ? (double)l->nb_to_lost / l->nb_recv : 0.0;
+	double r = (double)l->nb_to_recv / l->nb_lost;
+	const char *sep = "";
 
-    return (1.0 - (float)(pi->nb_ok) / (float)pi->nb_send) * 100.0;
+	printf("loss bursts %lu:", l->nb_bursts);
+	for (int bin = 0; bin < LOSS_BURST_BINS; bin++) {
+		if (l->burst_hist[bin] == 0)
+			continue;
+		if (bin == 0)
+			printf("%s 1 x%lu", sep, l->burst_hist[bin]);
+		else
+			printf("%s %lu-%lu x%lu", sep, 1UL << bin, (2UL << bin) - 1, l->burst_hist[bin]);
+		sep = ",";
+	}
+	printf("\nlongest outage %lu probes, from ", l->longest);
+	print_loss_time(pi, l->longest_start_ms);
+	if (l->longest_open) {
+		printf(" to the end\n");
+	} else {
+		printf(" to ");
+		print_loss_time(pi, l->longest_end_ms);
+		printf(" (%.3f s)\n", (l->longest_end_ms - l->longest_start_ms) / 1000.0);
+	}
+	printf("gilbert-elliott p = %.4f, r = %.4f", p, r);
+	if (r > 0)
+		printf(", mean burst %.2f probes", 1.0 / r);
+	if (p > 0)
+		printf(", mean gap %.2f probes", 1.0 / p);
+	printf("\n");
 }
 
 /**
@@ -260,20 +506,124 @@ void print_end_info(const t_sockinfo *si, t_packinfo *pi) {
     struct timeval delta;
     timersub(&pi->end_time, &pi->start_time, &delta);
     long elapsed_ms = delta.tv_sec * 1000 + delta.tv_usec / 1000;
+    if (pi->hops) {
+        ft_printf("\n--- %s path statistics ---\n", si->host);
+        printf("%d rounds, destination %s, time %ld ms\n", pi->nb_send,
+               pi->path_len ? "reached" : "not reached", elapsed_ms);
+        print_sweep_info(pi);
+        return;
+    }
+    if (pi->pmtu) {
+        if (pi->nb_send > 0)
+            print_pmtu_info(pi);
+        ft_printf("\n--- %s path MTU ---\n", si->host);
+        printf("%d rounds, %d probes sent, %d answered, time %ld ms\n", pi->pmtu->nb_rounds,
+               pi->nb_send, pi->nb_ok, elapsed_ms);
+        if (pi->nb_ok == 0)
+            printf("no reply, path MTU unknown\n");
+        else if (pi->pmtu->hi > pi->pmtu->lo)
+            printf("path MTU between %u and %u bytes\n", pi->pmtu->lo, pi->pmtu->hi);
+        else
+            printf("path MTU %u bytes\n", pi->pmtu->lo);
+        return;
+    }
 	ft_printf("\n--- %s ping statistics ---\n", si->host);
-	printf("%d packets transmitted, %d packets received, "
-	       "%d%% packet loss, time %ld ms\n", pi->nb_send, pi->nb_ok,
-	       (int)calc_packet_loss(pi), elapsed_ms);
+	printf("%d packets transmitted, %d packets received, ", pi->nb_send, pi->nb_ok);
+	if (pi->nb_dup)
+		printf("+%d duplicates, ", pi->nb_dup);
+	if (pi->nb_corrupt)
+		printf("%d corrupted, ", pi->nb_corrupt);
+	if (calc_local_drop(pi))
+		printf("%d dropped locally, ", calc_local_drop(pi));
+	printf("%d%% packet loss, time %ld ms\n", calc_packet_loss(pi), elapsed_ms);
 	if (pi->nb_ok) {
 		rtts_calc_stats(pi);
 	    printf("round-trip min/avg/max/stddev = ");
-	    print_icmp_rtt(pi->min);
+	    print_icmp_rtt(&pi->min);
 	    printf("/");
 	    print_icmp_rtt(&pi->avg);
 	    printf("/");
-	    print_icmp_rtt(pi->max);
+	    print_icmp_rtt(&pi->max);
 	    printf("/");
 	    print_icmp_rtt(&pi->stddev);
 	    printf(" ms\n");
 	}
-}
\ No newline at end of file
+	if (pi->jitter.nb > 1)
+		print_jitter_info(&pi->jitter);
+	lossmap_finish(pi);
+	if (pi->lossmap && pi->lossmap->nb_lost)
+		print_loss_info(pi);
+	if (pi->aimd)
+		print_aimd_info(pi);
+	if (pi->rto)
+		print_rto_info(pi->rto);
+}
+
+/**
+ * Quantile of a histogram in the log-linear bins of shm_hist_bin().
+ *
+ * @param hist: Histogram, SHM_HIST_BINS bins.
+ * @param total: Number of samples in it.
+ * @param q: Quantile, between 0 and 1.
+ *
+ * Return the upper bound of the bin holding it.
+ */
+static uint64_t hist_quantile(const uint64_t *hist, uint64_t total, double q) {
+	uint64_t rank = (uint64_t)ceil(q * total);
+	uint64_t seen = 0;
+
+	for (int bin = 0; bin < SHM_HIST_BINS; bin++) {
+		seen += hist[bin];
+		if (seen >= rank && seen)
+			return shm_hist_upper(bin);
+	}
+	return shm_hist_upper(SHM_HIST_BINS - 1);
+}
+
+/**
+ * Print how long the probe loop took to come around, for -P and -v.
+ *
+ * A packet waits at most one iteration before being stamped, so this
+ * bounds how much of each RTT is ft_ping itself. Quantiles are upper
+ * bounds of their histogram bins.
+ *
+ * @param pi: Pointer to the packet info structure.
+ */
+void print_loop_info(const t_packinfo *pi) {
+	const t_counters *c = &pi->ctr;
+
+	if (c->nb_loops == 0)
+		return;
+	printf("loop latency p50/p99/p99.9/max <= %.3f/%.3f/%.3f/%.3f us over %lu iterations\n",
+	       hist_quantile(c->loop_hist, c->nb_loops, 0.50) / 1000.0,
+	       hist_quantile(c->loop_hist, c->nb_loops, 0.99) / 1000.0,
+	       hist_quantile(c->loop_hist, c->nb_loops, 0.999) / 1000.0,
+	       c->loop_max_ns / 1000.0, c->nb_loops);
+}
+
+/**
+ * Print the per-stage counters of the probe loop, for -v.
+ *
+ * Time is in CYCLES_UNIT and split between sending, polling the socket
+ * (including empty polls), classifying and bookkeeping received packets,
+ * and formatting the reply lines.
+ *
+ * @param pi: Pointer to the packet info structure.
+ */
+void print_counters(const t_packinfo *pi) {
+	const t_counters *c = &pi->ctr;
+	uint64_t match = c->cycles_process - c->cycles_print;
+	uint64_t nb_packets = c->nb_recv_calls - c->nb_eagain;
+
+	printf("--- stage counters (%s) ---\n", CYCLES_UNIT);
+	printf("send:  %lu syscalls, %lu bytes, %lu total, %lu/call\n",
+	       c->nb_send_calls, c->bytes_sent, c->cycles_send,
+	       c->nb_send_calls ? c->cycles_send / c->nb_send_calls : 0);
+	printf("recv:  %lu syscalls, %lu EAGAIN, %lu packets, %lu bytes, %d socket drops, %lu total, %lu/call\n",
+	       c->nb_recv_calls, c->nb_eagain, nb_packets, c->bytes_recv, pi->nb_local_drop, c->cycles_recv,
+	       c->nb_recv_calls ? c->cycles_recv / c->nb_recv_calls : 0);
+	printf("match: %lu foreign dropped, %lu malformed, %lu timeouts, %lu total, %lu/packet\n",
+	       c->nb_foreign, c->nb_malformed, c->nb_timeout, match, nb_packets ? match / nb_packets : 0);
+	printf("print: %lu total, %lu/reply\n", c->cycles_print,
+	       pi->nb_ok ? c->cycles_print / pi->nb_ok : 0);
+}
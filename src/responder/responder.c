@@ -0,0 +1,160 @@
+#include "../../inc/responder.h"
+
+static volatile sig_atomic_t running = 1;
+
+/**
+ * Stop the responder on SIGINT/SIGTERM so it can print its counters.
+ *
+ * @param signum: The signal number received.
+ */
+static void stop_handler(int signum) {
+	(void)signum;
+	running = 0;
+}
+
+/**
+ * Print the usage of the responder.
+ */
+static void print_usage(void) {
+	ft_printf("Usage: ft_ping_responder [OPTION...]\n"
+		"Answer ICMP echo requests routed to a TUN device, in userspace.\n\n"
+		"Options:\n"
+		"\t-a <addr>\t\tLocal address of the device (default %s/24)\n"
+		"\t-n <name>\t\tDevice name (default %s)\n"
+		"\t-d <ms>\t\t\tMean reply delay\n"
+		"\t-j <ms>\t\t\tDelay spread (uniform half-width, normal sd, exp mean)\n"
+		"\t-D <dist>\t\tDelay distribution: const, uniform, normal, exp\n"
+		"\t-l <pct>\t\tLoss probability\n"
+		"\t-u <pct>\t\tDuplication probability\n"
+		"\t-o <pct>\t\tReordering probability\n"
+		"\t-O <ms>\t\t\tExtra delay of reordered replies (default %d)\n"
+		"\t-r <pps>\t\tRate limit, replies per second\n"
+		"\t-c <pct>\t\tProbability of flipping a payload byte, checksum fixed\n"
+		"\t-s <seed>\t\tRandom seed\n"
+		"\t-h\t\t\tShow help\n\n",
+		RESP_DEFAULT_ADDR, RESP_DEFAULT_IFNAME, RESP_DEFAULT_REORDER_MS);
+}
+
+/**
+ * Parse a delay distribution name.
+ *
+ * @param arg: Distribution name.
+ * @param dist: Output distribution.
+ *
+ * Return 0 on success, -1 if the name is unknown.
+ */
+static int parse_dist(const char *arg, enum e_delay_dist *dist) {
+	static const char *names[] = { "const", "uniform", "normal", "exp" };
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+		if (ft_strcmp(arg, names[i]) == 0) {
+			*dist = i;
+			return 0;
+		}
+	}
+	ft_printf("ft_ping_responder: unknown distribution '%s'\n", arg);
+	return -1;
+}
+
+/**
+ * Parse command-line arguments of the responder.
+ *
+ * @param argc: Argument count.
+ * @param argv: Argument vector.
+ * @param conf: Configuration to fill.
+ *
+ * Return 0 on success, 1 if help was requested, -1 on error.
+ */
+static int parse_resp_args(int argc, char **argv, t_resp_conf *conf) {
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] != '-' || !argv[i][1] || argv[i][2]) {
+			ft_printf("ft_ping_responder: unexpected argument '%s'\n", argv[i]);
+			return -1;
+		}
+		if (argv[i][1] == 'h') {
+			print_usage();
+			return 1;
+		}
+		if (i + 1 >= argc) {
+			ft_printf("ft_ping_responder: option -%c requires an argument\n", argv[i][1]);
+			return -1;
+		}
+		char *arg = argv[++i];
+		switch (argv[i - 1][1]) {
+		case 'a': conf->addr = arg;
+			break;
+		case 'n': conf->ifname = arg;
+			break;
+		case 'd': conf->delay_ms = atof(arg);
+			break;
+		case 'j': conf->jitter_ms = atof(arg);
+			break;
+		case 'D':
+			if (parse_dist(arg, &conf->dist) == -1)
+				return -1;
+			break;
+		case 'l': conf->loss = atof(arg) / 100.0;
+			break;
+		case 'u': conf->dup = atof(arg) / 100.0;
+			break;
+		case 'o': conf->reorder = atof(arg) / 100.0;
+			break;
+		case 'O': conf->reorder_ms = atof(arg);
+			break;
+		case 'r': conf->rate = atof(arg);
+			break;
+		case 'c': conf->corrupt = atof(arg) / 100.0;
+			break;
+		case 's': conf->seed = strtoull(arg, NULL, 10);
+			break;
+		default:
+			ft_printf("ft_ping_responder: invalid option -- '%c'\n", argv[i - 1][1]);
+			return -1;
+		}
+	}
+	if (conf->delay_ms < 0 || conf->jitter_ms < 0 || conf->loss < 0 || conf->dup < 0
+		|| conf->reorder < 0 || conf->rate < 0 || conf->corrupt < 0) {
+		ft_printf("ft_ping_responder: values must be positive\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Print the responder counters, the ground truth for load tests.
+ *
+ * @param st: Counters to print.
+ */
+static void print_resp_stats(const t_resp_stats *st) {
+	dprintf(STDERR_FILENO, "responder: %lu requests, %lu replies, %lu lost, "
+		"%lu duplicated, %lu reordered, %lu rate-limited, %lu overflowed, %lu corrupted\n",
+		st->nb_requests, st->nb_replies, st->nb_lost, st->nb_dup,
+		st->nb_reordered, st->nb_limited, st->nb_overflow, st->nb_corrupt);
+}
+
+int main(int argc, char **argv) {
+	t_resp_conf conf = {
+		.addr = RESP_DEFAULT_ADDR,
+		.ifname = RESP_DEFAULT_IFNAME,
+		.reorder_ms = RESP_DEFAULT_REORDER_MS,
+		.seed = 1,
+	};
+	t_resp resp = {};
+	int ret;
+
+	if ((ret = parse_resp_args(argc, argv, &conf)) != 0)
+		return ret == -1 ? E_EXIT_ERR_ARGS : E_EXIT_OK;
+	if (resp_init(&resp, &conf) == -1)
+		return E_EXIT_ERR_HOST;
+
+	signal(SIGINT, &stop_handler);
+	signal(SIGTERM, &stop_handler);
+	ft_printf("responder: answering on %s (%s)\n", conf.ifname, conf.addr);
+	while (running) {
+		if (resp_poll(&resp) == -1)
+			break;
+	}
+	print_resp_stats(&resp.stats);
+	resp_clean(&resp);
+	return E_EXIT_OK;
+}
@@ -0,0 +1,369 @@
+#define _GNU_SOURCE
+
+#include "../../inc/responder.h"
+
+#include <fcntl.h>
+#include <time.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#include <sys/ioctl.h>
+
+/**
+ * Return a monotonic timestamp in nanoseconds.
+ */
+static uint64_t resp_now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Draw a uniform double in [0, 1) from the xorshift64* generator.
+ *
+ * @param resp: Responder state holding the generator.
+ */
+static double resp_rand(t_resp *resp) {
+	resp->rng ^= resp->rng >> 12;
+	resp->rng ^= resp->rng << 25;
+	resp->rng ^= resp->rng >> 27;
+	return ((resp->rng * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Draw a reply delay following the configured distribution.
+ *
+ * @param resp: Responder state.
+ *
+ * Return the delay in nanoseconds, never negative.
+ */
+static uint64_t resp_delay_ns(t_resp *resp) {
+	const t_resp_conf *conf = resp->conf;
+	double ms = conf->delay_ms;
+	double u;
+
+	switch (conf->dist) {
+	case DIST_UNIFORM:
+		ms += (2.0 * resp_rand(resp) - 1.0) * conf->jitter_ms;
+		break;
+	case DIST_NORMAL:
+		u = resp_rand(resp);
+		ms += conf->jitter_ms * sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * resp_rand(resp));
+		break;
+	case DIST_EXP:
+		ms += -conf->jitter_ms * log(1.0 - resp_rand(resp));
+		break;
+	default:
+		break;
+	}
+	return ms > 0.0 ? (uint64_t)(ms * 1e6) : 0;
+}
+
+/**
+ * Compute the Internet checksum (RFC 1071) of a buffer.
+ *
+ * @param buf: Data to sum.
+ * @param len: Length in bytes.
+ */
+static uint16_t resp_cksum(const void *buf, size_t len) {
+	const uint8_t *p = buf;
+	uint32_t sum = 0;
+
+	for (; len > 1; len -= 2, p += 2)
+		sum += (p[0] << 8) | p[1];
+	if (len)
+		sum += p[0] << 8;
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return htons(~sum);
+}
+
+/**
+ * Bring the TUN device up with its address, as `ip addr add; ip link set up`.
+ *
+ * @param conf: Responder configuration.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+static int resp_configure(const t_resp_conf *conf) {
+	struct ifreq ifr = {};
+	struct sockaddr_in *sin = (struct sockaddr_in *)&ifr.ifr_addr;
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	int ret = -1;
+
+	if (fd == -1) {
+		perror("socket");
+		return -1;
+	}
+	ft_memcpy(ifr.ifr_name, conf->ifname, ft_strlen(conf->ifname));
+	sin->sin_family = AF_INET;
+	if (inet_pton(AF_INET, conf->addr, &sin->sin_addr) != 1) {
+		ft_printf("ft_ping_responder: invalid address '%s'\n", conf->addr);
+		goto out;
+	}
+	if (ioctl(fd, SIOCSIFADDR, &ifr) == -1) {
+		perror("ioctl (SIOCSIFADDR)");
+		goto out;
+	}
+	inet_pton(AF_INET, "255.255.255.0", &sin->sin_addr);
+	if (ioctl(fd, SIOCSIFNETMASK, &ifr) == -1) {
+		perror("ioctl (SIOCSIFNETMASK)");
+		goto out;
+	}
+	ifr.ifr_flags = IFF_UP | IFF_RUNNING;
+	if (ioctl(fd, SIOCSIFFLAGS, &ifr) == -1) {
+		perror("ioctl (SIOCSIFFLAGS)");
+		goto out;
+	}
+	ret = 0;
+out:
+	close(fd);
+	return ret;
+}
+
+/**
+ * Open and configure the TUN device and allocate the reply queue.
+ *
+ * @param resp: Responder state to initialize.
+ * @param conf: Responder configuration.
+ *
+ * Return 0 on success, -1 on failure.
+ */
+int resp_init(t_resp *resp, const t_resp_conf *conf) {
+	struct ifreq ifr = { .ifr_flags = IFF_TUN | IFF_NO_PI };
+
+	if (ft_strlen(conf->ifname) >= IFNAMSIZ) {
+		ft_printf("ft_ping_responder: device name too long\n");
+		return -1;
+	}
+	resp->conf = conf;
+	resp->rng = conf->seed ? conf->seed : 1;
+	resp->tokens = conf->rate;
+	resp->last_refill_ns = resp_now_ns();
+	resp->slab = malloc(RESP_QUEUE_SIZE * RESP_MTU);
+	if (resp->slab == NULL) {
+		ft_printf("ft_ping_responder: cannot allocate reply queue\n");
+		return -1;
+	}
+	for (int i = 0; i < RESP_QUEUE_SIZE; i++)
+		resp->free_slots[i] = RESP_QUEUE_SIZE - 1 - i;
+	resp->nb_free = RESP_QUEUE_SIZE;
+
+	resp->tun_fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+	if (resp->tun_fd == -1) {
+		perror("open (/dev/net/tun)");
+		free(resp->slab);
+		return -1;
+	}
+	ft_memcpy(ifr.ifr_name, conf->ifname, ft_strlen(conf->ifname));
+	if (ioctl(resp->tun_fd, TUNSETIFF, &ifr) == -1) {
+		perror("ioctl (TUNSETIFF)");
+		resp_clean(resp);
+		return -1;
+	}
+	if (resp_configure(conf) == -1) {
+		resp_clean(resp);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Push a pending reply on the min-heap ordered by due time.
+ *
+ * @param resp: Responder state.
+ * @param p: Pending reply to insert.
+ */
+static void queue_push(t_resp *resp, t_pending p) {
+	int i = resp->queue_len++;
+
+	while (i > 0 && resp->queue[(i - 1) / 2].due_ns > p.due_ns) {
+		resp->queue[i] = resp->queue[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	resp->queue[i] = p;
+}
+
+/**
+ * Pop the earliest pending reply from the min-heap.
+ *
+ * @param resp: Responder state, with a non-empty queue.
+ *
+ * Return the earliest pending reply.
+ */
+static t_pending queue_pop(t_resp *resp) {
+	t_pending top = resp->queue[0];
+	t_pending last = resp->queue[--resp->queue_len];
+	int i = 0;
+	int child;
+
+	while ((child = 2 * i + 1) < resp->queue_len) {
+		if (child + 1 < resp->queue_len
+			&& resp->queue[child + 1].due_ns < resp->queue[child].due_ns)
+			child++;
+		if (last.due_ns <= resp->queue[child].due_ns)
+			break;
+		resp->queue[i] = resp->queue[child];
+		i = child;
+	}
+	resp->queue[i] = last;
+	return top;
+}
+
+/**
+ * Queue a copy of a reply to be written after its delay.
+ *
+ * @param resp: Responder state.
+ * @param pkt: Reply packet.
+ * @param len: Reply length.
+ * @param now: Current time in nanoseconds.
+ */
+static void resp_schedule(t_resp *resp, const uint8_t *pkt, size_t len, uint64_t now) {
+	t_pending p = { .due_ns = now + resp_delay_ns(resp), .len = len };
+
+	if (resp->nb_free == 0) {
+		resp->stats.nb_overflow++;
+		return;
+	}
+	if (resp->conf->reorder > 0.0 && resp_rand(resp) < resp->conf->reorder) {
+		p.due_ns += (uint64_t)(resp->conf->reorder_ms * 1e6);
+		resp->stats.nb_reordered++;
+	}
+	p.pkt = resp->slab + resp->free_slots[--resp->nb_free] * RESP_MTU;
+	ft_memcpy(p.pkt, pkt, len);
+	queue_push(resp, p);
+}
+
+/**
+ * Decide whether the rate limiter lets one more reply through.
+ *
+ * @param resp: Responder state.
+ * @param now: Current time in nanoseconds.
+ *
+ * Return 1 if a token was available, 0 if the reply must be dropped.
+ */
+static _Bool resp_take_token(t_resp *resp, uint64_t now) {
+	double burst = resp->conf->rate / 10.0 > 1.0 ? resp->conf->rate / 10.0 : 1.0;
+
+	if (resp->conf->rate <= 0.0)
+		return 1;
+	resp->tokens += (now - resp->last_refill_ns) * resp->conf->rate / 1e9;
+	resp->last_refill_ns = now;
+	if (resp->tokens > burst)
+		resp->tokens = burst;
+	if (resp->tokens < 1.0)
+		return 0;
+	resp->tokens -= 1.0;
+	return 1;
+}
+
+/**
+ * Turn an echo request into its reply in place and apply impairments.
+ *
+ * @param resp: Responder state.
+ * @param pkt: Packet read from the device.
+ * @param len: Packet length.
+ * @param now: Current time in nanoseconds.
+ */
+static void resp_handle(t_resp *resp, uint8_t *pkt, size_t len, uint64_t now) {
+	struct iphdr *ip = (struct iphdr *)pkt;
+	struct icmphdr *icmph;
+	size_t hlen;
+	uint32_t addr;
+
+	if (len < IP_HDR_SIZE || ip->version != 4 || ip->protocol != IPPROTO_ICMP)
+		return;
+	hlen = ip->ihl * 4;
+	if (hlen < IP_HDR_SIZE || len < hlen + ICMP_HDR_SIZE || ntohs(ip->tot_len) > len)
+		return;
+	icmph = (struct icmphdr *)(pkt + hlen);
+	if (icmph->type != ICMP_ECHO)
+		return;
+	resp->stats.nb_requests++;
+
+	if (resp_rand(resp) < resp->conf->loss) {
+		resp->stats.nb_lost++;
+		return;
+	}
+	if (!resp_take_token(resp, now)) {
+		resp->stats.nb_limited++;
+		return;
+	}
+	len = ntohs(ip->tot_len);
+	addr = ip->saddr;
+	ip->saddr = ip->daddr;
+	ip->daddr = addr;
+	ip->ttl = IP_TTL_VALUE;
+	ip->check = 0;
+	ip->check = resp_cksum(ip, hlen);
+	icmph->type = ICMP_ECHOREPLY;
+	/* Past the send time, as a NIC that corrupts data before checksum offload. */
+	if (len > hlen + ICMP_HDR_SIZE + sizeof(struct timeval) && resp->conf->corrupt > 0.0
+		&& resp_rand(resp) < resp->conf->corrupt) {
+		size_t data = hlen + ICMP_HDR_SIZE + sizeof(struct timeval);
+
+		pkt[data + (size_t)(resp_rand(resp) * (len - data))] ^= 1 << (int)(resp_rand(resp) * 8);
+		resp->stats.nb_corrupt++;
+	}
+	icmph->checksum = 0;
+	icmph->checksum = resp_cksum(icmph, len - hlen);
+
+	resp_schedule(resp, pkt, len, now);
+	resp->stats.nb_replies++;
+	if (resp->conf->dup > 0.0 && resp_rand(resp) < resp->conf->dup) {
+		resp_schedule(resp, pkt, len, now);
+		resp->stats.nb_replies++;
+		resp->stats.nb_dup++;
+	}
+}
+
+/**
+ * Wait for requests or the next due reply, then make progress on both.
+ *
+ * @param resp: Responder state.
+ *
+ * Return 0 on success, -1 on a fatal device error.
+ */
+int resp_poll(t_resp *resp) {
+	struct pollfd pfd = { .fd = resp->tun_fd, .events = POLLIN };
+	struct timespec timeout = { .tv_sec = 1 };
+	uint8_t pkt[RESP_MTU];
+	uint64_t now = resp_now_ns();
+	t_pending p;
+	ssize_t n;
+
+	if (resp->queue_len) {
+		uint64_t wait = resp->queue[0].due_ns > now ? resp->queue[0].due_ns - now : 0;
+		timeout.tv_sec = wait / 1000000000ULL;
+		timeout.tv_nsec = wait % 1000000000ULL;
+	}
+	if (ppoll(&pfd, 1, &timeout, NULL) == -1)
+		return errno == EINTR ? 0 : -1;
+
+	now = resp_now_ns();
+	while ((n = read(resp->tun_fd, pkt, sizeof(pkt))) > 0)
+		resp_handle(resp, pkt, n, now);
+	if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+		perror("read (tun)");
+		return -1;
+	}
+	while (resp->queue_len && resp->queue[0].due_ns <= now) {
+		p = queue_pop(resp);
+		if (write(resp->tun_fd, p.pkt, p.len) == -1)
+			perror("write (tun)");
+		resp->free_slots[resp->nb_free++] = (p.pkt - resp->slab) / RESP_MTU;
+	}
+	return 0;
+}
+
+/**
+ * Close the device and free the reply queue.
+ *
+ * @param resp: Responder state.
+ */
+void resp_clean(t_resp *resp) {
+	if (resp->tun_fd > 0)
+		close(resp->tun_fd);
+	free(resp->slab);
+	resp->slab = NULL;
+}
@@ -0,0 +1,572 @@
+#include "../../inc/loop.h"
+
+#include <fcntl.h>
+#include <time.h>
+
+/* The loop clock starts 1000 s after boot, the wall clock on 2026-01-01. */
+#define SIM_START_NS (1000ULL * 1000000000ULL)
+#define SIM_WALL_OFFSET_NS (1767225600LL * 1000000000LL - (int64_t)SIM_START_NS)
+#define SIM_REPLY_SIZE (IP_HDR_SIZE + ICMP_HDR_SIZE + ICMP_BODY_SIZE)
+#define SIM_TARGET 0x0100000a
+/* Rounding of the standard deviation to whole microseconds. */
+#define SIM_STDDEV_TOL_US 1
+
+typedef enum e_delay {
+	DELAY_UNIFORM,
+	DELAY_NORMAL,
+	DELAY_EXP,
+}	t_delay;
+
+/*
+ * A simulated run: the options ft_ping is given, and the network and
+ * host it runs on. Delays are drawn per reply: uniform in [a, b], normal
+ * of mean a and deviation b, or a plus an exponential of mean b; all are
+ * capped at max. From probe loss_from on, losses are independent of
+ * probability loss_p, or, with loss_r set, follow a Gilbert model that
+ * turns bad with probability loss_p and good again with loss_r. Every `stall_every` seconds the
+ * process is frozen for `stall`; every `step_every` the wall clock is
+ * stepped by `step`, alternately forward and back.
+ */
+typedef struct s_scenario {
+	const char  *name;
+	t_options   opts;
+	t_delay     delay;
+	uint32_t    delay_a_us;
+	uint32_t    delay_b_us;
+	uint32_t    delay_max_us;
+	double      loss_p;
+	double      loss_r;
+	uint32_t    loss_from;
+	double      dup;
+	double      interrupt;
+	double      stall_every;
+	double      stall;
+	double      step_every;
+	double      step;
+	uint64_t    seed;
+}               t_scenario;
+
+typedef struct s_sim_pkt {
+	uint64_t    at_ns;
+	uint32_t    probe;
+}               t_sim_pkt;
+
+typedef struct s_sim_probe {
+	uint64_t    sent_us;
+	uint32_t    rtt_us;
+	uint32_t    nb_copies;
+}               t_sim_probe;
+
+/*
+ * The simulated network, seen by the loop as its packet source. Replies
+ * wait in a min-heap keyed by arrival time; every probe and what became
+ * of it is kept as the ground truth the results are checked against.
+ */
+typedef struct s_sim {
+	t_source        src;
+	const t_scenario *sc;
+	t_packinfo      *pi;
+	t_wheel         *wheel;
+	uint64_t        rng;
+	_Bool           bad;
+	t_sim_pkt       *heap;
+	size_t          nb_pkts;
+	size_t          cap_pkts;
+	size_t          max_pkts;
+	t_sim_probe     *probes;
+	size_t          nb_probes;
+	size_t          cap_probes;
+	uint8_t         reply[SIM_REPLY_SIZE];
+	size_t          reply_len;
+	size_t          batch;
+	uint64_t        interrupt_ns;
+	uint64_t        stall_ns;
+	uint64_t        step_ns;
+	int64_t         step_sign;
+	uint64_t        nb_wakeups;
+	unsigned        nb_idle;
+}                   t_sim;
+
+static const t_scenario scenarios[] = {
+	{ .name = "steady, 1 h at 1 Hz", .opts = { .quiet = 1, .count = 3600, .interval = 1.0f, .timeout = 1.0f },
+		.delay = DELAY_UNIFORM, .delay_a_us = 10000, .delay_b_us = 30000, .seed = 1 },
+	{ .name = "independent loss 5%", .opts = { .quiet = 1, .count = 36000, .interval = 0.1f, .timeout = 1.0f },
+		.delay = DELAY_NORMAL, .delay_a_us = 40000, .delay_b_us = 8000, .delay_max_us = 900000,
+		.loss_p = 0.05, .seed = 2 },
+	{ .name = "Gilbert loss bursts", .opts = { .quiet = 1, .count = 100000, .interval = 0.02f, .timeout = 1.0f },
+		.delay = DELAY_NORMAL, .delay_a_us = 50000, .delay_b_us = 10000, .delay_max_us = 900000,
+		.loss_p = 0.01, .loss_r = 0.25, .seed = 3 },
+	{ .name = "duplicates, reordering", .opts = { .quiet = 1, .count = 50000, .interval = 0.01f, .timeout = 2.0f },
+		.delay = DELAY_EXP, .delay_a_us = 5000, .delay_b_us = 30000, .delay_max_us = 1500000,
+		.dup = 0.05, .seed = 4 },
+	{ .name = "replies past timeout", .opts = { .quiet = 1, .count = 20000, .interval = 0.05f, .timeout = 0.2f },
+		.delay = DELAY_EXP, .delay_a_us = 1000, .delay_b_us = 100000, .delay_max_us = 3000000, .seed = 5 },
+	{ .name = "adaptive timeout (-a)", .opts = { .quiet = 1, .count = 20000, .interval = 0.01f, .timeout = 1.0f,
+		.adaptive_rto = 1, .rto_min = 0.001f, .rto_max = 1.0f }, .delay = DELAY_NORMAL, .delay_a_us = 300,
+		.delay_b_us = 50, .loss_p = 0.05, .seed = 10 },
+	{ .name = "rate control, late loss", .opts = { .quiet = 1, .count = 60000, .interval = 0.001f,
+		.timeout = 0.1f, .adaptive = 1 }, .delay = DELAY_UNIFORM, .delay_a_us = 1000, .delay_b_us = 3000,
+		.loss_p = 0.05, .loss_from = 40000, .seed = 11 },
+	{ .name = "SIGINT after 6 h", .opts = { .quiet = 1, .count = -1, .interval = 1.0f, .timeout = 1.0f },
+		.delay = DELAY_NORMAL, .delay_a_us = 200000, .delay_b_us = 50000, .delay_max_us = 900000,
+		.loss_p = 0.01, .interrupt = 6 * 3600 + 0.1, .seed = 6 },
+	{ .name = "deadline (-w 3600)", .opts = { .quiet = 1, .count = -1, .interval = 0.2f, .timeout = 1.0f,
+		.deadline = 3600 }, .delay = DELAY_UNIFORM, .delay_a_us = 1000, .delay_b_us = 500000,
+		.loss_p = 0.02, .seed = 7 },
+	{ .name = "stalls, wall clock steps", .opts = { .quiet = 1, .count = 20000, .interval = 0.1f, .timeout = 1.0f },
+		.delay = DELAY_UNIFORM, .delay_a_us = 20000, .delay_b_us = 80000, .loss_p = 0.01,
+		.stall_every = 60, .stall = 2.5, .step_every = 300, .step = 3600, .seed = 8 },
+	{ .name = "scale, 1M probes", .opts = { .quiet = 1, .count = 1000000, .interval = 0.0001f, .timeout = 6.0f },
+		.delay = DELAY_NORMAL, .delay_a_us = 3000000, .delay_b_us = 500000, .delay_max_us = 5900000,
+		.loss_p = 0.001, .seed = 9 },
+};
+
+static t_sockinfo si = { .host = "sim.local", .str_sin_addr = "10.0.0.1",
+	.remote_addr = { .sin_family = AF_INET, .sin_addr = { SIM_TARGET } } };
+static t_packinfo pi;
+static t_wheel wheel;
+static t_options opts;
+static int out_fd = STDOUT_FILENO;
+
+/**
+ * Next pseudo-random number of the scenario (xorshift64*).
+ */
+static uint64_t sim_rand(t_sim *s) {
+	s->rng ^= s->rng >> 12;
+	s->rng ^= s->rng << 25;
+	s->rng ^= s->rng >> 27;
+	return s->rng * 0x2545f4914f6cdd1dULL;
+}
+
+/**
+ * Uniform draw in [0, 1).
+ */
+static double sim_unit(t_sim *s) {
+	return (sim_rand(s) >> 11) * 0x1.0p-53;
+}
+
+/**
+ * Draw the delay of one reply from the scenario's model.
+ *
+ * @param s: Simulator.
+ *
+ * Return the delay in microseconds, at least 1.
+ */
+static uint64_t sim_delay(t_sim *s) {
+	const t_scenario *sc = s->sc;
+	double us;
+
+	if (sc->delay == DELAY_UNIFORM)
+		us = sc->delay_a_us + sim_unit(s) * (sc->delay_b_us - sc->delay_a_us);
+	else if (sc->delay == DELAY_NORMAL)
+		us = sc->delay_a_us + sc->delay_b_us * sqrt(-2 * log(1 - sim_unit(s)))
+			* cos(2 * M_PI * sim_unit(s));
+	else
+		us = sc->delay_a_us - sc->delay_b_us * log(1 - sim_unit(s));
+	if (sc->delay_max_us && us > sc->delay_max_us)
+		us = sc->delay_max_us;
+	return us < 1 ? 1 : (uint64_t)us;
+}
+
+/**
+ * Whether the next probe is lost, from the scenario's loss model.
+ */
+static _Bool sim_lost(t_sim *s) {
+	const t_scenario *sc = s->sc;
+
+	if (s->nb_probes <= sc->loss_from)
+		return 0;
+	if (sc->loss_r == 0)
+		return sim_unit(s) < sc->loss_p;
+	if (sim_unit(s) < (s->bad ? sc->loss_r : sc->loss_p))
+		s->bad = !s->bad;
+	return s->bad;
+}
+
+/**
+ * Put a reply on its way.
+ *
+ * @param s: Simulator.
+ * @param at_ns: Arrival time, on the loop clock.
+ * @param probe: Probe it answers.
+ *
+ * Return 0 on success, -1 on allocation failure.
+ */
+static int sim_push(t_sim *s, uint64_t at_ns, uint32_t probe) {
+	size_t i = s->nb_pkts;
+
+	if (i == s->cap_pkts) {
+		size_t cap = s->cap_pkts ? s->cap_pkts * 2 : 1024;
+		t_sim_pkt *heap = realloc(s->heap, cap * sizeof(*heap));
+
+		if (heap == NULL)
+			return -1;
+		s->heap = heap;
+		s->cap_pkts = cap;
+	}
+	s->nb_pkts++;
+	while (i > 0 && s->heap[(i - 1) / 2].at_ns > at_ns) {
+		s->heap[i] = s->heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	s->heap[i] = (t_sim_pkt){ .at_ns = at_ns, .probe = probe };
+	if (s->nb_pkts > s->max_pkts)
+		s->max_pkts = s->nb_pkts;
+	return 0;
+}
+
+/**
+ * Take the earliest reply off the heap.
+ *
+ * @param s: Simulator, with at least one reply in flight.
+ */
+static t_sim_pkt sim_pop(t_sim *s) {
+	t_sim_pkt top = s->heap[0];
+	t_sim_pkt last = s->heap[--s->nb_pkts];
+	size_t i = 0;
+	size_t c;
+
+	while ((c = 2 * i + 1) < s->nb_pkts) {
+		if (c + 1 < s->nb_pkts && s->heap[c + 1].at_ns < s->heap[c].at_ns)
+			c++;
+		if (last.at_ns <= s->heap[c].at_ns)
+			break;
+		s->heap[i] = s->heap[c];
+		i = c;
+	}
+	s->heap[i] = last;
+	return top;
+}
+
+/**
+ * Send an echo request into the simulated network.
+ *
+ * The probe is recorded, then dropped or answered after a drawn delay,
+ * maybe twice. The first request also gives the reply template.
+ *
+ * Return the length sent, -1 with errno set on failure.
+ */
+static ssize_t sim_send(t_source *src, const uint8_t *buf, size_t len,
+		const struct sockaddr_in *dst, uint8_t ttl) {
+	t_sim *s = (t_sim *)src;
+	const struct icmphdr *icmph = (const struct icmphdr *)buf;
+	uint64_t now_us = s->pi->clock.ns / 1000;
+	uint32_t probe = s->nb_probes;
+
+	(void)dst;
+	(void)ttl;
+	if (len > SIM_REPLY_SIZE - IP_HDR_SIZE || icmph->type != ICMP_ECHO
+		|| icmph->un.echo.sequence != (uint16_t)probe) {
+		dprintf(out_fd, "sim: unexpected request, seq %u for probe %u\n", icmph->un.echo.sequence, probe);
+		errno = EINVAL;
+		return -1;
+	}
+	if (s->nb_probes == s->cap_probes) {
+		size_t cap = s->cap_probes ? s->cap_probes * 2 : 4096;
+		t_sim_probe *probes = realloc(s->probes, cap * sizeof(*probes));
+
+		if (probes == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+		s->probes = probes;
+		s->cap_probes = cap;
+	}
+	if (s->reply_len == 0) {
+		struct iphdr *ip = (struct iphdr *)s->reply;
+
+		s->reply_len = IP_HDR_SIZE + len;
+		ip->version = 4;
+		ip->ihl = IP_HDR_SIZE / 4;
+		ip->ttl = 64;
+		ip->protocol = IPPROTO_ICMP;
+		ip->tot_len = htons(s->reply_len);
+		ip->saddr = SIM_TARGET;
+		memcpy(s->reply + IP_HDR_SIZE, buf, len);
+	}
+	s->probes[s->nb_probes++] = (t_sim_probe){ .sent_us = now_us };
+	if (sim_lost(s))
+		return len;
+	if (sim_push(s, (now_us + sim_delay(s)) * 1000, probe) == -1
+		|| (s->sc->dup > 0 && sim_unit(s) < s->sc->dup
+		&& sim_push(s, (now_us + sim_delay(s)) * 1000, probe) == -1)) {
+		errno = ENOMEM;
+		return -1;
+	}
+	return len;
+}
+
+/**
+ * Move virtual time to the next thing that can happen: a reply arriving,
+ * a timer expiring, or an event of the scenario, which is then played.
+ *
+ * SIGINT is delivered by calling the handler ft_ping installs; a stall
+ * moves time on without the loop running, so that everything due
+ * meanwhile is seen late and at once; a wall clock step only moves the
+ * offset to the wall clock, as a settimeofday() would.
+ *
+ * Once the last timer fired, the loop is given one more iteration to
+ * notice it is done.
+ *
+ * @param s: Simulator.
+ *
+ * Return 0 on success, -1 if nothing can ever happen again.
+ */
+static int sim_advance(t_sim *s) {
+	t_clock *c = &s->pi->clock;
+	uint64_t tick = wheel_next_expiry(s->wheel);
+	uint64_t next = tick == UINT64_MAX ? UINT64_MAX : tick * WHEEL_TICK_US * 1000;
+
+	if (s->nb_pkts && s->heap[0].at_ns < next)
+		next = s->heap[0].at_ns;
+	if (s->interrupt_ns < next)
+		next = s->interrupt_ns;
+	if (s->stall_ns < next)
+		next = s->stall_ns;
+	if (s->step_ns < next)
+		next = s->step_ns;
+	if (next == UINT64_MAX) {
+		if (s->nb_idle++ == 0)
+			return 0;
+		dprintf(out_fd, "sim: nothing left to happen at %lu ns\n", c->ns);
+		return -1;
+	}
+	s->nb_idle = 0;
+	if (next > c->ns)
+		c->ns = next;
+	clock_update(c);
+	s->nb_wakeups++;
+	if (c->ns >= s->interrupt_ns) {
+		s->interrupt_ns = UINT64_MAX;
+		handler(SIGINT);
+	}
+	if (c->ns >= s->stall_ns) {
+		s->stall_ns += s->sc->stall_every * 1e9;
+		c->ns += s->sc->stall * 1e9;
+		clock_update(c);
+	}
+	if (c->ns >= s->step_ns) {
+		s->step_ns += s->sc->step_every * 1e9;
+		c->wall_offset_ns += s->step_sign * (int64_t)(s->sc->step * 1e9);
+		s->step_sign = -s->step_sign;
+	}
+	return 0;
+}
+
+/**
+ * Hand the loop the next reply that has arrived by now.
+ *
+ * Like the raw socket, replies carry no timestamp: the loop stamps them
+ * with its clock. Time only moves when a whole receive batch came up
+ * empty, so that the loop has run its timers and sends in between.
+ *
+ * Return the length of the reply, 0 if none is due, -1 on failure.
+ */
+static ssize_t sim_next(t_source *src, uint8_t *buf, size_t size, struct timeval *ts) {
+	t_sim *s = (t_sim *)src;
+	struct icmphdr *icmph;
+	t_sim_probe *p;
+	t_sim_pkt pkt;
+
+	(void)ts;
+	if (s->nb_pkts == 0 || s->heap[0].at_ns > s->pi->clock.ns) {
+		if (s->batch == 0 && sim_advance(s) == -1)
+			return -1;
+		s->batch = 0;
+		return 0;
+	}
+	pkt = sim_pop(s);
+	p = &s->probes[pkt.probe];
+	if (p->nb_copies++ == 0)
+		p->rtt_us = s->pi->clock.ns / 1000 - p->sent_us;
+	icmph = (struct icmphdr *)(s->reply + IP_HDR_SIZE);
+	icmph->type = ICMP_ECHOREPLY;
+	icmph->un.echo.sequence = (uint16_t)pkt.probe;
+	memcpy(skip_icmphdr(icmph), &(struct timeval){ .tv_sec = p->sent_us / 1000000,
+		.tv_usec = p->sent_us % 1000000 }, sizeof(struct timeval));
+	icmph->checksum = 0;
+	icmph->checksum = checksum((unsigned short *)icmph, s->reply_len - IP_HDR_SIZE);
+	memcpy(buf, s->reply, s->reply_len < size ? s->reply_len : size);
+	s->batch++;
+	return s->reply_len;
+}
+
+/**
+ * Release the simulated network.
+ */
+static void sim_close(t_source *src) {
+	t_sim *s = (t_sim *)src;
+
+	free(s->heap);
+	free(s->probes);
+}
+
+/**
+ * Compare one result with its ground truth.
+ *
+ * Return 1 if they differ by more than `tol`, 0 otherwise.
+ */
+static int sim_check(const char *what, double got, double expected, double tol) {
+	if (fabs(got - expected) <= tol)
+		return 0;
+	dprintf(out_fd, "    %s: got %.0f, expected %.0f\n", what, got, expected);
+	return 1;
+}
+
+/**
+ * Check what ft_ping reported against what the simulated network did.
+ *
+ * @param s: Simulator, after the run.
+ *
+ * Return the number of mismatches.
+ */
+static int sim_verify(const t_sim *s) {
+	uint64_t nb_ok = 0, nb_copies = 0, sum = 0, nb_bursts = 0, longest = 0, run = 0;
+	uint32_t min = UINT32_MAX, max = 0;
+	double mean = 0, m2 = 0;
+	int nb_err = 0;
+
+	for (size_t i = 0; i < s->nb_probes; i++) {
+		const t_sim_probe *p = &s->probes[i];
+
+		nb_copies += p->nb_copies;
+		if (p->nb_copies == 0) {
+			nb_bursts += run++ == 0;
+			longest = run > longest ? run : longest;
+			continue;
+		}
+		run = 0;
+		nb_ok++;
+		sum += p->rtt_us;
+		min = p->rtt_us < min ? p->rtt_us : min;
+		max = p->rtt_us > max ? p->rtt_us : max;
+		mean += (p->rtt_us - mean) / nb_ok;
+	}
+	for (size_t i = 0; i < s->nb_probes; i++)
+		if (s->probes[i].nb_copies)
+			m2 += (s->probes[i].rtt_us - mean) * (s->probes[i].rtt_us - mean);
+	nb_err += sim_check("transmitted", pi.nb_send, s->nb_probes, 0);
+	nb_err += sim_check("received", pi.nb_ok, nb_ok, 0);
+	nb_err += sim_check("duplicates", pi.nb_dup, nb_copies - nb_ok, 0);
+	nb_err += sim_check("loss bursts", pi.lossmap->nb_bursts, nb_bursts, 0);
+	nb_err += sim_check("longest burst", pi.lossmap->longest, longest, 0);
+	if (pi.aimd)
+		nb_err += sim_check("rate cut on loss", pi.aimd->nb_cut_loss > 0, nb_ok < s->nb_probes, 0);
+	if (nb_ok == 0)
+		return nb_err;
+	nb_err += sim_check("min (us)", pi.min.tv_sec * 1e6 + pi.min.tv_usec, min, 0);
+	nb_err += sim_check("avg (us)", pi.avg.tv_sec * 1e6 + pi.avg.tv_usec, sum / nb_ok, 0);
+	nb_err += sim_check("max (us)", pi.max.tv_sec * 1e6 + pi.max.tv_usec, max, 0);
+	if (nb_ok > 1)
+		nb_err += sim_check("stddev (us)", pi.stddev.tv_sec * 1e6 + pi.stddev.tv_usec,
+			sqrt(m2 / (nb_ok - 1)), SIM_STDDEV_TOL_US);
+	return nb_err;
+}
+
+/**
+ * Return a monotonic timestamp in nanoseconds.
+ */
+static uint64_t now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Play one scenario through the real probe loop and print its line.
+ *
+ * @param sc: Scenario to play.
+ *
+ * Return the number of mismatches with the ground truth, -1 on failure.
+ */
+static int sim_run(const t_scenario *sc) {
+	t_sim s = { .sc = sc, .pi = &pi, .wheel = &wheel, .rng = sc->seed * 0x9e3779b97f4a7c15ULL | 1,
+		.interrupt_ns = UINT64_MAX, .stall_ns = UINT64_MAX, .step_ns = UINT64_MAX, .step_sign = 1 };
+	uint64_t start;
+	uint64_t wall;
+	double simulated;
+	int ret;
+
+	s.src.next = sim_next;
+	s.src.send = sim_send;
+	s.src.close = sim_close;
+	ft_memset(&pi, 0, sizeof(pi));
+	opts = sc->opts;
+	opts.ttl = 64;
+	opts.size = -1;
+	pi.ident = getpid();
+	pi.body_size = ICMP_BODY_SIZE;
+	pi.clock.virt = 1;
+	pi.clock.ns = SIM_START_NS;
+	pi.clock.wall_offset_ns = SIM_WALL_OFFSET_NS;
+	clock_update(&pi.clock);
+	if (sc->interrupt > 0)
+		s.interrupt_ns = SIM_START_NS + sc->interrupt * 1e9;
+	if (sc->stall_every > 0)
+		s.stall_ns = SIM_START_NS + sc->stall_every * 1e9;
+	if (sc->step_every > 0)
+		s.step_ns = SIM_START_NS + sc->step_every * 1e9;
+	wheel_init(&wheel, wheel_clock(&pi.clock));
+	pingloop = 1;
+	send_packet = 1;
+	g_pi = &pi;
+
+	start = now_ns();
+	ret = -1;
+	if (icmp_probes_init(&pi, &wheel, sec_to_ticks(opts.timeout)) == 0 && payload_init(&pi, &opts) == 0
+		&& lossmap_init(&pi) == 0 && (!opts.adaptive_rto || rto_init(&pi, &opts) == 0)
+		&& (!opts.adaptive || aimd_init(&pi, opts.interval) == 0)
+		&& ping_loop(&s.src, &si, &pi, &opts, &wheel) == 0) {
+		print_end_info(&si, &pi);
+		ret = 0;
+	}
+	fflush(stdout);
+	wall = now_ns() - start;
+	simulated = (pi.clock.ns - SIM_START_NS) / 1e9;
+	if (ret == 0) {
+		dprintf(out_fd, "%-26s %9zu %10.0f %9.0f %10.0f %12.0f %9zu %9lu ", sc->name, s.nb_probes,
+			simulated, wall / 1e6, simulated * 1e9 / wall, s.nb_probes * 1e9 / wall, s.max_pkts,
+			s.nb_wakeups);
+		ret = sim_verify(&s);
+		dprintf(out_fd, ret ? "FAIL\n" : "ok\n");
+	}
+	s.src.close(&s.src);
+	rtts_clean(&pi);
+	lossmap_clean(&pi);
+	rto_clean(&pi);
+	aimd_clean(&pi);
+	icmp_probes_clean(&pi);
+	return ret;
+}
+
+/**
+ * Deterministic simulation of whole ping runs in virtual time.
+ *
+ * The probe loop, timers and statistics are ft_ping's own; the socket is
+ * a simulated network with seeded delay, loss and duplication models,
+ * the clock is virtual and skips straight to the next event, and SIGINT
+ * is a scheduled call to the handler. Every scenario is checked against
+ * the ground truth of the network; its speed is reported as a benchmark.
+ * Output of ft_ping itself is sent to /dev/null.
+ */
+int main(void) {
+	int null_fd;
+	int nb_fail = 0;
+
+	out_fd = dup(STDOUT_FILENO);
+	if (out_fd == -1 || (null_fd = open("/dev/null", O_WRONLY)) == -1) {
+		perror("ft_ping_sim");
+		return 1;
+	}
+	dup2(null_fd, STDOUT_FILENO);
+	close(null_fd);
+
+	dprintf(out_fd, "%-26s %9s %10s %9s %10s %12s %9s %9s\n", "scenario", "probes",
+		"sim s", "wall ms", "speedup", "probes/s", "in flight", "wakeups");
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(*scenarios); i++)
+		if (sim_run(&scenarios[i]) != 0)
+			nb_fail++;
+	close(out_fd);
+	return nb_fail != 0;
+}
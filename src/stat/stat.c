@@ -0,0 +1,194 @@
+#include "../../inc/ft_ping.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct    s_window {
+    uint64_t      nb_send;
+    uint64_t      nb_recv;
+    uint64_t      nb_timeout;
+    uint64_t      nb_late;
+    uint64_t      rtt_min;
+    uint64_t      rtt_max;
+    uint64_t      rtt_sum;
+    uint64_t      hist[SHM_HIST_BINS];
+}                 t_window;
+
+/**
+ * Print the usage of the reader.
+ */
+static void print_usage(void) {
+	ft_printf("Usage: ft_ping_stat [OPTION...] NAME\n"
+		"Sample the live statistics of an ft_ping running with -S NAME.\n\n"
+		"Options:\n"
+		"\t-i <secs>\t\tSeconds between samples, and length of the window (default 1)\n"
+		"\t-c <count>\t\tStop after <count> samples\n"
+		"\t-h\t\t\tShow help\n\n");
+}
+
+/**
+ * Map the segment of a running ft_ping, read-only.
+ *
+ * @param name: Segment name, with or without its leading slash.
+ *
+ * Return the mapping, or NULL on failure.
+ */
+static const t_shm_stats *open_segment(const char *name) {
+	char path[SHM_NAME_MAX + 1] = "/";
+	const t_shm_stats *shm;
+	struct stat st;
+	int fd;
+
+	if (name[0] == '/')
+		name++;
+	if (ft_strlen(name) + 2 > sizeof(path)) {
+		ft_printf("ft_ping_stat: invalid name '%s'\n", name);
+		return NULL;
+	}
+	memcpy(path + 1, name, ft_strlen(name) + 1);
+	if ((fd = shm_open(path, O_RDONLY, 0)) == -1 || fstat(fd, &st) == -1) {
+		ft_printf("ft_ping_stat: %s: %s\n", path, strerror(errno));
+		if (fd != -1)
+			close(fd);
+		return NULL;
+	}
+	if ((size_t)st.st_size < sizeof(*shm)) {
+		ft_printf("ft_ping_stat: %s: not an ft_ping segment\n", path);
+		close(fd);
+		return NULL;
+	}
+	shm = mmap(NULL, sizeof(*shm), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+	if (memcmp(shm->magic, SHM_MAGIC, sizeof(shm->magic)) || shm->version != SHM_VERSION
+		|| shm->size != sizeof(*shm)) {
+		ft_printf("ft_ping_stat: %s: not an ft_ping segment\n", path);
+		munmap((void *)shm, sizeof(*shm));
+		return NULL;
+	}
+	return shm;
+}
+
+/**
+ * Merge the slots of the `secs` seconds before `now`, the current second
+ * being still in progress.
+ *
+ * @param s: Copy of the segment.
+ * @param now: Current second.
+ * @param secs: Length of the window.
+ * @param w: Merged counts.
+ */
+static void merge_window(const t_shm_stats *s, time_t now, int secs, t_window *w) {
+	ft_memset(w, 0, sizeof(*w));
+	w->rtt_min = UINT64_MAX;
+	for (int i = 1; i <= secs; i++) {
+		const t_shm_slot *slot = &s->ring[(now - i) % SHM_RING_SIZE];
+
+		if (slot->sec != now - i)
+			continue;
+		w->nb_send += slot->nb_send;
+		w->nb_recv += slot->nb_recv;
+		w->nb_timeout += slot->nb_timeout;
+		w->nb_late += slot->nb_late;
+		if (slot->nb_recv) {
+			w->rtt_min = slot->rtt_min < w->rtt_min ? slot->rtt_min : w->rtt_min;
+			w->rtt_max = slot->rtt_max > w->rtt_max ? slot->rtt_max : w->rtt_max;
+		}
+		w->rtt_sum += slot->rtt_sum;
+		for (int b = 0; b < SHM_HIST_BINS; b++)
+			w->hist[b] += slot->hist[b];
+	}
+}
+
+/**
+ * Upper bound of the histogram bin holding a given fraction of the RTTs,
+ * in milliseconds: within 25% of the true value.
+ */
+static double hist_bound(const uint64_t *hist, uint64_t nb, double q) {
+	uint64_t rank = (uint64_t)(q * (nb - 1)) + 1;
+	uint64_t seen = 0;
+
+	for (int b = 0; b < SHM_HIST_BINS; b++) {
+		seen += hist[b];
+		if (seen >= rank)
+			return shm_hist_upper(b) / 1e3;
+	}
+	return shm_hist_upper(SHM_HIST_BINS - 1) / 1e3;
+}
+
+/**
+ * Print one sample: the window just elapsed, then the totals.
+ */
+static void print_sample(const t_shm_stats *s, time_t now, int secs) {
+	t_window w;
+
+	merge_window(s, now, secs, &w);
+	printf("%ld: %lu sent, %lu received, ", now, w.nb_send, w.nb_recv);
+	if (w.nb_late)
+		printf("%lu late, ", w.nb_late);
+	printf("%lu timeouts", w.nb_timeout);
+	if (w.nb_recv) {
+		printf(", rtt min/avg/max = %.3f/%.3f/%.3f ms, p50/p90/p99 < %.3f/%.3f/%.3f ms",
+			w.rtt_min / 1e3, w.rtt_sum / 1e3 / w.nb_recv, w.rtt_max / 1e3,
+			hist_bound(w.hist, w.nb_recv, 0.5), hist_bound(w.hist, w.nb_recv, 0.9),
+			hist_bound(w.hist, w.nb_recv, 0.99));
+	}
+	printf(" | total %lu sent, %lu received, %lu dup, %lu timeouts\n",
+		s->nb_send, s->nb_recv, s->nb_dup, s->nb_timeout);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+	const t_shm_stats *shm;
+	t_shm_stats *s;
+	struct timeval now;
+	char addr[INET_ADDRSTRLEN];
+	int secs = 1;
+	int count = -1;
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+		if (argv[i][1] == 'h' || argv[i][2] || i + 1 >= argc) {
+			print_usage();
+			return argv[i][1] == 'h' ? 0 : E_EXIT_ERR_ARGS;
+		}
+		char *arg = argv[++i];
+		switch (argv[i - 1][1]) {
+		case 'i': secs = atoi(arg);
+			break;
+		case 'c': count = atoi(arg);
+			break;
+		default:
+			ft_printf("ft_ping_stat: invalid option -- '%c'\n", argv[i - 1][1]);
+			return E_EXIT_ERR_ARGS;
+		}
+	}
+	if (i + 1 != argc || secs <= 0 || secs >= SHM_RING_SIZE || count == 0) {
+		print_usage();
+		return E_EXIT_ERR_ARGS;
+	}
+	if ((shm = open_segment(argv[i])) == NULL)
+		return E_EXIT_ERR_HOST;
+	if ((s = malloc(sizeof(*s))) == NULL)
+		return E_EXIT_ERR_HOST;
+
+	shm_stats_read(shm, s);
+	inet_ntop(AF_INET, &s->target, addr, sizeof(addr));
+	printf("--- ft_ping %u, %s, running for %ld s ---\n", s->pid, addr, s->update_usec / 1000000 - s->start_sec);
+	while (count == -1 || count-- > 0) {
+		gettimeofday(&now, NULL);
+		usleep((secs - 1) * 1000000 + (1000000 - now.tv_usec) + 10000);
+		shm_stats_read(shm, s);
+		gettimeofday(&now, NULL);
+		print_sample(s, now.tv_sec, secs);
+		if (s->state == SHM_STOPPED)
+			break;
+	}
+	munmap((void *)shm, sizeof(*shm));
+	free(s);
+	return E_EXIT_OK;
+}
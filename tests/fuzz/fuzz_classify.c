@@ -0,0 +1,293 @@
+#include "../../inc/loop.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/*
+ * Fuzz target for the receive classifier and the packet handlers behind it.
+ *
+ * With libFuzzer (clang -fsanitize=fuzzer -DFUZZ_LIBFUZZER) only
+ * LLVMFuzzerTestOneInput is used. Otherwise the built-in driver runs the
+ * target on the files given on the command line, or on random mutations of
+ * a few well-formed seeds; `make fuzz` builds it with ASan and UBSan.
+ */
+
+#define FUZZ_IDENT 0x4242
+#define FUZZ_ADDR 0x0200c80a
+#define FUZZ_RUNS 2000000
+
+static t_options opts = { .quiet = 1, .count = -1, .interval = 1.0f, .ttl = 64 };
+static t_sockinfo si = { .host = "fuzz.local", .str_sin_addr = "10.200.0.2",
+	.remote_addr = { .sin_family = AF_INET, .sin_addr = { FUZZ_ADDR } } };
+static size_t nb_class[PKT_MALFORMED + 1];
+
+/**
+ * Check what the classifier promises about a packet it accepted.
+ */
+static void check_pkt(const t_pkt *p, _Bool verify_csum) {
+	size_t len = p->len;
+	const uint8_t *b = p->buf;
+
+	if (p->cls == PKT_MALFORMED || p->cls == PKT_FOREIGN)
+		return;
+	if (p->icmp_off < IP_HDR_SIZE || p->icmp_off > IP_MAX_HDR_SIZE || p->icmp_off + ICMP_HDR_SIZE > len)
+		abort();
+	if (p->cls == PKT_REPLY && (b[p->icmp_off] != ICMP_ECHOREPLY
+		|| p->icmp_off + ICMP_HDR_SIZE + sizeof(struct timeval) > len))
+		abort();
+	if (p->cls == PKT_ERROR && (p->quote_off + IP_HDR_SIZE > len || p->echo_off + ICMP_HDR_SIZE > len
+		|| b[p->echo_off] != ICMP_ECHO))
+		abort();
+	if (verify_csum && (checksum((unsigned short *)b, p->icmp_off) != 0
+		|| (ntohs(((struct iphdr *)b)->tot_len) <= RECV_PACK_SIZE
+			&& checksum((unsigned short *)(b + p->icmp_off), ntohs(((struct iphdr *)b)->tot_len) - p->icmp_off) != 0)))
+		abort();
+}
+
+/**
+ * Run one packet through the classifier, then through the ping, sweep and
+ * path MTU handlers, with and without checksum verification.
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	uint8_t *buf = malloc(RECV_PACK_SIZE);
+	t_packinfo *pi = calloc(1, sizeof(*pi));
+	struct timeval now;
+	t_pmtu pm;
+	t_pkt pkt;
+
+	if (buf == NULL || pi == NULL)
+		abort();
+	if (size > RECV_PACK_SIZE)
+		size = RECV_PACK_SIZE;
+	ft_memset(buf, 0, RECV_PACK_SIZE);
+	ft_memcpy(buf, data, size);
+	pi->ident = FUZZ_IDENT;
+	pi->payload = icmp_payload();
+	pi->body_size = ICMP_BODY_SIZE;
+	pi->recv_size = RECV_PACK_SIZE;
+	gettimeofday(&now, NULL);
+
+	for (int verify = 0; verify < 2; verify++) {
+		pkt = (t_pkt){ .buf = buf, .len = size, .size = RECV_PACK_SIZE, .ts = now };
+		classify_batch(&pkt, 1, pi->ident, verify, 1);
+		check_pkt(&pkt, verify);
+		nb_class[pkt.cls]++;
+
+		opts.verify_csum = verify;
+		if (icmp_handle_packet(&pkt, pi, &opts, &si) == -1)
+			abort();
+		if (sweep_init(pi, 30) == -1)
+			abort();
+		pi->round_seq = pkt.seq - verify;
+		for (int i = 0; i < pi->nb_hops; i++)
+			pi->hops->pending[i] = 1;
+		icmp_handle_packet(&pkt, pi, &opts, &si);
+		sweep_clean(pi);
+
+		pi->pmtu = &pm;
+		pm = (t_pmtu){ .lo = PMTU_MIN, .hi = 1500, .nb_pending = PMTU_PROBES };
+		for (int i = 0; i < PMTU_PROBES; i++)
+			pm.probes[i] = (t_pmtu_probe){ .size = 180 * (i + 1), .state = PMTU_PENDING };
+		if (icmp_handle_packet(&pkt, pi, &opts, &si) == -1)
+			abort();
+		pi->pmtu = NULL;
+		rtts_clean(pi);
+	}
+	free(pi);
+	free(buf);
+	return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+/* Send time stamped in the seeds, close to the reception time of the target. */
+static struct timeval seed_time;
+
+/**
+ * xorshift64, enough to drive the mutations.
+ */
+static uint64_t rnd(void) {
+	static uint64_t x = 0x9e3779b97f4a7c15ULL;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return x;
+}
+
+/**
+ * Write an IPv4 header with `opt_words` words of options, checksummed.
+ *
+ * Return the header length.
+ */
+static size_t seed_ip(uint8_t *b, size_t opt_words, size_t tot, uint32_t saddr, uint32_t daddr) {
+	struct iphdr *ip = (struct iphdr *)b;
+
+	ft_memset(b, 0, IP_HDR_SIZE + opt_words * 4);
+	ip->version = 4;
+	ip->ihl = 5 + opt_words;
+	ip->tot_len = htons(tot);
+	ip->ttl = 64;
+	ip->protocol = IPPROTO_ICMP;
+	ip->saddr = saddr;
+	ip->daddr = daddr;
+	for (size_t i = 0; i < opt_words * 4; i++)
+		b[IP_HDR_SIZE + i] = IPOPT_NOP;
+	ip->check = checksum((unsigned short *)b, ip->ihl * 4);
+	return ip->ihl * 4;
+}
+
+/**
+ * Build one of the seeds: an echo reply or an ICMP error quoting one of our
+ * requests, with a random amount of IP options on either header.
+ *
+ * Return the seed length.
+ */
+static size_t build_seed(uint8_t *b) {
+	size_t opts_out = rnd() % 11;
+	size_t opts_in = rnd() % 11;
+	size_t off;
+	struct icmphdr *icmph;
+
+	ft_memset(b, 0, RECV_PACK_SIZE);
+	if (rnd() % 2) {
+		size_t len = (5 + opts_out) * 4 + ICMP_HDR_SIZE + ICMP_BODY_SIZE;
+
+		off = seed_ip(b, opts_out, len, FUZZ_ADDR, 0);
+		fill_icmp_echo_packet(b + off, ICMP_HDR_SIZE + ICMP_BODY_SIZE, FUZZ_IDENT, rnd(), &seed_time);
+		icmph = (struct icmphdr *)(b + off);
+		icmph->type = ICMP_ECHOREPLY;
+		icmph->checksum = 0;
+		icmph->checksum = checksum((unsigned short *)icmph, ICMP_HDR_SIZE + ICMP_BODY_SIZE);
+		return len;
+	}
+	size_t inner = (5 + opts_in) * 4 + ICMP_HDR_SIZE;
+	size_t len = (5 + opts_out) * 4 + ICMP_HDR_SIZE + inner;
+
+	off = seed_ip(b, opts_out, len, 0x0100c80a, 0);
+	icmph = (struct icmphdr *)(b + off);
+	icmph->type = (uint8_t[]){ ICMP_TIME_EXCEEDED, ICMP_DEST_UNREACH, ICMP_PARAMETERPROB }[rnd() % 3];
+	off += ICMP_HDR_SIZE;
+	off += seed_ip(b + off, opts_in, (5 + opts_in) * 4 + ICMP_HDR_SIZE + ICMP_BODY_SIZE, 0, FUZZ_ADDR);
+	((struct icmphdr *)(b + off))->type = ICMP_ECHO;
+	((struct icmphdr *)(b + off))->un.echo.id = FUZZ_IDENT;
+	((struct icmphdr *)(b + off))->un.echo.sequence = rnd();
+	icmph->checksum = checksum((unsigned short *)icmph, len - (5 + opts_out) * 4);
+	return len;
+}
+
+/**
+ * Apply a few random mutations to a packet, sometimes fixing the
+ * checksums afterwards so the checksum-verifying path sees mutants too.
+ *
+ * Return the new length.
+ */
+static size_t mutate(uint8_t *b, size_t len) {
+	int nb = 1 + rnd() % 4;
+
+	for (int i = 0; i < nb; i++) {
+		switch (rnd() % 6) {
+		case 0: b[rnd() % RECV_PACK_SIZE] ^= 1 << (rnd() % 8);
+			break;
+		case 1: b[rnd() % RECV_PACK_SIZE] = rnd();
+			break;
+		case 2: len = rnd() % (RECV_PACK_SIZE + 1);
+			break;
+		case 3: b[0] = (b[0] & 0xf0) | (rnd() % 16);
+			break;
+		case 4: b[(b[0] & 0x0f) * 4 + ICMP_HDR_SIZE] = 0x40 | (rnd() % 16);
+			break;
+		case 5: b[2 + rnd() % 2] = rnd();
+			break;
+		}
+	}
+	if (rnd() % 2) {
+		size_t ihl = (b[0] & 0x0f) * 4;
+		size_t tot = ntohs(((struct iphdr *)b)->tot_len);
+
+		((struct iphdr *)b)->check = 0;
+		((struct iphdr *)b)->check = checksum((unsigned short *)b, ihl);
+		if (tot <= len && tot >= ihl + ICMP_HDR_SIZE) {
+			((struct icmphdr *)(b + ihl))->checksum = 0;
+			((struct icmphdr *)(b + ihl))->checksum = checksum((unsigned short *)(b + ihl), tot - ihl);
+		}
+	}
+	return len;
+}
+
+/**
+ * Run the target on a file, or on every file of a directory.
+ *
+ * Return the number of inputs run.
+ */
+static size_t run_path(const char *path) {
+	uint8_t data[RECV_PACK_SIZE];
+	char sub[4096];
+	struct dirent *de;
+	struct stat st;
+	size_t nb = 0;
+	ssize_t len;
+	DIR *dir;
+	int fd;
+
+	if (stat(path, &st) == -1) {
+		perror(path);
+		return 0;
+	}
+	if (S_ISDIR(st.st_mode)) {
+		if ((dir = opendir(path)) == NULL)
+			return 0;
+		while ((de = readdir(dir)) != NULL) {
+			if (de->d_name[0] == '.')
+				continue;
+			snprintf(sub, sizeof(sub), "%s/%s", path, de->d_name);
+			nb += run_path(sub);
+		}
+		closedir(dir);
+		return nb;
+	}
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		perror(path);
+		return 0;
+	}
+	len = read(fd, data, sizeof(data));
+	close(fd);
+	if (len < 0)
+		return 0;
+	LLVMFuzzerTestOneInput(data, len);
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	uint8_t b[RECV_PACK_SIZE];
+	size_t runs = FUZZ_RUNS;
+	size_t nb = 0;
+	size_t len;
+	int i = 1;
+
+	/* Errors quoting our probes are printed even with -q. */
+	if (freopen("/dev/null", "w", stdout) == NULL)
+		return 1;
+	gettimeofday(&seed_time, NULL);
+	if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+		runs = strtoul(argv[2], NULL, 10);
+		i = 3;
+	}
+	if (i < argc) {
+		for (; i < argc; i++)
+			nb += run_path(argv[i]);
+	} else {
+		for (; nb < runs; nb++) {
+			len = build_seed(b);
+			if (nb % 8)
+				len = mutate(b, len);
+			LLVMFuzzerTestOneInput(b, len);
+		}
+	}
+	fprintf(stderr, "fuzz_classify: %zu inputs, %zu reply, %zu error, %zu foreign, %zu malformed\n", nb,
+		nb_class[PKT_REPLY], nb_class[PKT_ERROR], nb_class[PKT_FOREIGN], nb_class[PKT_MALFORMED]);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,269 @@
+#define _GNU_SOURCE
+#include "../../inc/loop.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Fuzz target for the pcap and pcapng readers behind -r.
+ *
+ * The input is written to a memory file and opened through /proc, so the
+ * readers see it exactly as they would a capture on disk. With libFuzzer
+ * (clang -fsanitize=fuzzer -DFUZZ_LIBFUZZER) only LLVMFuzzerTestOneInput
+ * is used. Otherwise the built-in driver runs the target on the files given
+ * on the command line, or on random mutations of a few well-formed
+ * captures; `make fuzz` builds it with ASan and UBSan.
+ */
+
+#define FUZZ_RUNS 200000
+#define FUZZ_MAX_SIZE 4096
+
+static size_t nb_files;
+static size_t nb_packets;
+
+/**
+ * Replay one capture file through the reader, checking what it promises
+ * about every packet it hands over. Packets never overlap, so together
+ * they cannot hold more bytes than the file: a reader that copies past a
+ * block, which ASan misses inside the mapping, is caught here.
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	static int fd = -1;
+	uint8_t buf[RECV_PACK_SIZE];
+	char path[64];
+	struct timeval ts;
+	size_t total = 0;
+	t_source src;
+	ssize_t len;
+
+	if (fd == -1 && (fd = memfd_create("fuzz_pcap", 0)) == -1)
+		abort();
+	if (ftruncate(fd, 0) == -1 || pwrite(fd, data, size, 0) != (ssize_t)size)
+		abort();
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+	if (source_open_pcap(&src, path) == -1)
+		return 0;
+	nb_files++;
+	while ((len = src.next(&src, buf, sizeof(buf), &ts)) > 0) {
+		if ((size_t)len > sizeof(buf) || len < (ssize_t)IP_HDR_SIZE || (buf[0] >> 4) != 4
+			|| ts.tv_usec < 0 || ts.tv_usec >= 1000000 || (total += len) > size)
+			abort();
+		nb_packets++;
+	}
+	if (len == 0 && !src.eof)
+		abort();
+	src.close(&src);
+	return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+/**
+ * xorshift64, enough to drive the mutations.
+ */
+static uint64_t rnd(void) {
+	static uint64_t x = 0x9e3779b97f4a7c15ULL;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return x;
+}
+
+static size_t put32(uint8_t *b, size_t off, uint32_t v) {
+	memcpy(b + off, &v, sizeof(v));
+	return off + sizeof(v);
+}
+
+static size_t put16(uint8_t *b, size_t off, uint16_t v) {
+	memcpy(b + off, &v, sizeof(v));
+	return off + sizeof(v);
+}
+
+/**
+ * Write a minimal IPv4 echo reply.
+ *
+ * Return the length written.
+ */
+static size_t seed_packet(uint8_t *b) {
+	ft_memset(b, 0, IP_HDR_SIZE + ICMP_HDR_SIZE);
+	b[0] = 0x45;
+	b[3] = IP_HDR_SIZE + ICMP_HDR_SIZE;
+	b[8] = 64;
+	b[9] = IPPROTO_ICMP;
+	return IP_HDR_SIZE + ICMP_HDR_SIZE;
+}
+
+/**
+ * Write a classic pcap file of a few raw IPv4 packets.
+ *
+ * Return the length written.
+ */
+static size_t seed_pcap(uint8_t *b) {
+	size_t off = 0;
+	int nb = 1 + rnd() % 4;
+
+	off = put32(b, off, rnd() % 2 ? 0xa1b2c3d4 : 0xa1b23c4d);
+	off = put16(b, off, 2);
+	off = put16(b, off, 4);
+	off = put32(b, off, 0);
+	off = put32(b, off, 0);
+	off = put32(b, off, 65535);
+	off = put32(b, off, 101);
+	for (int i = 0; i < nb; i++) {
+		off = put32(b, off, rnd());
+		off = put32(b, off, rnd() % 1000000);
+		off = put32(b, off, IP_HDR_SIZE + ICMP_HDR_SIZE);
+		off = put32(b, off, IP_HDR_SIZE + ICMP_HDR_SIZE);
+		off += seed_packet(b + off);
+	}
+	return off;
+}
+
+/**
+ * Write a pcapng file: a section header, one interface with the given
+ * timestamp resolution, and a few enhanced packet blocks.
+ *
+ * Return the length written.
+ */
+static size_t seed_pcapng(uint8_t *b, uint8_t tsresol) {
+	size_t off = 0;
+	int nb = 1 + rnd() % 4;
+
+	off = put32(b, off, 0x0a0d0d0a);
+	off = put32(b, off, 28);
+	off = put32(b, off, 0x1a2b3c4d);
+	off = put32(b, off, 1);
+	off = put32(b, off, UINT32_MAX);
+	off = put32(b, off, UINT32_MAX);
+	off = put32(b, off, 28);
+	off = put32(b, off, 1);
+	off = put32(b, off, 32);
+	off = put16(b, off, 228);
+	off = put16(b, off, 0);
+	off = put32(b, off, 65535);
+	off = put16(b, off, 9);
+	off = put16(b, off, 1);
+	off = put32(b, off, tsresol);
+	off = put32(b, off, 0);
+	off = put32(b, off, 32);
+	for (int i = 0; i < nb; i++) {
+		off = put32(b, off, 6);
+		off = put32(b, off, 32 + IP_HDR_SIZE + ICMP_HDR_SIZE);
+		off = put32(b, off, 0);
+		off = put32(b, off, rnd());
+		off = put32(b, off, rnd());
+		off = put32(b, off, IP_HDR_SIZE + ICMP_HDR_SIZE);
+		off = put32(b, off, IP_HDR_SIZE + ICMP_HDR_SIZE);
+		off += seed_packet(b + off);
+		off = put32(b, off, 32 + IP_HDR_SIZE + ICMP_HDR_SIZE);
+	}
+	return off;
+}
+
+/**
+ * Apply a few random mutations to a capture file.
+ *
+ * Return the new length.
+ */
+static size_t mutate(uint8_t *b, size_t len) {
+	int nb = 1 + rnd() % 4;
+
+	for (int i = 0; i < nb; i++) {
+		switch (rnd() % 5) {
+		case 0: b[rnd() % len] ^= 1 << (rnd() % 8);
+			break;
+		case 1: b[rnd() % len] = rnd();
+			break;
+		case 2: if (len >= 4)
+				put32(b, (rnd() % (len - 3)) & ~3, rnd() % 256);
+			break;
+		case 3: len = 1 + rnd() % len;
+			break;
+		case 4: if (len >= 4)
+				put32(b, (rnd() % (len - 3)) & ~3, UINT32_MAX - rnd() % 32);
+			break;
+		}
+	}
+	return len;
+}
+
+/**
+ * Run the target on a file, or on every file of a directory.
+ *
+ * Return the number of inputs run.
+ */
+static size_t run_path(const char *path) {
+	uint8_t data[FUZZ_MAX_SIZE];
+	char sub[4096];
+	struct dirent *de;
+	struct stat st;
+	size_t nb = 0;
+	ssize_t len;
+	DIR *dir;
+	int fd;
+
+	if (stat(path, &st) == -1) {
+		perror(path);
+		return 0;
+	}
+	if (S_ISDIR(st.st_mode)) {
+		if ((dir = opendir(path)) == NULL)
+			return 0;
+		while ((de = readdir(dir)) != NULL) {
+			if (de->d_name[0] == '.')
+				continue;
+			snprintf(sub, sizeof(sub), "%s/%s", path, de->d_name);
+			nb += run_path(sub);
+		}
+		closedir(dir);
+		return nb;
+	}
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		perror(path);
+		return 0;
+	}
+	len = read(fd, data, sizeof(data));
+	close(fd);
+	if (len < 0)
+		return 0;
+	LLVMFuzzerTestOneInput(data, len);
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	uint8_t b[FUZZ_MAX_SIZE];
+	size_t runs = FUZZ_RUNS;
+	size_t nb = 0;
+	size_t len;
+	int i = 1;
+
+	/* The readers report bad files on stdout. */
+	if (freopen("/dev/null", "w", stdout) == NULL)
+		return 1;
+	if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+		runs = strtoul(argv[2], NULL, 10);
+		i = 3;
+	}
+	if (i < argc) {
+		for (; i < argc; i++)
+			nb += run_path(argv[i]);
+	} else {
+		/* Every timestamp resolution once, unmutated, then random mutants. */
+		for (; nb < runs; nb++) {
+			if (nb < 256)
+				len = seed_pcapng(b, nb);
+			else
+				len = rnd() % 2 ? seed_pcapng(b, rnd()) : seed_pcap(b);
+			if (nb >= 256 && nb % 8)
+				len = mutate(b, len);
+			LLVMFuzzerTestOneInput(b, len);
+		}
+	}
+	fprintf(stderr, "fuzz_pcap: %zu inputs, %zu files opened, %zu packets\n", nb, nb_files, nb_packets);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,201 @@
+#!/bin/sh
+#
+# Load harness: drive ft_ping against ft_ping_responder in a private network
+# namespace and check the printed statistics against the responder's own
+# counters, which are the ground truth.
+#
+# Usage: tests/loadtest.sh            (as root, from the repository root)
+#        LOADTEST_COUNT=5000 LOADTEST_INTERVAL=0.001 tests/loadtest.sh
+
+COUNT=${LOADTEST_COUNT:-500}
+INTERVAL=${LOADTEST_INTERVAL:-0.005}
+TARGET=10.200.0.2
+OUT=$(mktemp -d)
+FAILED=0
+
+if [ -z "$FT_PING_NETNS" ]; then
+    exec unshare -n env FT_PING_NETNS=1 "$0" "$@"
+fi
+ip link set lo up
+trap 'rm -rf "$OUT"' EXIT
+
+# field <file> <text following the number>
+field() {
+    grep -o "[0-9][0-9]*$2" "$1" | head -n 1 | sed 's/[^0-9].*//'
+}
+
+# check <name> <condition> <message>
+check() {
+    if [ "$2" = 1 ]; then
+        printf '  ok    %s\n' "$1"
+    else
+        printf '  FAIL  %s: %s\n' "$1" "$3"
+        FAILED=1
+    fi
+}
+
+# scenario <name> <min avg ms> <max avg ms> <responder options...>
+scenario() {
+    name=$1 lo=$2 hi=$3
+    shift 3
+    printf '%s\n' "$name"
+
+    ./ft_ping_responder "$@" >/dev/null 2>"$OUT/resp" &
+    resp_pid=$!
+    sleep 0.2
+    ./ft_ping -q -c "$COUNT" -i "$INTERVAL" "$TARGET" >"$OUT/ping" 2>&1
+    kill -INT "$resp_pid"
+    wait "$resp_pid"
+
+    sent=$(field "$OUT/ping" ' packets transmitted')
+    recv=$(field "$OUT/ping" ' packets received')
+    dups=$(field "$OUT/ping" ' duplicates')
+    loss=$(field "$OUT/ping" '% packet loss')
+    avg=$(sed -n 's/^round-trip .*= [0-9.]*\/\([0-9.]*\)\/.*/\1/p' "$OUT/ping")
+    requests=$(field "$OUT/resp" ' requests')
+    replies=$(field "$OUT/resp" ' replies')
+    rdups=$(field "$OUT/resp" ' duplicated')
+    overflow=$(field "$OUT/resp" ' overflowed')
+    dups=${dups:-0}
+    unique=$((replies - rdups))
+
+    check "transmitted" "$([ "$sent" = "$COUNT" ] && [ "$requests" = "$COUNT" ] && echo 1)" \
+        "ft_ping sent ${sent:-?}, responder saw ${requests:-?}, expected $COUNT"
+    check "received" "$([ "$recv" = "$unique" ] && echo 1)" \
+        "ft_ping received ${recv:-?}, responder sent $unique unique replies ($overflow overflowed)"
+    check "duplicates" "$([ "$dups" = "$rdups" ] && echo 1)" \
+        "ft_ping counted $dups duplicates, responder sent $rdups"
+    check "loss" "$([ "$loss" = "$(( (COUNT - unique) * 100 / COUNT ))" ] && echo 1)" \
+        "ft_ping reported ${loss:-?}%"
+    if [ "$unique" -gt 0 ]; then
+        check "rtt avg" "$(echo "$avg" | awk -v lo="$lo" -v hi="$hi" '{ print ($1 >= lo && $1 <= hi) }')" \
+            "avg ${avg:-?} ms not in [$lo, $hi] ms"
+    fi
+}
+
+scenario "clean link, 2 ms"            2 4    -d 2
+scenario "20% loss"                    2 4    -d 2 -l 20 -s 11
+scenario "10% duplication"             2 4    -d 2 -u 10 -s 12
+scenario "30% reordering (+8 ms)"      2 7    -d 2 -o 30 -O 8 -s 13
+scenario "rate limit 100 pps"          2 4    -d 2 -r 100
+scenario "uniform 5 +/- 3 ms"          4 6.5  -d 5 -j 3 -D uniform -s 14
+scenario "normal 10 ms, sd 2 ms"       9 11.5 -d 10 -j 2 -D normal -s 15
+scenario "exponential 1 ms + 4 ms"     4 6.5  -d 1 -j 4 -D exp -s 16
+
+# Delay variation against independent normal delays, sd 2 ms: the RTT
+# stddev must find it, and the RFC 3550 jitter must settle near the mean
+# absolute difference of two of them, 2 * sd / sqrt(pi) = 2.26 ms.
+printf '%s\n' "jitter, normal 10 ms, sd 2 ms"
+./ft_ping_responder -d 10 -j 2 -D normal -s 18 >/dev/null 2>"$OUT/resp" &
+resp_pid=$!
+sleep 0.2
+./ft_ping -q -c "$COUNT" -i "$INTERVAL" "$TARGET" >"$OUT/ping" 2>&1
+kill -INT "$resp_pid"
+wait "$resp_pid"
+sd=$(sed -n 's/^round-trip .*\/\([0-9.]*\) ms$/\1/p' "$OUT/ping")
+jitter=$(sed -n 's/^jitter = \([0-9.]*\) ms.*/\1/p' "$OUT/ping")
+check "rtt stddev" "$(echo "$sd" | awk '{ print ($1 >= 1.6 && $1 <= 2.4) }')" \
+    "stddev ${sd:-?} ms, expected about 2 ms"
+check "jitter" "$(echo "$jitter" | awk '{ print ($1 >= 1.2 && $1 <= 3.5) }')" \
+    "jitter ${jitter:-?} ms, expected about 2.26 ms"
+
+# Loss pattern against independent 20% loss: the fitted Gilbert-Elliott
+# chain must degenerate to it, p = 1 - r = 0.2.
+printf '%s\n' "loss pattern, 20% independent loss"
+./ft_ping_responder -d 2 -l 20 -s 19 >/dev/null 2>"$OUT/resp" &
+resp_pid=$!
+sleep 0.2
+./ft_ping -q -c "$COUNT" -i "$INTERVAL" "$TARGET" >"$OUT/ping" 2>&1
+kill -INT "$resp_pid"
+wait "$resp_pid"
+ge_p=$(sed -n 's/^gilbert-elliott p = \([0-9.]*\), r = .*/\1/p' "$OUT/ping")
+ge_r=$(sed -n 's/^gilbert-elliott p = [0-9.]*, r = \([0-9.]*\).*/\1/p' "$OUT/ping")
+check "gilbert-elliott p" "$(echo "$ge_p" | awk '{ print ($1 >= 0.12 && $1 <= 0.28) }')" \
+    "p = ${ge_p:-?}, expected about 0.2"
+check "gilbert-elliott r" "$(echo "$ge_r" | awk '{ print ($1 >= 0.65 && $1 <= 0.95) }')" \
+    "r = ${ge_r:-?}, expected about 0.8"
+
+# Adaptive pacing (-A) against a 100 pps rate limit: the rate it settles on
+# must stay under the limit, with little loss left.
+printf '%s\n' "adaptive rate, limit 100 pps"
+./ft_ping_responder -d 2 -r 100 >/dev/null 2>"$OUT/resp" &
+resp_pid=$!
+sleep 0.2
+./ft_ping -q -A -i 0.02 -W 0.2 -w 15 "$TARGET" >"$OUT/ping" 2>&1
+kill -INT "$resp_pid"
+wait "$resp_pid"
+rate=$(sed -n 's/^adaptive rate \([0-9.]*\)\/s.*/\1/p' "$OUT/ping")
+loss=$(field "$OUT/ping" '% packet loss')
+check "settled rate" "$(echo "$rate" | awk '{ print ($1 >= 50 && $1 <= 100) }')" \
+    "settled at ${rate:-?}/s, expected 50-100/s"
+check "loss" "$([ "${loss:-100}" -le 5 ] && echo 1)" "ft_ping reported ${loss:-?}%"
+
+# Adaptive timeouts (-a) on a 2 ms link with 20% loss: lost probes must be
+# given up on after a few RTTs, not after -W, and the loss still match.
+printf '%s\n' "adaptive timeout, 2 ms, 20% loss"
+./ft_ping_responder -d 2 -l 20 -s 20 >/dev/null 2>"$OUT/resp" &
+resp_pid=$!
+sleep 0.2
+./ft_ping -q -a 0.005:1 -W 1 -c "$COUNT" -i "$INTERVAL" "$TARGET" >"$OUT/ping" 2>&1
+kill -INT "$resp_pid"
+wait "$resp_pid"
+elapsed=$(sed -n 's/.*packet loss, time \([0-9]*\) ms$/\1/p' "$OUT/ping")
+rto=$(sed -n 's/^adaptive timeout \([0-9.]*\) ms.*/\1/p' "$OUT/ping")
+recv=$(field "$OUT/ping" ' packets received')
+replies=$(field "$OUT/resp" ' replies')
+check "run time" "$(echo "$elapsed" | awk -v c="$COUNT" -v i="$INTERVAL" '{ print ($1 <= (c - 1) * i * 1000 + 300) }')" \
+    "run took ${elapsed:-?} ms, expected under $(echo "$COUNT $INTERVAL" | awk '{ print ($1 - 1) * $2 * 1000 + 300 }') ms"
+check "timeout" "$(echo "$rto" | awk '{ print ($1 >= 5 && $1 <= 50) }')" \
+    "adaptive timeout ${rto:-?} ms, expected a few RTTs"
+check "received" "$([ "$recv" = "$replies" ] && echo 1)" \
+    "ft_ping received ${recv:-?}, responder sent ${replies:-?}"
+
+# A stalled receiver at 5000 probes/s, with replies 1 s late: a 0.3 s
+# stall fits in the auto-sized receive buffer, a 1.2 s one overflows it,
+# and what the socket dropped must be reported apart from network loss.
+for stall in 0.3 1.2; do
+    printf '%s\n' "receiver stalled ${stall} s, 5000 pps"
+    ./ft_ping_responder -d 1000 -s 21 >/dev/null 2>"$OUT/resp" &
+    resp_pid=$!
+    sleep 0.2
+    ./ft_ping -q -c 8000 -i 0.0002 "$TARGET" >"$OUT/ping" 2>&1 &
+    ping_pid=$!
+    sleep 1.5
+    kill -STOP "$ping_pid"
+    sleep "$stall"
+    kill -CONT "$ping_pid"
+    wait "$ping_pid"
+    kill -INT "$resp_pid"
+    wait "$resp_pid"
+    recv=$(field "$OUT/ping" ' packets received')
+    drops=$(field "$OUT/ping" ' dropped locally')
+    loss=$(field "$OUT/ping" '% packet loss')
+    replies=$(field "$OUT/resp" ' replies')
+    if [ "$stall" = 0.3 ]; then
+        check "no local drop" "$([ -z "$drops" ] && echo 1)" "ft_ping dropped $drops replies"
+    else
+        check "local drops" "$([ "${drops:-0}" -gt 0 ] && echo 1)" "no local drop reported"
+    fi
+    check "received" "$([ "$((recv + ${drops:-0}))" = "$replies" ] && echo 1)" \
+        "ft_ping received ${recv:-?} and dropped ${drops:-0}, responder sent ${replies:-?}"
+    check "network loss" "$([ "$loss" = 0 ] && echo 1)" "ft_ping reported ${loss:-?}%"
+done
+
+# Payload corruption behind valid checksums: every corrupted reply must be
+# caught, whatever the payload, and nothing else flagged.
+for pattern in random ff00a5; do
+    printf '%s\n' "5% corruption, -p $pattern, -s 1400"
+    ./ft_ping_responder -d 2 -c 5 -s 17 >/dev/null 2>"$OUT/resp" &
+    resp_pid=$!
+    sleep 0.2
+    ./ft_ping -q -p "$pattern" -s 1400 -c "$COUNT" -i "$INTERVAL" "$TARGET" >"$OUT/ping" 2>&1
+    kill -INT "$resp_pid"
+    wait "$resp_pid"
+    corrupt=$(field "$OUT/ping" ' corrupted')
+    rcorrupt=$(field "$OUT/resp" ' corrupted')
+    check "corrupted" "$([ "${corrupt:-0}" = "$rcorrupt" ] && [ "$rcorrupt" -gt 0 ] && echo 1)" \
+        "ft_ping counted ${corrupt:-0} corrupted replies, responder corrupted ${rcorrupt:-?}"
+done
+
+[ "$FAILED" = 0 ] && echo "all scenarios passed" || echo "some scenarios failed"
+exit "$FAILED"